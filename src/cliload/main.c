@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * cliload: a load generator for the satorinow CLI socket. Each client
+ * connects, sends one command, reads the response to CLI_DONE and repeats
+ * until the run ends, then the commands per second and the latency
+ * distribution across all clients are printed. With --pipeline each client
+ * keeps that many commands in flight on one protocol v2 connection instead.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <satorinow.h>
+
+#define LOAD_DEFAULT_CLIENTS 64
+#define LOAD_DEFAULT_SECONDS 10
+#define LOAD_MAX_CLIENTS 4096
+#define LOAD_MAX_PIPELINE 1024
+
+struct load_options {
+    int clients;
+    int seconds;
+    int pipeline;               /** commands in flight per v2 connection, 0 for v1 */
+    const char *socket_path;
+    const char *input;          /** answer to input prompts, such as the repository password */
+    char command[BUFFER_SIZE];
+};
+
+/**
+ * What one client measured
+ */
+struct load_client {
+    pthread_t thread;
+    double *latency_ms;
+    size_t count;
+    size_t cap;
+    unsigned long errors;
+    unsigned long response_bytes;
+
+    /** pipelined runs */
+    int fd;
+    pthread_mutex_t mutex;      /** guards the slots */
+    pthread_mutex_t write_mutex;
+    pthread_cond_t slot_freed;
+    double *sent_ms;            /** per slot, 0 when free */
+    int inflight;
+};
+
+static struct load_options options = {
+    .clients = LOAD_DEFAULT_CLIENTS,
+    .seconds = LOAD_DEFAULT_SECONDS,
+    .socket_path = SOCKET_PATH,
+};
+
+static atomic_int running = 1;
+
+static double now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int read_all(int fd, void *data, size_t len) {
+    char *p = data;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * static int run_command(struct load_client *client)
+ * Send the command on a new connection and read the response to CLI_DONE
+ * @return 0 on success
+ */
+static int run_command(struct load_client *client) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    char header[HEADER_SIZE];
+    char *message = NULL;
+    size_t message_cap = 0;
+    int result = -1;
+    int fd;
+
+    strncpy(addr.sun_path, options.socket_path, sizeof(addr.sun_path) - 1);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || write_all(fd, options.command, strlen(options.command)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    while (read_all(fd, header, HEADER_SIZE) == 0) {
+        uint32_t op_code, bytes_to_come;
+
+        memcpy(&op_code, header, 4);
+        memcpy(&bytes_to_come, header + 4, 4);
+        op_code = ntohl(op_code);
+        bytes_to_come = ntohl(bytes_to_come);
+
+        if (bytes_to_come > message_cap) {
+            char *grown = realloc(message, bytes_to_come);
+            if (!grown) {
+                break;
+            }
+            message = grown;
+            message_cap = bytes_to_come;
+        }
+        if (bytes_to_come && read_all(fd, message, bytes_to_come) < 0) {
+            break;
+        }
+        client->response_bytes += bytes_to_come;
+
+        if (op_code == CLI_DONE) {
+            result = 0;
+            break;
+        }
+        if (op_code == CLI_INPUT || op_code == CLI_INPUT_ECHO_OFF) {
+            char answer[BUFFER_SIZE];
+
+            if (!options.input) {
+                fprintf(stderr, "The daemon asked for input, see --input\n");
+                atomic_store(&running, 0);
+                break;
+            }
+            snprintf(answer, sizeof(answer), "%s\n", options.input);
+            if (write_all(fd, answer, strlen(answer)) < 0) {
+                break;
+            }
+        }
+    }
+
+    free(message);
+    close(fd);
+    return result;
+}
+
+/**
+ * static int send_frame(struct load_client *client, uint32_t id, uint32_t type, const char *payload)
+ * Send a v2 request frame. Caller holds client->write_mutex.
+ * @return 0 on success
+ */
+static int send_frame(struct load_client *client, uint32_t id, uint32_t type, const char *payload) {
+    uint32_t header[4] = { htonl(CLI_PROTOCOL_V2), htonl(id), htonl(type), htonl(strlen(payload)) };
+
+    if (write_all(client->fd, (const char *)header, sizeof(header)) < 0) {
+        return -1;
+    }
+    return write_all(client->fd, payload, strlen(payload));
+}
+
+/**
+ * static void record_latency(struct load_client *client, double ms)
+ * Keep one command's latency
+ */
+static void record_latency(struct load_client *client, double ms) {
+    if (client->count == client->cap) {
+        size_t cap = client->cap ? client->cap * 2 : 1024;
+        double *grown = realloc(client->latency_ms, cap * sizeof(double));
+        if (!grown) {
+            return;
+        }
+        client->latency_ms = grown;
+        client->cap = cap;
+    }
+    client->latency_ms[client->count++] = ms;
+}
+
+/**
+ * static void *pipeline_reader(void *arg)
+ * Read tagged responses, answer input prompts and free a slot on each CLI_DONE
+ */
+static void *pipeline_reader(void *arg) {
+    struct load_client *client = arg;
+    char *message = NULL;
+    size_t message_cap = 0;
+    uint32_t header[3];
+
+    while (read_all(client->fd, header, sizeof(header)) == 0) {
+        uint32_t id = ntohl(header[0]);
+        uint32_t op_code = ntohl(header[1]);
+        uint32_t bytes_to_come = ntohl(header[2]);
+        int slot = id % options.pipeline;
+
+        if (bytes_to_come > message_cap) {
+            char *grown = realloc(message, bytes_to_come);
+            if (!grown) {
+                break;
+            }
+            message = grown;
+            message_cap = bytes_to_come;
+        }
+        if (bytes_to_come && read_all(client->fd, message, bytes_to_come) < 0) {
+            break;
+        }
+
+        pthread_mutex_lock(&client->mutex);
+        client->response_bytes += bytes_to_come;
+        if (op_code == CLI_DONE && client->sent_ms[slot] > 0) {
+            record_latency(client, now_ms() - client->sent_ms[slot]);
+            client->sent_ms[slot] = 0;
+            client->inflight--;
+            pthread_cond_signal(&client->slot_freed);
+        }
+        pthread_mutex_unlock(&client->mutex);
+
+        if (op_code == CLI_INPUT || op_code == CLI_INPUT_ECHO_OFF) {
+            char answer[BUFFER_SIZE];
+
+            if (!options.input) {
+                fprintf(stderr, "The daemon asked for input, see --input\n");
+                atomic_store(&running, 0);
+            }
+            snprintf(answer, sizeof(answer), "%s\n", options.input ? options.input : "");
+            pthread_mutex_lock(&client->write_mutex);
+            send_frame(client, id, CLI_FRAME_INPUT, answer);
+            pthread_mutex_unlock(&client->write_mutex);
+        }
+    }
+
+    /** The connection ended, whatever is in flight failed unless the run is over */
+    pthread_mutex_lock(&client->mutex);
+    if (atomic_load(&running)) {
+        client->errors += client->inflight;
+    }
+    client->inflight = -1;
+    pthread_cond_signal(&client->slot_freed);
+    pthread_mutex_unlock(&client->mutex);
+    free(message);
+    return NULL;
+}
+
+/**
+ * static void pipeline_client(struct load_client *client)
+ * Keep options.pipeline commands in flight on one v2 connection until the
+ * run ends. Request ids are chosen so id % pipeline is the slot.
+ */
+static void pipeline_client(struct load_client *client) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    pthread_t reader;
+    uint32_t next_id = 0;
+
+    strncpy(addr.sun_path, options.socket_path, sizeof(addr.sun_path) - 1);
+    client->sent_ms = calloc(options.pipeline, sizeof(double));
+    if (!client->sent_ms || (client->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        client->errors++;
+        return;
+    }
+    if (connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        client->errors++;
+        close(client->fd);
+        return;
+    }
+    pthread_mutex_init(&client->mutex, NULL);
+    pthread_mutex_init(&client->write_mutex, NULL);
+    pthread_cond_init(&client->slot_freed, NULL);
+    if (pthread_create(&reader, NULL, pipeline_reader, client) != 0) {
+        client->errors++;
+        close(client->fd);
+        return;
+    }
+
+    pthread_mutex_lock(&client->mutex);
+    while (atomic_load(&running) && client->inflight >= 0) {
+        struct timespec until;
+        uint32_t id;
+        int slot, sent;
+
+        if (client->inflight == options.pipeline) {
+            /** Wake up now and then to notice the end of the run */
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 100000000;
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&client->slot_freed, &client->mutex, &until);
+            continue;
+        }
+        for (slot = 0; client->sent_ms[slot] > 0; slot++) {
+        }
+        /** Next id that lands on the free slot */
+        next_id += (slot - (int)(next_id % options.pipeline) + options.pipeline) % options.pipeline;
+
+        client->sent_ms[slot] = now_ms();
+        client->inflight++;
+        id = next_id++;
+        pthread_mutex_unlock(&client->mutex);
+
+        /** Not under client->mutex, the reader must keep draining responses */
+        pthread_mutex_lock(&client->write_mutex);
+        sent = send_frame(client, id, CLI_FRAME_COMMAND, options.command);
+        pthread_mutex_unlock(&client->write_mutex);
+
+        pthread_mutex_lock(&client->mutex);
+        if (sent < 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client->mutex);
+
+    /** Closing ends the reader, responses still in flight are not counted */
+    shutdown(client->fd, SHUT_RDWR);
+    pthread_join(reader, NULL);
+    close(client->fd);
+}
+
+static void *load_client_thread(void *arg) {
+    struct load_client *client = arg;
+
+    if (options.pipeline) {
+        pipeline_client(client);
+        return NULL;
+    }
+
+    while (atomic_load(&running)) {
+        double start = now_ms();
+
+        if (run_command(client) < 0) {
+            client->errors++;
+            continue;
+        }
+        record_latency(client, now_ms() - start);
+    }
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const double *sorted, size_t count, double p) {
+    size_t index;
+
+    if (!count) {
+        return 0;
+    }
+    index = (size_t)(p * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options] [command ...]\n"
+        "  -c, --clients N          concurrent clients (default %d)\n"
+        "  -d, --duration SEC       length of the run (default %d)\n"
+        "  -p, --pipeline N         commands each client keeps in flight on one v2 connection\n"
+        "  -s, --socket PATH        daemon socket (default %s)\n"
+        "  -i, --input TEXT         answer to input prompts, such as the repository password\n"
+        "The command defaults to \"neuron status\".\n",
+        name, LOAD_DEFAULT_CLIENTS, LOAD_DEFAULT_SECONDS, SOCKET_PATH);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        { "clients", required_argument, NULL, 'c' },
+        { "duration", required_argument, NULL, 'd' },
+        { "pipeline", required_argument, NULL, 'p' },
+        { "socket", required_argument, NULL, 's' },
+        { "input", required_argument, NULL, 'i' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct load_client *clients;
+    double *all;
+    size_t total = 0;
+    unsigned long errors = 0;
+    unsigned long bytes = 0;
+    double start, elapsed_ms;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "+c:d:p:s:i:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'c': options.clients = atoi(optarg); break;
+            case 'd': options.seconds = atoi(optarg); break;
+            case 'p': options.pipeline = atoi(optarg); break;
+            case 's': options.socket_path = optarg; break;
+            case 'i': options.input = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (options.clients < 1 || options.clients > LOAD_MAX_CLIENTS || options.seconds < 1
+        || options.pipeline < 0 || options.pipeline > LOAD_MAX_PIPELINE) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            size_t len = strlen(options.command);
+            snprintf(options.command + len, sizeof(options.command) - len, "%s%s", i > optind ? " " : "", argv[i]);
+        }
+    } else {
+        snprintf(options.command, sizeof(options.command), "neuron status");
+    }
+
+    clients = calloc(options.clients, sizeof(*clients));
+    if (!clients) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    printf("cliload: %d clients running \"%s\" for %d seconds", options.clients, options.command, options.seconds);
+    if (options.pipeline) {
+        printf(", %d in flight each", options.pipeline);
+    }
+    printf("\n");
+    start = now_ms();
+    for (int i = 0; i < options.clients; i++) {
+        if (pthread_create(&clients[i].thread, NULL, load_client_thread, &clients[i]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    for (int i = 0; i < options.seconds * 10 && atomic_load(&running); i++) {
+        usleep(100000);
+    }
+    atomic_store(&running, 0);
+    for (int i = 0; i < options.clients; i++) {
+        pthread_join(clients[i].thread, NULL);
+        total += clients[i].count;
+        errors += clients[i].errors;
+        bytes += clients[i].response_bytes;
+    }
+    elapsed_ms = now_ms() - start;
+
+    all = malloc((total ? total : 1) * sizeof(double));
+    if (!all) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    total = 0;
+    for (int i = 0; i < options.clients; i++) {
+        memcpy(all + total, clients[i].latency_ms, clients[i].count * sizeof(double));
+        total += clients[i].count;
+        free(clients[i].latency_ms);
+        free(clients[i].sent_ms);
+    }
+    qsort(all, total, sizeof(double), compare_double);
+
+    printf("\n%10s %8s %12s %12s %9s %9s %9s %9s\n", "COMMANDS", "ERRORS", "COMMANDS/S", "BYTES/S", "P50 MS", "P90 MS", "P99 MS", "MAX MS");
+    printf("%10zu %8lu %12.1f %12.0f %9.3f %9.3f %9.3f %9.3f\n"
+        , total, errors
+        , total * 1000.0 / elapsed_ms
+        , bytes * 1000.0 / elapsed_ms
+        , percentile(all, total, 0.50), percentile(all, total, 0.90), percentile(all, total, 0.99)
+        , total ? all[total - 1] : 0.0);
+
+    free(all);
+    free(clients);
+    return errors && !total ? EXIT_FAILURE : EXIT_SUCCESS;
+}
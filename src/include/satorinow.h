@@ -49,6 +49,38 @@ enum OpCode {
  , CLI_INPUT_ECHO_OFF = 3
 };
 
+/**
+ * CLI protocol v2. Every field is 4 bytes in network byte order.
+ *
+ * Request frame:  <version><request-id><frame-type><bytes-to-come><bytes>
+ * Response frame: <request-id><op-code><bytes-to-come><bytes>
+ *
+ * The version comes first and its first byte is 0, which a v1 command never
+ * starts with, so both protocols share the socket. Requests on a connection
+ * are served concurrently and each one's responses end with its CLI_DONE.
+ * An input prompt is answered with a CLI_FRAME_INPUT frame of the same id.
+ */
+#define CLI_PROTOCOL_V2 2
+#define CLI_V2_REQUEST_HEADER_SIZE 16
+#define CLI_V2_RESPONSE_HEADER_SIZE 12
+#define CLI_V2_MAX_REQUEST (64 * 1024)
+
+enum CliFrameType {
+ CLI_FRAME_COMMAND = 0
+ , CLI_FRAME_INPUT = 1
+};
+
+/**
+ * Output formats, picked with a leading --format <name> on any command.
+ * text is the tables as shown today, json one array of row objects for
+ * the whole command and ndjson one row object per line.
+ */
+enum CliFormat {
+ CLI_FORMAT_TEXT = 0
+ , CLI_FORMAT_JSON = 1
+ , CLI_FORMAT_NDJSON = 2
+};
+
 const char *satnow_config_directory();
 void satnow_shutdown(int signum);
 int satnow_ready_to_shutdown();
@@ -22,6 +22,7 @@
 #ifndef SATORINOW_CLI_H
 #define SATORINOW_CLI_H
 
+#include <sys/types.h>
 #include <satorinow.h>
 
 struct neuron_session;
@@ -31,6 +32,8 @@ struct satnow_cli_args {
     int argc;
     char **argv;
     struct satnow_cli_op *ref;
+    int format;                 /** enum CliFormat */
+    int cancelled;              /** the client hung up, see satnow_cli_cancelled() */
 };
 
 struct satnow_cli_op {
@@ -46,16 +49,38 @@ struct satnow_cli_op {
     struct satnow_cli_op *next;
 };
 
+/**
+ * Activity of the CLI worker pool
+ */
+struct satnow_cli_client_stats {
+    int max_clients;
+    int clients;            /** being served now */
+    int peak;
+    int workers;
+    int idle;
+    unsigned long served;
+    unsigned long pipelined;    /** requests received on v2 connections */
+    unsigned long waits;    /** times a client had to wait for a free worker */
+    unsigned long cancelled;    /** requests given up because their client hung up */
+};
 
 int satnow_cli_register(struct satnow_cli_op *op);
 void satnow_cli_execute(int client_fd, const char *command);
 int satnow_register_core_cli_operations();
 void satnow_cli_request_repository_password(int fd);
+ssize_t satnow_cli_read_input(int fd, char *buffer, size_t size);
+int satnow_cli_detach(struct satnow_cli_args *request, void (*handler)(struct satnow_cli_args *request));
 
-void *satnow_cli_start();
+int satnow_cli_start();
 void satnow_cli_stop();
+void satnow_cli_client_stats(struct satnow_cli_client_stats *stats);
+short satnow_cli_hangup_events(int client_fd);
+int satnow_cli_hungup(int client_fd);
+int satnow_cli_cancelled(struct satnow_cli_args *request);
 
 void satnow_print_cli_operations();
 void satnow_cli_send_response(int client_fd, int op_code, const char *message);
+void satnow_cli_flush(int client_fd);
+void satnow_cli_send_data(int client_fd, int op_code, const char *data, size_t len);
 
 #endif //SATORINOW_CLI_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SATORINOW_CONFIG_H
+#define SATORINOW_CONFIG_H
+
+/**
+ * Runtime settings. Each key indexes a row in the settings table in config.c,
+ * which holds the name used by the 'config' CLI operations, the default value
+ * and the permitted range.
+ */
+enum satnow_config_key {
+    CONFIG_HTTP_CONNECT_TIMEOUT_MS = 0,
+    CONFIG_HTTP_MIN_DEADLINE_MS,
+    CONFIG_HTTP_MAX_DEADLINE_MS,
+    CONFIG_HTTP_RETRIES,
+    CONFIG_HTTP_BACKOFF_MS,
+    CONFIG_HTTP_HEDGE,
+    CONFIG_BREAKER_FAILURES,
+    CONFIG_BREAKER_OPEN_MS,
+    CONFIG_VAULT_READY_TIMEOUT_MS,
+    CONFIG_RESPONSE_CACHE_MS,
+    CONFIG_RESPONSE_REVALIDATE,
+    CONFIG_RESPONSE_CACHE_BYTES,
+    CONFIG_PREFETCH,
+    CONFIG_PREFETCH_RATE,
+    CONFIG_RESPONSE_MEMORY_BYTES,
+    CONFIG_RESPONSE_BUDGET_BYTES,
+    CONFIG_RESPONSE_SPILL_BYTES,
+    CONFIG_TLS_PIN,
+    CONFIG_TLS_VERIFY_CA,
+    CONFIG_CLI_MAX_CLIENTS,
+    CONFIG_MAX
+};
+
+/**
+ * Return the current value of the specified setting
+ * @param key
+ * @return
+ */
+long satnow_config_get(enum satnow_config_key key);
+
+/**
+ * Set the specified setting, clamped to its permitted range
+ * @param key
+ * @param value
+ */
+void satnow_config_set(enum satnow_config_key key, long value);
+
+/**
+ * Register Command Line Operations with the SatoriNOW server
+ * @return
+ */
+int satnow_register_config_cli_operations();
+
+#endif //SATORINOW_CONFIG_H
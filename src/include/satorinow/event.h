@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SATORINOW_EVENT_H
+#define SATORINOW_EVENT_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/**
+ * The daemon's event loop. The main thread sleeps in epoll_wait() until a
+ * registered descriptor is ready, so an idle daemon does not wake up at all.
+ * Callbacks run on the main thread and must not block; slow work belongs on
+ * a worker.
+ *
+ * Registration may be changed from any thread, an event is owned by its
+ * caller and must stay valid until it is removed.
+ */
+struct satnow_event {
+    int fd;
+    void (*callback)(struct satnow_event *event, uint32_t events);
+    void *context;
+};
+
+/**
+ * A one-shot timer on a timerfd, its callback runs on the main thread
+ */
+struct satnow_timer {
+    struct satnow_event event;
+    void (*callback)(void *context);
+    void *context;
+};
+
+int satnow_event_init();
+void satnow_event_shutdown();
+
+/**
+ * Wait for and dispatch events until satnow_event_stop() is called
+ */
+void satnow_event_run();
+
+/**
+ * Make satnow_event_run() return. Safe to call from any thread.
+ */
+void satnow_event_stop();
+
+int satnow_event_add(struct satnow_event *event, uint32_t events);
+int satnow_event_modify(struct satnow_event *event, uint32_t events);
+int satnow_event_remove(struct satnow_event *event);
+
+int satnow_timer_init(struct satnow_timer *timer, void (*callback)(void *context), void *context);
+void satnow_timer_arm(struct satnow_timer *timer, long ms);
+void satnow_timer_close(struct satnow_timer *timer);
+
+#endif //SATORINOW_EVENT_H
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SATORINOW_FANOUT_H
+#define SATORINOW_FANOUT_H
+
+/**
+ * Run fn(index, context) for every index in [0, count) on at most
+ * concurrency threads and return once all of them have finished.
+ * Indexes are handed out in order as threads become free.
+ * @param count
+ * @param concurrency
+ * @param fn
+ * @param context
+ */
+void satnow_fanout(int count, int concurrency, void (*fn)(int index, void *context), void *context);
+
+#endif //SATORINOW_FANOUT_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SATORINOW_HISTOGRAM_H
+#define SATORINOW_HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * Log-linear histogram in the style of HdrHistogram. Values below 32 have
+ * their own bucket, every power of two above that is split into 16 buckets,
+ * so a reported percentile is within 6.25% of the recorded value. Values
+ * past 2^40 land in the last bucket.
+ *
+ * Recording only uses atomic increments, so any number of threads may
+ * record into the same histogram without a lock.
+ */
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_LINEAR_MAX (2 * HISTOGRAM_SUB_BUCKETS)
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR_MAX + (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS - 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct satnow_histogram {
+    unsigned int counts[HISTOGRAM_BUCKETS];
+    unsigned long count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+/**
+ * Record one value
+ * @param h
+ * @param value
+ */
+void satnow_histogram_record(struct satnow_histogram *h, uint64_t value);
+
+/**
+ * Return the value at or below which the given percentage of the recorded
+ * values fall, 0 when nothing has been recorded
+ * @param h
+ * @param percentile
+ * @return
+ */
+uint64_t satnow_histogram_percentile(struct satnow_histogram *h, double percentile);
+
+/**
+ * Return the number of recorded values
+ * @param h
+ * @return
+ */
+unsigned long satnow_histogram_count(struct satnow_histogram *h);
+
+/**
+ * Return the largest recorded value
+ * @param h
+ * @return
+ */
+uint64_t satnow_histogram_max(struct satnow_histogram *h);
+
+/**
+ * Return the mean of the recorded values
+ * @param h
+ * @return
+ */
+double satnow_histogram_mean(struct satnow_histogram *h);
+
+/**
+ * Forget every recorded value. Values recorded while the reset runs may be
+ * partly kept.
+ * @param h
+ */
+void satnow_histogram_reset(struct satnow_histogram *h);
+
+#endif //SATORINOW_HISTOGRAM_H
@@ -23,6 +23,23 @@
 #define HTTP_NEURON_H
 
 #include <stdlib.h>
+#include <stdint.h>
+
+enum neuron_endpoint {
+    NEURON_ENDPOINT_UNLOCK = 0,
+    NEURON_ENDPOINT_MINING_TO_ADDRESS,
+    NEURON_ENDPOINT_POOL_PARTICIPANTS,
+    NEURON_ENDPOINT_PROXY_PARENT_STATUS,
+    NEURON_ENDPOINT_DELEGATE,
+    NEURON_ENDPOINT_SYSTEM_METRICS,
+    NEURON_ENDPOINT_PING,
+    NEURON_ENDPOINT_STATS,
+    NEURON_ENDPOINT_VAULT,
+    NEURON_ENDPOINT_VAULT_TRANSFER,
+    NEURON_ENDPOINT_DECRYPT_VAULT,
+    NEURON_ENDPOINT_VAULT_STATE,
+    NEURON_ENDPOINT_MAX
+};
 
 struct neuron_session {
     char *host;
@@ -32,19 +49,84 @@ struct neuron_session {
     char *csrf_token;
     char *buffer;
     size_t buffer_len;
+    int client_fd;      /** CLI client socket watched for hang-up, 0 when not cancellable */
+    int cancelled;
+    uint64_t digest;    /** content hash of the last read-only response, 0 when unknown */
+    size_t buffer_charged;  /** bytes of buffer counted against the response budget */
+    int spilled;        /** the response outgrew memory and lives in spill_fd */
+    int spill_fd;
+    size_t mapped_len;  /** size of the spill_fd mapping buffer points at, 0 when buffer is on the heap */
+    int passthrough;    /** forward a successful response body to client_fd as it arrives instead of keeping it */
+    size_t forwarded;   /** body bytes of the last request already sent to client_fd */
+};
+
+/**
+ * Timing of one request, as measured by libcurl
+ */
+struct neuron_sample {
+    long status;
+    long connects;          /** new connections the request had to open */
+    double first_byte_ms;
+    double total_ms;
+};
+
+/**
+ * Memory held by neuron responses
+ */
+struct neuron_memory_stats {
+    long budget;            /** response_budget_bytes */
+    long in_use;            /** bytes of response buffers held in memory */
+    long peak;
+    long spilled;           /** bytes of responses held in temp files */
+    unsigned long spills;   /** responses that outgrew memory */
+    unsigned long rejected; /** responses abandoned past response_spill_bytes */
+    long kept;              /** bytes of read-only responses kept for the cache */
+    long kept_max;          /** response_cache_bytes */
+};
+
+/**
+ * Neuron work given up because CLI clients hung up
+ */
+struct neuron_cancel_stats {
+    unsigned long aborted;      /** transfers stopped while running */
+    unsigned long skipped;      /** requests and retries never sent */
+    unsigned long wasted_bytes; /** body bytes the aborted transfers had received */
+};
+
+/**
+ * State of the background prefetch queue
+ */
+struct neuron_prefetch_stats {
+    int queued;
+    int active;
+    unsigned long completed;
+    unsigned long skipped;      /** already cached when their turn came */
+    unsigned long cancelled;
 };
 
 int satnow_http_neuron_mining_to_address(struct neuron_session *session);
 int satnow_http_neuron_decrypt_vault(struct neuron_session *session);
 int satnow_http_neuron_delegate(struct neuron_session *session);
 int satnow_http_neuron_ping(struct neuron_session *session);
+int satnow_http_neuron_ping_sample(struct neuron_session *session, struct neuron_sample *sample);
 int satnow_http_neuron_pool_participants(struct neuron_session *session);
 int satnow_http_neuron_proxy_parent_status(struct neuron_session *session);
 int satnow_http_neuron_system_metrics(struct neuron_session *session);
 int satnow_http_neuron_stats(struct neuron_session *session);
 int satnow_http_neuron_unlock(struct neuron_session *session);
 int satnow_http_neuron_vault(struct neuron_session *session);
-int satnow_http_neuron_vault_transfer(struct neuron_session *session, char *amount_str, char *wallet);
+int satnow_http_neuron_vault_transfer(struct neuron_session *session, const char *amount_str, const char *wallet, int sweep);
+int satnow_http_neuron_wait_vault_ready(struct neuron_session *session);
+int satnow_http_neuron_sleep(struct neuron_session *session, long ms);
+int satnow_http_neuron_prefetch_cancel();
+void satnow_http_neuron_prefetch_stats(struct neuron_prefetch_stats *stats);
+void satnow_http_neuron_buffer_free(struct neuron_session *session);
+void satnow_http_neuron_memory_stats(struct neuron_memory_stats *stats);
+void satnow_http_neuron_cancel_stats(struct neuron_cancel_stats *stats);
+
+const char *satnow_http_neuron_endpoint_name(enum neuron_endpoint endpoint);
+int satnow_http_neuron_init();
+void satnow_http_neuron_shutdown();
 
 
 #endif //HTTP_NEURON_H
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef HTTP_NEURON_HOST_H
+#define HTTP_NEURON_HOST_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <curl/curl.h>
+#include "satorinow/histogram.h"
+#include "satorinow/http/http_neuron.h"
+
+/**
+ * Smoothed latency of one endpoint on one neuron, maintained the same way
+ * TCP maintains SRTT/RTTVAR (RFC 6298)
+ */
+struct neuron_endpoint_latency {
+    double srtt_ms;
+    double rttvar_ms;
+    unsigned long samples;
+};
+
+/**
+ * Response body volume of one endpoint on one neuron
+ */
+struct neuron_endpoint_traffic {
+    unsigned long transfers;
+    unsigned long wire_bytes;       /** as received, possibly compressed */
+    unsigned long decoded_bytes;    /** after content decoding */
+    unsigned long cache_hits;       /** requests answered from the response cache */
+    unsigned long unchanged;        /** responses that were not modified or hashed the same as the last one */
+    unsigned long parses_skipped;   /** renders reused because the response was unchanged */
+};
+
+/**
+ * Last response body of a read-only endpoint, served while it is fresh and
+ * revalidated with the neuron once it is not
+ */
+struct neuron_cached_response {
+    char *body;
+    size_t len;
+    uint64_t digest;                /** content hash of body, never 0 */
+    char *etag;                     /** validators the neuron sent with body, may be NULL */
+    char *last_modified;
+    struct timespec at;
+    int prefetched;                 /** stored by a background prefetch */
+    char *rendered_key;             /** what the CLI rendered body for */
+    char *rendered;                 /** the CLI output rendered from body */
+    size_t rendered_len;
+};
+
+/**
+ * Phases of a request recorded in the timing histograms. Times are in
+ * microseconds. Lookup, connect and TLS are only recorded for transfers
+ * that opened a new connection, so reused connections do not drag them
+ * towards zero.
+ */
+enum neuron_timing {
+    NEURON_TIMING_DNS = 0,      /** name lookup */
+    NEURON_TIMING_CONNECT,      /** TCP connect, after the lookup */
+    NEURON_TIMING_TLS,          /** TLS handshake, after the connect */
+    NEURON_TIMING_FIRST_BYTE,   /** start of the request until the first response byte */
+    NEURON_TIMING_TOTAL,        /** whole transfer */
+    NEURON_TIMING_BYTES,        /** response body bytes as received */
+    NEURON_TIMING_MAX,
+};
+
+/**
+ * Timing histograms of one endpoint on one neuron, allocated on first use
+ */
+struct neuron_endpoint_timing {
+    struct satnow_histogram metrics[NEURON_TIMING_MAX];
+};
+
+/**
+ * Request header lists for every endpoint, built for one session cookie.
+ * A set stays alive while any request holds a reference, even after the
+ * host has moved on to a newer session.
+ */
+struct neuron_headers {
+    int refs;
+    char *session;
+    struct curl_slist *lists[NEURON_ENDPOINT_MAX];
+};
+
+enum neuron_breaker_state {
+    BREAKER_CLOSED = 0,     /** requests flow normally */
+    BREAKER_OPEN,           /** requests fail fast until the open period ends */
+    BREAKER_HALF_OPEN,      /** one /ping probe decides between closed and open */
+};
+
+#define NEURON_ERROR_MAX 128
+/** "sha256//" and the base64 SHA-256 of a DER public key */
+#define NEURON_PIN_MAX 64
+
+/**
+ * State the daemon keeps about a neuron host across requests. Entries are
+ * created on first use and live until satnow_neuron_host_shutdown().
+ */
+struct neuron_host {
+    char *host;
+    pthread_mutex_t mutex;
+    int tls;                        /** registered as https://<ip>:<port> */
+    char *pin;                      /** public key the host is pinned to, NULL until first contact */
+    char *urls[NEURON_ENDPOINT_MAX];
+    struct neuron_headers *headers;
+    struct neuron_endpoint_latency latency[NEURON_ENDPOINT_MAX];
+    struct neuron_endpoint_traffic traffic[NEURON_ENDPOINT_MAX];
+    struct neuron_endpoint_timing *timing[NEURON_ENDPOINT_MAX];   /** updated without nh->mutex */
+    struct neuron_cached_response cache[NEURON_ENDPOINT_MAX];
+    enum neuron_breaker_state breaker;
+    int failures;                   /** consecutive failed requests */
+    unsigned long skipped;          /** requests refused while the breaker was open */
+    struct timespec opened_at;
+    time_t last_error_time;
+    char last_error[NEURON_ERROR_MAX];
+    unsigned long transfers;        /** completed transfers */
+    unsigned long connects;         /** transfers that had to open a new connection */
+    struct neuron_host *next;
+};
+
+/**
+ * Find or create the state for the specified host
+ * @param host
+ * @return
+ */
+struct neuron_host *satnow_neuron_host_get(const char *host);
+
+/**
+ * Fold a completed request's latency into the endpoint's smoothed latency
+ * @param nh
+ * @param endpoint
+ * @param ms
+ */
+void satnow_neuron_host_latency_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, double ms);
+
+/**
+ * Count a completed transfer and whether it opened a new connection
+ * @param nh
+ * @param connects
+ */
+void satnow_neuron_host_connection_sample(struct neuron_host *nh, long connects);
+
+/**
+ * Count the body bytes of a completed transfer, as received and as decoded
+ * @param nh
+ * @param endpoint
+ * @param wire_bytes
+ * @param decoded_bytes
+ */
+void satnow_neuron_host_traffic_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, unsigned long wire_bytes, unsigned long decoded_bytes);
+
+/**
+ * Record one phase of a completed request. Safe to call from any thread
+ * without holding nh->mutex.
+ * @param nh
+ * @param endpoint
+ * @param metric
+ * @param value
+ */
+void satnow_neuron_host_timing_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, enum neuron_timing metric, uint64_t value);
+
+/**
+ * Return the endpoint's timing histograms, or NULL before its first sample
+ * @param nh
+ * @param endpoint
+ * @return
+ */
+struct neuron_endpoint_timing *satnow_neuron_host_timing(struct neuron_host *nh, enum neuron_endpoint endpoint);
+
+/**
+ * Forget the timing histograms of every endpoint on the host
+ * @param nh
+ */
+void satnow_neuron_host_timing_reset(struct neuron_host *nh);
+
+/**
+ * Return the printable name of a timing phase
+ * @param metric
+ * @return
+ */
+const char *satnow_neuron_host_timing_name(enum neuron_timing metric);
+
+/**
+ * Return the content hash used to tell whether a response changed
+ * @param data
+ * @param len
+ * @return a 64 bit FNV-1a hash, never 0
+ */
+uint64_t satnow_neuron_host_digest(const char *data, size_t len);
+
+/**
+ * Keep a copy of the endpoint's response body and its validators. An
+ * identical body keeps the output already rendered from it.
+ * @param nh
+ * @param endpoint
+ * @param body
+ * @param len
+ * @param etag ETag response header, may be NULL
+ * @param last_modified Last-Modified response header, may be NULL
+ * @param prefetched
+ * @param digest receives the body's content hash, may be NULL
+ * @return TRUE when the body is the same as the one it replaced
+ */
+int satnow_neuron_host_cache_put(struct neuron_host *nh, enum neuron_endpoint endpoint, const char *body, size_t len, const char *etag, const char *last_modified, int prefetched, uint64_t *digest);
+
+/**
+ * Return whether read-only responses are kept, for the response cache or
+ * for revalidation
+ * @return
+ */
+int satnow_neuron_host_cache_enabled();
+
+/**
+ * Return the bytes kept read-only responses and their rendered output hold
+ * across all hosts
+ * @return
+ */
+long satnow_neuron_host_cache_bytes();
+
+/**
+ * Drop the oldest kept responses until they fit in response_cache_bytes,
+ * or all of them while responses are not kept
+ */
+void satnow_neuron_host_cache_trim();
+
+/**
+ * Return a copy of the endpoint's cached response body when it is younger
+ * than max_age_ms, counting the hit
+ * @param nh
+ * @param endpoint
+ * @param max_age_ms
+ * @param len receives the body length
+ * @param digest receives the body's content hash, may be NULL
+ * @return the body, to be freed by the caller, or NULL
+ */
+char *satnow_neuron_host_cache_get(struct neuron_host *nh, enum neuron_endpoint endpoint, long max_age_ms, size_t *len, uint64_t *digest);
+
+/**
+ * Copy the validators of the endpoint's cached response for a conditional
+ * request. Empty strings mean the neuron did not send that validator.
+ * @param nh
+ * @param endpoint
+ * @param etag
+ * @param etag_len
+ * @param last_modified
+ * @param last_modified_len
+ * @return TRUE when there is at least one validator
+ */
+int satnow_neuron_host_cache_validators(struct neuron_host *nh, enum neuron_endpoint endpoint, char *etag, size_t etag_len, char *last_modified, size_t last_modified_len);
+
+/**
+ * Return a copy of the endpoint's cached response body after the neuron
+ * answered a conditional request with 304 Not Modified, restarting its age
+ * @param nh
+ * @param endpoint
+ * @param len receives the body length
+ * @param digest receives the body's content hash, may be NULL
+ * @return the body, to be freed by the caller, or NULL when it is gone
+ */
+char *satnow_neuron_host_cache_revalidated(struct neuron_host *nh, enum neuron_endpoint endpoint, size_t *len, uint64_t *digest);
+
+/**
+ * Return a copy of the output rendered from the endpoint's cached response
+ * when the response still has the specified digest and was rendered for the
+ * same key, counting the skipped parse
+ * @param nh
+ * @param endpoint
+ * @param digest
+ * @param key
+ * @return the output, to be freed by the caller, or NULL
+ */
+char *satnow_neuron_host_rendered_get(struct neuron_host *nh, enum neuron_endpoint endpoint, uint64_t digest, const char *key);
+
+/**
+ * Keep the output rendered from the endpoint's cached response, provided
+ * the response still has the specified digest
+ * @param nh
+ * @param endpoint
+ * @param digest
+ * @param key
+ * @param rendered
+ */
+void satnow_neuron_host_rendered_put(struct neuron_host *nh, enum neuron_endpoint endpoint, uint64_t digest, const char *key, const char *rendered);
+
+/**
+ * Return whether the endpoint has a cached response younger than max_age_ms
+ * @param nh
+ * @param endpoint
+ * @param max_age_ms
+ * @return
+ */
+int satnow_neuron_host_cache_fresh(struct neuron_host *nh, enum neuron_endpoint endpoint, long max_age_ms);
+
+/**
+ * Forget every cached response of the host
+ * @param nh
+ */
+void satnow_neuron_host_cache_clear(struct neuron_host *nh);
+
+/**
+ * Return a copy of the public key pinned for an https host
+ * @param nh
+ * @return the pin, to be freed by the caller, or NULL before first contact
+ */
+char *satnow_neuron_host_pin_get(struct neuron_host *nh);
+
+/**
+ * Pin the public key an https host presented on first contact and save it,
+ * unless a key is already pinned
+ * @param nh
+ * @param pin
+ */
+void satnow_neuron_host_pin_learn(struct neuron_host *nh, const char *pin);
+
+/**
+ * Drop the public key pinned for a host
+ * @param host
+ * @return TRUE if a key was pinned
+ */
+int satnow_neuron_host_pin_forget(const char *host);
+
+/**
+ * Call the function for every saved pin, including hosts not contacted since startup
+ * @param fn
+ * @param context
+ */
+void satnow_neuron_host_pin_foreach(void (*fn)(const char *host, const char *pin, void *context), void *context);
+
+/**
+ * Return the deadline for the next request to the endpoint, clamped to
+ * the configured bounds
+ * @param nh
+ * @param endpoint
+ * @return
+ */
+long satnow_neuron_host_deadline_ms(struct neuron_host *nh, enum neuron_endpoint endpoint);
+
+/**
+ * Return the estimated p95 latency of the endpoint, or 0 before any sample
+ * @param nh
+ * @param endpoint
+ * @return
+ */
+long satnow_neuron_host_p95_ms(struct neuron_host *nh, enum neuron_endpoint endpoint);
+
+/**
+ * Decide whether a request may be sent to the host. When the breaker's open
+ * period has ended, the first caller is admitted with *probe set and must
+ * report the outcome of a /ping probe with satnow_neuron_host_probe_result().
+ * @param nh
+ * @param probe
+ * @return
+ */
+int satnow_neuron_host_admit(struct neuron_host *nh, int *probe);
+
+/**
+ * Report the outcome of a half-open probe
+ * @param nh
+ * @param ok
+ * @param error
+ */
+void satnow_neuron_host_probe_result(struct neuron_host *nh, int ok, const char *error);
+
+/**
+ * Report a request that reached the neuron and got a usable answer
+ * @param nh
+ */
+void satnow_neuron_host_success(struct neuron_host *nh);
+
+/**
+ * Report a request that failed to connect or got a server error
+ * @param nh
+ * @param error
+ */
+void satnow_neuron_host_failure(struct neuron_host *nh, const char *error);
+
+/**
+ * Return the printable name of the breaker state
+ * @param state
+ * @return
+ */
+const char *satnow_neuron_host_breaker_name(enum neuron_breaker_state state);
+
+/**
+ * Return the time until an open breaker admits a probe. Caller holds nh->mutex.
+ * @param nh
+ * @return
+ */
+long satnow_neuron_host_retry_in_ms(struct neuron_host *nh);
+
+/**
+ * Call the function for every known host, in no particular order. The host's
+ * mutex is held during the call.
+ * @param fn
+ * @param context
+ */
+void satnow_neuron_host_foreach(void (*fn)(struct neuron_host *nh, void *context), void *context);
+
+/**
+ * Return a reference to the header lists for the session, building them with
+ * the supplied function when the host has none for that session yet
+ * @param nh
+ * @param session
+ * @param build
+ * @return
+ */
+struct neuron_headers *satnow_neuron_host_headers(struct neuron_host *nh, const char *session, struct curl_slist *(*build)(enum neuron_endpoint endpoint, const char *session));
+
+/**
+ * Drop a reference returned by satnow_neuron_host_headers()
+ * @param nh
+ * @param headers
+ */
+void satnow_neuron_host_headers_release(struct neuron_host *nh, struct neuron_headers *headers);
+
+/**
+ * Release all host state
+ */
+void satnow_neuron_host_shutdown();
+
+#endif //HTTP_NEURON_HOST_H
@@ -0,0 +1,978 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * mockneuron: a small local HTTP server that emulates the neuron endpoints
+ * satorinow talks to, so throughput and latency changes can be measured
+ * without a fleet of real neurons.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#define MOCK_DEFAULT_PORT 24601
+#define MOCK_MAX_NEURONS 256
+#define MOCK_MAX_SESSIONS 64
+#define MOCK_REQUEST_MAX (64 * 1024)
+#define MOCK_TOKEN_LEN 32
+
+enum mock_latency {
+    LATENCY_FIXED = 0,
+    LATENCY_UNIFORM,
+    LATENCY_EXP,
+    LATENCY_LOGNORMAL,
+};
+
+struct mock_options {
+    const char *bind;
+    int port;
+    int count;
+    enum mock_latency latency;
+    double latency_a;           /** fixed ms, uniform min, exp mean or lognormal median */
+    double latency_b;           /** uniform max or lognormal sigma */
+    double error_rate;          /** fraction of requests answered with a 503 */
+    double drop_rate;           /** fraction of connections closed instead of answered */
+    int participants;
+    int delegates;
+    size_t vault_bytes;
+    int session_ttl;            /** seconds, 0 never expires */
+    int decrypt_ms;
+    const char *password;       /** passphrase /unlock accepts, NULL accepts any */
+    unsigned int seed;
+    int etag;                   /** tag documents and answer If-None-Match with 304 */
+    const char *cert;           /** PEM certificate, serve https when set */
+    const char *key;            /** PEM private key, defaults to the certificate file */
+    int quiet;
+};
+
+struct mock_session {
+    char token[MOCK_TOKEN_LEN + 1];
+    time_t expires;             /** 0 never expires */
+    long decrypt_at_ms;         /** 0 until /decrypt/vault is posted */
+};
+
+struct mock_neuron {
+    int port;
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    struct mock_session sessions[MOCK_MAX_SESSIONS];
+    int next_session;
+    atomic_ulong connections;
+    atomic_ulong requests;
+    atomic_ulong errors;
+    atomic_ulong drops;
+    atomic_ulong expired;
+};
+
+struct mock_connection {
+    struct mock_neuron *neuron;
+    int fd;
+    SSL *tls;                   /** NULL on plain http */
+    unsigned short rand[3];
+};
+
+struct mock_buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+static struct mock_options options = {
+    .bind = "127.0.0.1",
+    .port = MOCK_DEFAULT_PORT,
+    .count = 1,
+    .latency = LATENCY_FIXED,
+    .participants = 100,
+    .delegates = 10,
+    .vault_bytes = 16 * 1024,
+    .decrypt_ms = 1000,
+};
+
+static struct mock_neuron neurons[MOCK_MAX_NEURONS];
+static atomic_uint connection_serial;
+static SSL_CTX *tls_ctx;
+
+/**
+ * A body that does not change between requests, generated once at startup
+ */
+struct mock_document {
+    struct mock_buffer body;
+    char etag[24];
+};
+
+static struct mock_document participants_json;
+static struct mock_document delegates_json;
+static struct mock_document parent_status_json;
+
+static long now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static void buffer_reserve(struct mock_buffer *buffer, size_t extra) {
+    if (buffer->len + extra + 1 <= buffer->cap) {
+        return;
+    }
+    size_t cap = buffer->cap ? buffer->cap : 1024;
+    while (cap < buffer->len + extra + 1) {
+        cap *= 2;
+    }
+    char *data = realloc(buffer->data, cap);
+    if (!data) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    buffer->data = data;
+    buffer->cap = cap;
+}
+
+static void buffer_append(struct mock_buffer *buffer, const char *data, size_t len) {
+    buffer_reserve(buffer, len);
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    buffer->data[buffer->len] = '\0';
+}
+
+static void buffer_printf(struct mock_buffer *buffer, const char *fmt, ...) {
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    buffer_reserve(buffer, len);
+    va_start(ap, fmt);
+    vsnprintf(buffer->data + buffer->len, len + 1, fmt, ap);
+    va_end(ap);
+    buffer->len += len;
+}
+
+static void buffer_free(struct mock_buffer *buffer) {
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+/**
+ * static void wallet_address(char *out, size_t size, char prefix, int index)
+ * Derive a stable, address shaped string for participant index
+ * @param out
+ * @param size
+ * @param prefix
+ * @param index
+ */
+static void wallet_address(char *out, size_t size, char prefix, int index) {
+    static const char alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    unsigned int x = (unsigned int)index * 2654435761u + (unsigned int)prefix;
+    size_t i;
+
+    out[0] = prefix;
+    for (i = 1; i < 34 && i < size - 1; i++) {
+        x = x * 1103515245u + 12345u;
+        out[i] = alphabet[(x >> 16) % (sizeof(alphabet) - 1)];
+    }
+    out[i] = '\0';
+}
+
+static void build_participants(struct mock_buffer *buffer, int count) {
+    char address[40], vault[40];
+
+    buffer_append(buffer, "[", 1);
+    for (int i = 0; i < count; i++) {
+        wallet_address(address, sizeof(address), 'E', i);
+        wallet_address(vault, sizeof(vault), 'V', i);
+        buffer_printf(buffer,
+            "%s{\"parent\": 1, \"child\": %d, \"charity\": %d, \"automatic\": %d, \"address\": \"%s\", "
+            "\"vaultaddress\": \"%s\", \"reward\": %.4f, \"pointed\": %d, \"ts\": \"2025-01-28 22:34:51\"}",
+            i ? ", " : "", i + 2, i % 7 == 0, i % 3 != 0, address, vault, 0.1 + (i % 50) / 100.0, i % 5 != 0);
+    }
+    buffer_append(buffer, "]", 1);
+}
+
+static void build_delegates(struct mock_buffer *buffer, int count) {
+    char address[40], vault[40];
+
+    buffer_append(buffer, "[", 1);
+    for (int i = 0; i < count; i++) {
+        wallet_address(address, sizeof(address), 'E', i + 1000000);
+        wallet_address(vault, sizeof(vault), 'V', i + 1000000);
+        buffer_printf(buffer,
+            "%s{\"wallet\": \"%s\", \"vault\": \"%s\", \"alias\": \"mock-%d\", \"offer\": %.2f, \"accepting\": %d}",
+            i ? ", " : "", address, vault, i, 0.5 + (i % 10) / 20.0, i % 4 != 0);
+    }
+    buffer_append(buffer, "]", 1);
+}
+
+/**
+ * static double mock_latency_ms(struct mock_connection *conn)
+ * Draw a response delay from the configured distribution
+ * @param conn
+ * @return delay in milliseconds
+ */
+static double mock_latency_ms(struct mock_connection *conn) {
+    double u;
+
+    switch (options.latency) {
+        case LATENCY_UNIFORM:
+            return options.latency_a + (options.latency_b - options.latency_a) * erand48(conn->rand);
+        case LATENCY_EXP:
+            u = erand48(conn->rand);
+            return -options.latency_a * log(1.0 - u);
+        case LATENCY_LOGNORMAL: {
+            /** Box-Muller standard normal */
+            double u1 = 1.0 - erand48(conn->rand);
+            double u2 = erand48(conn->rand);
+            double z = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+            return options.latency_a * exp(options.latency_b * z);
+        }
+        case LATENCY_FIXED:
+        default:
+            return options.latency_a;
+    }
+}
+
+static void mock_sleep_ms(double ms) {
+    if (ms <= 0) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = (time_t)(ms / 1000), .tv_nsec = (long)fmod(ms, 1000.0) * 1000000L };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+static struct mock_session *session_lookup(struct mock_neuron *neuron, const char *cookie, int *expired) {
+    const char *token;
+
+    *expired = 0;
+    if (!cookie || !(token = strstr(cookie, "session="))) {
+        return NULL;
+    }
+    token += strlen("session=");
+    for (int i = 0; i < MOCK_MAX_SESSIONS; i++) {
+        struct mock_session *session = &neuron->sessions[i];
+        if (session->token[0] && !strncmp(session->token, token, MOCK_TOKEN_LEN)) {
+            if (session->expires && time(NULL) >= session->expires) {
+                session->token[0] = '\0';
+                *expired = 1;
+                return NULL;
+            }
+            return session;
+        }
+    }
+    return NULL;
+}
+
+static struct mock_session *session_create(struct mock_neuron *neuron, struct mock_connection *conn) {
+    struct mock_session *session = &neuron->sessions[neuron->next_session];
+
+    neuron->next_session = (neuron->next_session + 1) % MOCK_MAX_SESSIONS;
+    for (int i = 0; i < MOCK_TOKEN_LEN; i++) {
+        session->token[i] = "0123456789abcdef"[nrand48(conn->rand) & 0xf];
+    }
+    session->token[MOCK_TOKEN_LEN] = '\0';
+    session->expires = options.session_ttl ? time(NULL) + options.session_ttl : 0;
+    session->decrypt_at_ms = 0;
+    return session;
+}
+
+/**
+ * static int passphrase_matches(const char *body)
+ * Compare the form encoded passphrase field with the configured password
+ * @param body
+ * @return 1 on match
+ */
+static int passphrase_matches(const char *body) {
+    char value[256];
+    const char *p;
+    size_t n = 0;
+
+    if (!options.password) {
+        return 1;
+    }
+    if (!body || !(p = strstr(body, "passphrase="))) {
+        return 0;
+    }
+    for (p += strlen("passphrase="); *p && *p != '&' && n < sizeof(value) - 1; p++) {
+        if (*p == '%' && p[1] && p[2]) {
+            char hex[3] = { p[1], p[2], '\0' };
+            value[n++] = (char)strtol(hex, NULL, 16);
+            p += 2;
+        } else {
+            value[n++] = *p == '+' ? ' ' : *p;
+        }
+    }
+    value[n] = '\0';
+    return !strcmp(value, options.password);
+}
+
+static ssize_t conn_recv(struct mock_connection *conn, char *data, size_t len) {
+    if (conn->tls) {
+        int n = SSL_read(conn->tls, data, len > INT_MAX ? INT_MAX : (int)len);
+        return n > 0 ? n : (SSL_get_error(conn->tls, n) == SSL_ERROR_ZERO_RETURN ? 0 : -1);
+    }
+    return recv(conn->fd, data, len, 0);
+}
+
+static int send_all(struct mock_connection *conn, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent;
+
+        if (conn->tls) {
+            sent = SSL_write(conn->tls, data, len > INT_MAX ? INT_MAX : (int)len);
+            if (sent <= 0) {
+                return -1;
+            }
+        } else {
+            sent = send(conn->fd, data, len, MSG_NOSIGNAL);
+        }
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+static int send_response(struct mock_connection *conn, int status, const char *content_type, const char *extra_headers, const char *body, size_t body_len, int keep_alive) {
+    const char *reason;
+    char header[1024];
+    int header_len;
+
+    switch (status) {
+        case 200: reason = "OK"; break;
+        case 302: reason = "FOUND"; break;
+        case 304: reason = "NOT MODIFIED"; break;
+        case 404: reason = "NOT FOUND"; break;
+        case 503: reason = "SERVICE UNAVAILABLE"; break;
+        default: reason = "ERROR"; break;
+    }
+
+    header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 %d %s\r\n"
+        "Server: mockneuron\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: %s\r\n"
+        "%s"
+        "\r\n",
+        status, reason, content_type, body_len, keep_alive ? "keep-alive" : "close", extra_headers ? extra_headers : "");
+
+    if (send_all(conn, header, header_len) < 0) {
+        return -1;
+    }
+    return send_all(conn, body, body_len);
+}
+
+static void document_tag(struct mock_document *doc) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < doc->body.len; i++) {
+        hash ^= (unsigned char)doc->body.data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    snprintf(doc->etag, sizeof(doc->etag), "\"%016llx\"", (unsigned long long)hash);
+}
+
+/**
+ * static int send_document(struct mock_connection *conn, const struct mock_document *doc, const char *if_none_match, int keep_alive, int *status)
+ * Send a static JSON document, or 304 when the client already holds it
+ */
+static int send_document(struct mock_connection *conn, const struct mock_document *doc, const char *if_none_match, int keep_alive, int *status) {
+    char headers[64];
+
+    if (!options.etag) {
+        *status = 200;
+        return send_response(conn, 200, "application/json", NULL, doc->body.data, doc->body.len, keep_alive);
+    }
+    snprintf(headers, sizeof(headers), "ETag: %s\r\n", doc->etag);
+    if (if_none_match && !strcmp(if_none_match, doc->etag)) {
+        *status = 304;
+        return send_response(conn, 304, "application/json", headers, "", 0, keep_alive);
+    }
+    *status = 200;
+    return send_response(conn, 200, "application/json", headers, doc->body.data, doc->body.len, keep_alive);
+}
+
+static void build_login_page(struct mock_buffer *page) {
+    buffer_printf(page,
+        "<html><head><title>Satori Neuron</title></head><body>\n"
+        "<form method=\"POST\" action=\"/unlock\">\n"
+        "<input id=\"csrf_token\" name=\"csrf_token\" type=\"hidden\" value=\"mock-login-%08lx\">\n"
+        "<input name=\"passphrase\" type=\"password\">\n"
+        "</form></body></html>\n", (unsigned long)now_ms());
+}
+
+static void build_vault_page(struct mock_buffer *page, struct mock_session *session) {
+    static const char filler[] = "<tr><td class=\"wallet\">mock</td><td class=\"balance\">0.00000000</td></tr>\n";
+    char vault[40];
+    int decrypted = session->decrypt_at_ms && now_ms() >= session->decrypt_at_ms;
+
+    wallet_address(vault, sizeof(vault), 'V', -1);
+    buffer_printf(page,
+        "<html><head><title>Satori Vault</title></head><body>\n"
+        "<form method=\"POST\" action=\"/decrypt/vault\">\n"
+        "<input id=\"csrf_token\" name=\"csrf_token\" type=\"hidden\" value=\"mock-%.16s\">\n"
+        "</form>\n<table>\n", session->token);
+    while (page->len + sizeof(filler) < options.vault_bytes) {
+        buffer_append(page, filler, sizeof(filler) - 1);
+    }
+    buffer_append(page, "</table>\n", strlen("</table>\n"));
+    if (decrypted) {
+        buffer_printf(page,
+            "<p>Vault: %s</p>\n"
+            "<form method=\"POST\" action=\"/send_satori_transaction_from_vault/main\">\n"
+            "<input name=\"address\" type=\"text\"><input name=\"amount\" type=\"text\">\n"
+            "</form>\n", vault);
+    }
+    buffer_append(page, "</body></html>\n", strlen("</body></html>\n"));
+}
+
+static void build_system_metrics(struct mock_buffer *body, struct mock_connection *conn) {
+    time_t now = time(NULL);
+    double cpu = 5.0 + 90.0 * erand48(conn->rand);
+    double mem = 20.0 + 60.0 * erand48(conn->rand);
+
+    buffer_printf(body,
+        "{\"boot_time\": %ld, \"cpu\": \"Mock CPU @ 3.00GHz\", \"cpu_count\": 8, \"cpu_usage_percent\": %.1f, "
+        "\"disk\": {\"free\": 400000000000, \"percent\": 20.0, \"total\": 500000000000, \"used\": 100000000000}, "
+        "\"memory\": {\"active\": 4000000000, \"available\": %ld, \"buffers\": 100000000, \"cached\": 2000000000, "
+        "\"free\": 1000000000, \"inactive\": 1000000000, \"percent\": %.1f, \"shared\": 50000000, \"slab\": 300000000, "
+        "\"total\": 16000000000, \"used\": %ld}, "
+        "\"memory_available_percent\": %.1f, \"memory_total_gb\": 16, "
+        "\"swap\": {\"free\": 2000000000, \"percent\": 0.0, \"sin\": 0, \"sout\": 0, \"total\": 2000000000, \"used\": 0}, "
+        "\"timestamp\": %ld, \"uptime\": 86400, \"version\": \"mock\"}",
+        (long)now - 86400, cpu,
+        (long)(16000000000.0 * (100.0 - mem) / 100.0), mem, (long)(16000000000.0 * mem / 100.0),
+        100.0 - mem, (long)now);
+}
+
+/**
+ * static int requires_session(const char *path)
+ * Whether the neuron only answers path for an unlocked session
+ * @param path
+ * @return 1 if a session cookie is needed
+ */
+static int requires_session(const char *path) {
+    static const char *paths[] = {
+        "/vault",
+        "/decrypt/vault",
+        "/send_satori_transaction_from_vault/",
+        "/system_metrics",
+        "/fetch/wallet/stats/daily",
+        "/proxy/parent/status",
+        "/pool/participants",
+        "/mining/to/address",
+    };
+
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        size_t len = strlen(paths[i]);
+        if (!strncmp(path, paths[i], len) && (path[len] == '\0' || paths[i][len - 1] == '/')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * static int mock_route(struct mock_connection *conn, const char *method, const char *path, const char *cookie, const char *if_none_match, const char *body, int keep_alive)
+ * Answer one request the way a neuron would
+ * @return 0 to keep the connection, -1 to close it
+ */
+static int mock_route(struct mock_connection *conn, const char *method, const char *path, const char *cookie, const char *if_none_match, const char *body, int keep_alive) {
+    struct mock_neuron *neuron = conn->neuron;
+    struct mock_buffer page = { 0 };
+    struct mock_session *session = NULL;
+    char headers[256];
+    int is_post = !strcasecmp(method, "POST");
+    int expired = 0;
+    int status = 200;
+    int result;
+
+    if (erand48(conn->rand) < options.drop_rate) {
+        atomic_fetch_add(&neuron->drops, 1);
+        status = 0;
+        result = -1;
+        goto done;
+    }
+    mock_sleep_ms(mock_latency_ms(conn));
+    if (erand48(conn->rand) < options.error_rate) {
+        static const char unavailable[] = "{\"error\": \"mock neuron unavailable\"}";
+        atomic_fetch_add(&neuron->errors, 1);
+        status = 503;
+        result = send_response(conn, status, "application/json", NULL, unavailable, sizeof(unavailable) - 1, keep_alive);
+        goto done;
+    }
+
+    /** Endpoints that need an unlocked session redirect to the login page without one */
+    if (requires_session(path)) {
+        pthread_mutex_lock(&neuron->mutex);
+        session = session_lookup(neuron, cookie, &expired);
+        if (session) {
+            struct mock_session copy;
+            if (!strcmp(path, "/decrypt/vault") && is_post) {
+                session->decrypt_at_ms = now_ms() + options.decrypt_ms;
+            }
+            copy = *session;
+            pthread_mutex_unlock(&neuron->mutex);
+            if (!strcmp(path, "/decrypt/vault") && is_post) {
+                buffer_printf(&page, "{\"success\": true}");
+            } else if (!strcmp(path, "/vault")) {
+                build_vault_page(&page, &copy);
+            } else if (!strncmp(path, "/send_satori_transaction_from_vault/", 36) && is_post) {
+                if (!copy.decrypt_at_ms || now_ms() < copy.decrypt_at_ms) {
+                    status = 302;
+                    snprintf(headers, sizeof(headers), "Location: /vault\r\n");
+                } else {
+                    buffer_printf(&page, "<html><body><p>Transaction submitted.</p></body></html>\n");
+                }
+            } else if (!strcmp(path, "/pool/participants")) {
+                result = send_document(conn, &participants_json, if_none_match, keep_alive, &status);
+                goto done;
+            } else if (!strcmp(path, "/system_metrics")) {
+                build_system_metrics(&page, conn);
+            } else if (!strcmp(path, "/proxy/parent/status")) {
+                result = send_document(conn, &parent_status_json, if_none_match, keep_alive, &status);
+                goto done;
+            } else if (!strcmp(path, "/mining/to/address")) {
+                char address[40];
+                wallet_address(address, sizeof(address), 'E', neuron->port);
+                buffer_printf(&page, "%s", address);
+            } else if (!strcmp(path, "/fetch/wallet/stats/daily")) {
+                buffer_printf(&page, "This Neuron has participated in %d competitions today, with an average placement of %d out of 100.",
+                    (int)(nrand48(conn->rand) % 500), (int)(nrand48(conn->rand) % 100) + 1);
+            } else {
+                status = 404;
+            }
+        } else {
+            pthread_mutex_unlock(&neuron->mutex);
+            if (expired) {
+                atomic_fetch_add(&neuron->expired, 1);
+            }
+            status = 302;
+            snprintf(headers, sizeof(headers), "Location: /unlock\r\n");
+        }
+    } else if (!strcmp(path, "/unlock")) {
+        if (is_post && passphrase_matches(body)) {
+            pthread_mutex_lock(&neuron->mutex);
+            session = session_create(neuron, conn);
+            snprintf(headers, sizeof(headers), "Location: /vault\r\nSet-Cookie: session=%s; HttpOnly; Path=/\r\n", session->token);
+            pthread_mutex_unlock(&neuron->mutex);
+            status = 302;
+        } else {
+            build_login_page(&page);
+        }
+    } else if (!strcmp(path, "/ping")) {
+        char stamp[32];
+        time_t now = time(NULL);
+        struct tm tm;
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &tm));
+        buffer_printf(&page, "{\"now\": \"%s\"}", stamp);
+    } else if (!strcmp(path, "/delegate/get")) {
+        result = send_document(conn, &delegates_json, if_none_match, keep_alive, &status);
+        goto done;
+    } else {
+        status = 404;
+    }
+
+    result = send_response(conn, status,
+        page.len && (page.data[0] == '{' || page.data[0] == '[') ? "application/json" : "text/html; charset=utf-8",
+        status == 302 ? headers : NULL, page.data ? page.data : "", page.len, keep_alive);
+done:
+    if (!options.quiet) {
+        if (status) {
+            printf("%d %s %s %d\n", neuron->port, method, path, status);
+        } else {
+            printf("%d %s %s dropped\n", neuron->port, method, path);
+        }
+    }
+    buffer_free(&page);
+    return result;
+}
+
+static const char *header_value(const char *headers, const char *name, char *out, size_t size) {
+    size_t name_len = strlen(name);
+
+    for (const char *line = headers; line && *line; line = strstr(line, "\r\n") ? strstr(line, "\r\n") + 2 : NULL) {
+        if (!strncasecmp(line, name, name_len) && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            const char *end = strstr(value, "\r\n");
+            size_t len;
+            while (*value == ' ') {
+                value++;
+            }
+            len = end ? (size_t)(end - value) : strlen(value);
+            if (len >= size) {
+                len = size - 1;
+            }
+            memcpy(out, value, len);
+            out[len] = '\0';
+            return out;
+        }
+        if (!strncmp(line, "\r\n", 2)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * static void *mock_connection_thread(void *arg)
+ * Serve keep-alive requests on one client connection until it closes
+ * @param arg
+ */
+static void *mock_connection_thread(void *arg) {
+    struct mock_connection *conn = arg;
+    char *request = malloc(MOCK_REQUEST_MAX + 1);
+    size_t len = 0;
+
+    if (tls_ctx) {
+        conn->tls = SSL_new(tls_ctx);
+        if (!conn->tls || !SSL_set_fd(conn->tls, conn->fd) || SSL_accept(conn->tls) <= 0) {
+            goto out;
+        }
+    }
+
+    while (request) {
+        char method[16], path[512], value[1024], cookie[1024], if_none_match[64];
+        char *end = NULL;
+        size_t header_len, content_length = 0;
+        int keep_alive;
+
+        while (!(end = strstr(request, "\r\n\r\n"))) {
+            ssize_t n;
+            if (len >= MOCK_REQUEST_MAX) {
+                goto out;
+            }
+            n = conn_recv(conn, request + len, MOCK_REQUEST_MAX - len);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                goto out;
+            }
+            len += n;
+            request[len] = '\0';
+        }
+        header_len = end - request + 4;
+
+        if (sscanf(request, "%15s %511s", method, path) != 2) {
+            goto out;
+        }
+        if (header_value(request, "Content-Length", value, sizeof(value))) {
+            content_length = strtoul(value, NULL, 10);
+        }
+        if (header_len + content_length > MOCK_REQUEST_MAX) {
+            goto out;
+        }
+        keep_alive = !(header_value(request, "Connection", value, sizeof(value)) && !strcasecmp(value, "close"));
+        if (!header_value(request, "Cookie", cookie, sizeof(cookie))) {
+            cookie[0] = '\0';
+        }
+        if (!header_value(request, "If-None-Match", if_none_match, sizeof(if_none_match))) {
+            if_none_match[0] = '\0';
+        }
+
+        while (len < header_len + content_length) {
+            ssize_t n = conn_recv(conn, request + len, header_len + content_length - len);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                goto out;
+            }
+            len += n;
+        }
+
+        char *body = strndup(request + header_len, content_length);
+        atomic_fetch_add(&conn->neuron->requests, 1);
+        int result = mock_route(conn, method, path, cookie[0] ? cookie : NULL, if_none_match[0] ? if_none_match : NULL, body, keep_alive);
+        free(body);
+        if (result < 0 || !keep_alive) {
+            break;
+        }
+
+        /** keep any pipelined bytes that followed this request */
+        len -= header_len + content_length;
+        memmove(request, request + header_len + content_length, len);
+        request[len] = '\0';
+    }
+
+out:
+    if (conn->tls) {
+        SSL_shutdown(conn->tls);
+        SSL_free(conn->tls);
+    }
+    close(conn->fd);
+    free(request);
+    free(conn);
+    return NULL;
+}
+
+static void *mock_listener_thread(void *arg) {
+    struct mock_neuron *neuron = arg;
+
+    for (;;) {
+        int fd = accept(neuron->fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct mock_connection *conn = calloc(1, sizeof(*conn));
+        unsigned int serial = atomic_fetch_add(&connection_serial, 1);
+        conn->neuron = neuron;
+        conn->fd = fd;
+        conn->rand[0] = (unsigned short)options.seed;
+        conn->rand[1] = (unsigned short)neuron->port;
+        conn->rand[2] = (unsigned short)serial;
+        atomic_fetch_add(&neuron->connections, 1);
+
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, mock_connection_thread, conn) != 0) {
+            perror("pthread_create");
+            close(fd);
+            free(conn);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return NULL;
+}
+
+static int mock_listen(const char *address, int port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int one = 1;
+    int fd;
+
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid bind address '%s'\n", address);
+        return -1;
+    }
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        fprintf(stderr, "Unable to listen on %s:%d: %s\n", address, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * static int parse_latency(const char *spec)
+ * Parse fixed:MS, uniform:MIN:MAX, exp:MEAN or lognormal:MEDIAN:SIGMA
+ * @param spec
+ * @return 0 on success
+ */
+static int parse_latency(const char *spec) {
+    if (sscanf(spec, "fixed:%lf", &options.latency_a) == 1) {
+        options.latency = LATENCY_FIXED;
+    } else if (sscanf(spec, "uniform:%lf:%lf", &options.latency_a, &options.latency_b) == 2 && options.latency_b >= options.latency_a) {
+        options.latency = LATENCY_UNIFORM;
+    } else if (sscanf(spec, "exp:%lf", &options.latency_a) == 1) {
+        options.latency = LATENCY_EXP;
+    } else if (sscanf(spec, "lognormal:%lf:%lf", &options.latency_a, &options.latency_b) == 2) {
+        options.latency = LATENCY_LOGNORMAL;
+    } else {
+        return -1;
+    }
+    return options.latency_a < 0 ? -1 : 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p, --port PORT          first port to listen on (default %d)\n"
+        "  -n, --count N            neurons to emulate on consecutive ports (default 1)\n"
+        "  -b, --bind ADDRESS       address to listen on (default 127.0.0.1)\n"
+        "  -l, --latency SPEC       fixed:MS, uniform:MIN:MAX, exp:MEAN or lognormal:MEDIAN:SIGMA (default fixed:0)\n"
+        "  -e, --error-rate P       fraction of requests answered with 503 (default 0)\n"
+        "  -d, --drop-rate P        fraction of requests whose connection is closed unanswered (default 0)\n"
+        "  -P, --participants N     pool participants returned by /pool/participants (default 100)\n"
+        "  -g, --delegates N        entries returned by /delegate/get and /proxy/parent/status (default 10)\n"
+        "  -v, --vault-bytes N      size of the /vault page (default 16384)\n"
+        "  -t, --session-ttl SEC    seconds an unlocked session stays valid, 0 forever (default 0)\n"
+        "  -D, --decrypt-ms MS      time the vault takes to decrypt (default 1000)\n"
+        "  -w, --password PASS      passphrase /unlock accepts (default any)\n"
+        "  -s, --seed N             random seed (default 0)\n"
+        "  -E, --etag               send ETags with the participant and delegate lists, 304 when unchanged\n"
+        "  -C, --cert FILE          serve https with this PEM certificate\n"
+        "  -K, --key FILE           PEM private key of the certificate (default the certificate file)\n"
+        "  -q, --quiet              do not log requests\n",
+        name, MOCK_DEFAULT_PORT);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        { "port", required_argument, NULL, 'p' },
+        { "count", required_argument, NULL, 'n' },
+        { "bind", required_argument, NULL, 'b' },
+        { "latency", required_argument, NULL, 'l' },
+        { "error-rate", required_argument, NULL, 'e' },
+        { "drop-rate", required_argument, NULL, 'd' },
+        { "participants", required_argument, NULL, 'P' },
+        { "delegates", required_argument, NULL, 'g' },
+        { "vault-bytes", required_argument, NULL, 'v' },
+        { "session-ttl", required_argument, NULL, 't' },
+        { "decrypt-ms", required_argument, NULL, 'D' },
+        { "password", required_argument, NULL, 'w' },
+        { "seed", required_argument, NULL, 's' },
+        { "etag", no_argument, NULL, 'E' },
+        { "cert", required_argument, NULL, 'C' },
+        { "key", required_argument, NULL, 'K' },
+        { "quiet", no_argument, NULL, 'q' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    sigset_t signals;
+    int signal_number;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "p:n:b:l:e:d:P:g:v:t:D:w:s:EC:K:qh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'p': options.port = atoi(optarg); break;
+            case 'n': options.count = atoi(optarg); break;
+            case 'b': options.bind = optarg; break;
+            case 'l':
+                if (parse_latency(optarg) < 0) {
+                    fprintf(stderr, "Invalid latency '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'e': options.error_rate = atof(optarg); break;
+            case 'd': options.drop_rate = atof(optarg); break;
+            case 'P': options.participants = atoi(optarg); break;
+            case 'g': options.delegates = atoi(optarg); break;
+            case 'v': options.vault_bytes = strtoul(optarg, NULL, 10); break;
+            case 't': options.session_ttl = atoi(optarg); break;
+            case 'D': options.decrypt_ms = atoi(optarg); break;
+            case 'w': options.password = optarg; break;
+            case 's': options.seed = strtoul(optarg, NULL, 10); break;
+            case 'E': options.etag = 1; break;
+            case 'C': options.cert = optarg; break;
+            case 'K': options.key = optarg; break;
+            case 'q': options.quiet = 1; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (options.count < 1 || options.count > MOCK_MAX_NEURONS || options.port < 1 || options.port + options.count - 1 > 65535
+        || options.participants < 0 || options.delegates < 0 || options.session_ttl < 0 || options.decrypt_ms < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    build_participants(&participants_json.body, options.participants);
+    build_delegates(&delegates_json.body, options.delegates);
+    build_participants(&parent_status_json.body, options.delegates);
+    document_tag(&participants_json);
+    document_tag(&delegates_json);
+    document_tag(&parent_status_json);
+
+    if (options.cert) {
+        /** Default server settings issue TLS 1.3 session tickets, so clients can resume */
+        tls_ctx = SSL_CTX_new(TLS_server_method());
+        if (!tls_ctx
+            || SSL_CTX_use_certificate_chain_file(tls_ctx, options.cert) != 1
+            || SSL_CTX_use_PrivateKey_file(tls_ctx, options.key ? options.key : options.cert, SSL_FILETYPE_PEM) != 1
+            || SSL_CTX_check_private_key(tls_ctx) != 1) {
+            fprintf(stderr, "Unable to load the certificate and key from %s\n", options.cert);
+            ERR_print_errors_fp(stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /** Listener and connection threads inherit the mask, main waits for the signals */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    for (int i = 0; i < options.count; i++) {
+        struct mock_neuron *neuron = &neurons[i];
+        neuron->port = options.port + i;
+        pthread_mutex_init(&neuron->mutex, NULL);
+        if ((neuron->fd = mock_listen(options.bind, neuron->port)) < 0) {
+            return EXIT_FAILURE;
+        }
+        if (pthread_create(&neuron->thread, NULL, mock_listener_thread, neuron) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    printf("mockneuron: %d %s neuron%s on %s:%d-%d, %d participants, %zu byte vault\n"
+        , options.count, tls_ctx ? "https" : "http", options.count == 1 ? "" : "s", options.bind, options.port, options.port + options.count - 1
+        , options.participants, options.vault_bytes);
+
+    sigwait(&signals, &signal_number);
+
+    printf("\n%6s\t%11s\t%9s\t%7s\t%6s\t%8s\n", "PORT", "CONNECTIONS", "REQUESTS", "ERRORS", "DROPS", "EXPIRED");
+    for (int i = 0; i < options.count; i++) {
+        struct mock_neuron *neuron = &neurons[i];
+        printf("%6d\t%11lu\t%9lu\t%7lu\t%6lu\t%8lu\n", neuron->port
+            , atomic_load(&neuron->connections), atomic_load(&neuron->requests), atomic_load(&neuron->errors)
+            , atomic_load(&neuron->drops), atomic_load(&neuron->expired));
+    }
+    return EXIT_SUCCESS;
+}
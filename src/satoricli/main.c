@@ -23,6 +23,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -30,6 +34,29 @@
 #include <arpa/inet.h>
 #include <satorinow.h>
 
+#define SHELL_PROMPT "satorinow> "
+#define SHELL_HISTORY "shell_history"
+#define SHELL_HISTORY_MAX 500
+
+/** Output format asked for with --format, sent ahead of every command */
+static const char *output_format = NULL;
+
+/**
+ * static const char *format_command(const char *command, char *buffer, size_t size)
+ * Prefix the command with the requested output format, if any
+ * @param command
+ * @param buffer
+ * @param size
+ * @return the command to send
+ */
+static const char *format_command(const char *command, char *buffer, size_t size) {
+    if (!output_format) {
+        return command;
+    }
+    snprintf(buffer, size, "--format %s %s", output_format, command);
+    return buffer;
+}
+
 /**
  * static void disable_echo()
  * Disable TTY ECHO to hide sensitive input from user
@@ -64,9 +91,15 @@ static void read_fixed_header(int client_fd, int *op_code, int *bytes_to_come) {
     char header[HEADER_SIZE];
     memset(header, 0, HEADER_SIZE);
 
-    if (read(client_fd, header, HEADER_SIZE) != HEADER_SIZE) {
-        perror("Error reading header");
-        exit(EXIT_FAILURE);
+    /** Several messages arrive together, a header may be split across reads */
+    for (int received = 0; received < HEADER_SIZE; ) {
+        ssize_t rx = read(client_fd, header + received, HEADER_SIZE - received);
+
+        if (rx <= 0) {
+            perror("Error reading header");
+            exit(EXIT_FAILURE);
+        }
+        received += rx;
     }
 
     /**
@@ -95,16 +128,543 @@ static void read_message(int client_fd, int bytes_to_come) {
 
     if (bytes_to_come > 0) {
         buffer = calloc(1, bytes_to_come + 1);
-        if (read(client_fd, buffer, bytes_to_come) != bytes_to_come) {
-            perror("Error reading message");
-            free(buffer);
-            exit(EXIT_FAILURE);
+        /** Large messages arrive in several reads */
+        for (int received = 0; received < bytes_to_come; ) {
+            ssize_t rx = read(client_fd, buffer + received, bytes_to_come - received);
+
+            if (rx <= 0) {
+                perror("Error reading message");
+                free(buffer);
+                exit(EXIT_FAILURE);
+            }
+            received += rx;
         }
         printf("%s", buffer);
+        /** Rows reach a pipe as they arrive, not when the command ends */
+        fflush(stdout);
         free(buffer);
     }
 }
 
+/**
+ * A command sent in batch mode and the response collected for it
+ */
+struct batch_request {
+    char *command;
+    char *response;
+    size_t response_len;
+    int done;
+};
+
+/**
+ * A growable byte buffer
+ */
+struct batch_buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+/**
+ * static int buffer_append(struct batch_buffer *buffer, const void *data, size_t len)
+ * Append bytes to the buffer
+ * @param buffer
+ * @param data
+ * @param len
+ * @return 0 on success, -1 out of memory
+ */
+static int buffer_append(struct batch_buffer *buffer, const void *data, size_t len) {
+    if (buffer->len + len > buffer->cap) {
+        size_t cap = buffer->cap ? buffer->cap : 4096;
+        char *grown;
+
+        while (cap < buffer->len + len) {
+            cap *= 2;
+        }
+        grown = realloc(buffer->data, cap);
+        if (!grown) {
+            return -1;
+        }
+        buffer->data = grown;
+        buffer->cap = cap;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 0;
+}
+
+/**
+ * static int append_frame(struct batch_buffer *out, uint32_t id, uint32_t type, const char *payload)
+ * Append a protocol v2 request frame
+ * @param out
+ * @param id
+ * @param type
+ * @param payload
+ * @return 0 on success, -1 out of memory
+ */
+static int append_frame(struct batch_buffer *out, uint32_t id, uint32_t type, const char *payload) {
+    uint32_t header[4] = { htonl(CLI_PROTOCOL_V2), htonl(id), htonl(type), htonl(strlen(payload)) };
+
+    if (buffer_append(out, header, sizeof(header)) == -1) {
+        return -1;
+    }
+    return buffer_append(out, payload, strlen(payload));
+}
+
+/**
+ * static void batch_prompt(const char *prompt, int echo, char *answer, size_t size)
+ * Ask the user at the terminal, stdin holds the commands
+ * @param prompt
+ * @param echo
+ * @param answer
+ * @param size
+ */
+static void batch_prompt(const char *prompt, int echo, char *answer, size_t size) {
+    FILE *tty = fopen("/dev/tty", "r+");
+    struct termios saved, quiet;
+
+    snprintf(answer, size, "\n");
+    if (!tty) {
+        fprintf(stderr, "%s no terminal to answer from\n", prompt);
+        return;
+    }
+
+    fprintf(tty, "%s", prompt);
+    fflush(tty);
+    if (!echo && tcgetattr(fileno(tty), &saved) == 0) {
+        quiet = saved;
+        quiet.c_lflag &= ~ECHO;
+        tcsetattr(fileno(tty), TCSANOW, &quiet);
+    }
+    if (fgets(answer, (int)size, tty) == NULL) {
+        snprintf(answer, size, "\n");
+    }
+    if (!echo) {
+        tcsetattr(fileno(tty), TCSANOW, &saved);
+    }
+    fprintf(tty, "\n");
+    fclose(tty);
+}
+
+/**
+ * static int run_batch(int client_fd)
+ * Read commands from stdin, one per line, send them all at once on a
+ * protocol v2 connection and print each response, in command order, as
+ * soon as it and those before it are complete
+ * @param client_fd
+ * @return 0 on success, -1 if the daemon hung up early
+ */
+static int run_batch(int client_fd) {
+    struct batch_request *requests = NULL;
+    struct batch_buffer out = { 0 }, in = { 0 };
+    size_t count = 0, cap = 0, printed = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    char formatted[CLI_V2_MAX_REQUEST];
+
+    while ((line_len = getline(&line, &line_cap, stdin)) != -1) {
+        while (line_len > 0 && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r')) {
+            line[--line_len] = '\0';
+        }
+        if (line_len == 0) {
+            continue;
+        }
+        if (count == cap) {
+            struct batch_request *grown;
+
+            cap = cap ? cap * 2 : 64;
+            grown = realloc(requests, cap * sizeof(*requests));
+            if (!grown) {
+                perror("realloc");
+                return -1;
+            }
+            requests = grown;
+        }
+        memset(&requests[count], 0, sizeof(requests[count]));
+        requests[count].command = strdup(line);
+        if (!requests[count].command || append_frame(&out, (uint32_t)count, CLI_FRAME_COMMAND, format_command(line, formatted, sizeof(formatted))) == -1) {
+            perror("batch");
+            return -1;
+        }
+        count++;
+    }
+    free(line);
+
+    /** Write and read together, the daemon answers while commands are still being sent */
+    fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+    size_t sent = 0;
+    while (printed < count) {
+        struct pollfd pfd = { client_fd, POLLIN | (sent < out.len ? POLLOUT : 0), 0 };
+        char chunk[65536];
+        ssize_t n;
+
+        if (poll(&pfd, 1, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return -1;
+        }
+
+        if ((pfd.revents & POLLOUT) && sent < out.len) {
+            n = write(client_fd, out.data + sent, out.len - sent);
+            if (n == -1 && errno != EAGAIN && errno != EINTR) {
+                perror("Error writing to socket");
+                return -1;
+            }
+            sent += n > 0 ? (size_t)n : 0;
+        }
+
+        if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+        n = read(client_fd, chunk, sizeof(chunk));
+        if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "The SatoriNOW daemon hung up\n");
+            return -1;
+        }
+        if (buffer_append(&in, chunk, n) == -1) {
+            perror("batch");
+            return -1;
+        }
+
+        /** Collect the complete response frames */
+        size_t offset = 0;
+        while (in.len - offset >= CLI_V2_RESPONSE_HEADER_SIZE) {
+            uint32_t header[3];
+            uint32_t id, op_code, bytes_to_come;
+            struct batch_request *request;
+
+            memcpy(header, in.data + offset, sizeof(header));
+            id = ntohl(header[0]);
+            op_code = ntohl(header[1]);
+            bytes_to_come = ntohl(header[2]);
+            if (in.len - offset - CLI_V2_RESPONSE_HEADER_SIZE < bytes_to_come) {
+                break;
+            }
+            offset += CLI_V2_RESPONSE_HEADER_SIZE;
+            if (id >= count) {
+                offset += bytes_to_come;
+                continue;
+            }
+            request = &requests[id];
+
+            if (op_code == CLI_INPUT || op_code == CLI_INPUT_ECHO_OFF) {
+                char prompt[BUFFER_SIZE];
+                char answer[BUFFER_SIZE];
+
+                snprintf(prompt, sizeof(prompt), "[%s] %.*s", request->command, (int)bytes_to_come, in.data + offset);
+                batch_prompt(prompt, op_code == CLI_INPUT, answer, sizeof(answer));
+                if (append_frame(&out, id, CLI_FRAME_INPUT, answer) == -1) {
+                    perror("batch");
+                    return -1;
+                }
+            } else {
+                char *grown = realloc(request->response, request->response_len + bytes_to_come + 1);
+
+                if (!grown) {
+                    perror("batch");
+                    return -1;
+                }
+                request->response = grown;
+                memcpy(request->response + request->response_len, in.data + offset, bytes_to_come);
+                request->response_len += bytes_to_come;
+                request->response[request->response_len] = '\0';
+                request->done = op_code == CLI_DONE;
+            }
+            offset += bytes_to_come;
+        }
+        memmove(in.data, in.data + offset, in.len - offset);
+        in.len -= offset;
+
+        while (printed < count && requests[printed].done) {
+            if (requests[printed].response) {
+                fwrite(requests[printed].response, 1, requests[printed].response_len, stdout);
+            }
+            free(requests[printed].response);
+            free(requests[printed].command);
+            printed++;
+        }
+        fflush(stdout);
+    }
+
+    free(requests);
+    free(out.data);
+    free(in.data);
+    return 0;
+}
+
+/**
+ * static int read_full(int fd, void *data, size_t len)
+ * Read exactly len bytes
+ * @param fd
+ * @param data
+ * @param len
+ * @return 0 on success, -1 if the daemon hung up
+ */
+static int read_full(int fd, void *data, size_t len) {
+    char *p = data;
+
+    while (len > 0) {
+        ssize_t rx = read(fd, p, len);
+
+        if (rx == -1 && errno == EINTR) {
+            continue;
+        }
+        if (rx <= 0) {
+            return -1;
+        }
+        p += rx;
+        len -= rx;
+    }
+    return 0;
+}
+
+/**
+ * static int send_frame(int fd, uint32_t id, uint32_t type, const char *payload)
+ * Send a protocol v2 request frame
+ * @param fd
+ * @param id
+ * @param type
+ * @param payload
+ * @return 0 on success, -1 on failure
+ */
+static int send_frame(int fd, uint32_t id, uint32_t type, const char *payload) {
+    struct batch_buffer frame = { 0 };
+    size_t sent = 0;
+
+    if (append_frame(&frame, id, type, payload) == -1) {
+        return -1;
+    }
+    while (sent < frame.len) {
+        ssize_t tx = write(fd, frame.data + sent, frame.len - sent);
+
+        if (tx == -1 && errno == EINTR) {
+            continue;
+        }
+        if (tx <= 0) {
+            free(frame.data);
+            return -1;
+        }
+        sent += tx;
+    }
+    free(frame.data);
+    return 0;
+}
+
+/**
+ * static int shell_command(int client_fd, uint32_t id, const char *command)
+ * Run one command over the shell's connection, printing its response as it
+ * streams in and answering prompts from stdin
+ * @param client_fd
+ * @param id
+ * @param command
+ * @return 0 on success, -1 if the daemon hung up
+ */
+static int shell_command(int client_fd, uint32_t id, const char *command) {
+    char *message = NULL;
+    size_t message_cap = 0;
+
+    if (send_frame(client_fd, id, CLI_FRAME_COMMAND, command) == -1) {
+        return -1;
+    }
+
+    for (;;) {
+        uint32_t header[3];
+        uint32_t op_code, bytes_to_come;
+
+        if (read_full(client_fd, header, sizeof(header)) == -1) {
+            free(message);
+            return -1;
+        }
+        op_code = ntohl(header[1]);
+        bytes_to_come = ntohl(header[2]);
+        if (bytes_to_come + 1 > message_cap) {
+            char *grown = realloc(message, bytes_to_come + 1);
+
+            if (!grown) {
+                free(message);
+                return -1;
+            }
+            message = grown;
+            message_cap = bytes_to_come + 1;
+        }
+        if (read_full(client_fd, message, bytes_to_come) == -1) {
+            free(message);
+            return -1;
+        }
+        message[bytes_to_come] = '\0';
+
+        /** Only one command runs at a time, so every frame is this command's */
+        printf("%s", message);
+        fflush(stdout);
+
+        if (op_code == CLI_DONE) {
+            break;
+        }
+        if (op_code == CLI_INPUT || op_code == CLI_INPUT_ECHO_OFF) {
+            char answer[BUFFER_SIZE];
+
+            if (op_code == CLI_INPUT_ECHO_OFF) {
+                disable_echo();
+            }
+            if (fgets(answer, sizeof(answer), stdin) == NULL) {
+                snprintf(answer, sizeof(answer), "\n");
+            }
+            if (op_code == CLI_INPUT_ECHO_OFF) {
+                enable_echo();
+            }
+            printf("\n");
+            if (send_frame(client_fd, id, CLI_FRAME_INPUT, answer) == -1) {
+                free(message);
+                return -1;
+            }
+        }
+    }
+
+    free(message);
+    return 0;
+}
+
+/**
+ * static FILE *shell_history_open(char **history, int *count)
+ * Load the saved shell history and open it for appending
+ * @param history
+ * @param count
+ * @return the history file, or NULL if it cannot be written
+ */
+static FILE *shell_history_open(char **history, int *count) {
+    const char *home = getenv("HOME");
+    char path[BUFFER_SIZE];
+    char line[BUFFER_SIZE];
+    FILE *file;
+
+    *count = 0;
+    if (!home) {
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "%s/%s/%s", home, CONFIG_DIR, SHELL_HISTORY);
+
+    file = fopen(path, "r");
+    if (file) {
+        while (fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\n")] = '\0';
+            if (*count == SHELL_HISTORY_MAX) {
+                free(history[0]);
+                memmove(history, history + 1, (SHELL_HISTORY_MAX - 1) * sizeof(*history));
+                (*count)--;
+            }
+            history[(*count)++] = strdup(line);
+        }
+        fclose(file);
+    }
+
+    return fopen(path, "a");
+}
+
+/**
+ * static int run_shell(int client_fd)
+ * Read commands at a prompt and run them one after the other over one
+ * protocol v2 connection. "time <command>" also shows the round trip,
+ * "history" lists earlier commands and "!!" or "!<n>" runs one again.
+ * @param client_fd
+ * @return 0 on success, -1 if the daemon hung up
+ */
+static int run_shell(int client_fd) {
+    char *history[SHELL_HISTORY_MAX];
+    char line[BUFFER_SIZE];
+    char formatted[BUFFER_SIZE + 64];
+    int interactive = isatty(STDIN_FILENO);
+    uint32_t id = 0;
+    int count;
+    FILE *saved = shell_history_open(history, &count);
+    int result = 0;
+
+    for (;;) {
+        struct timespec start, end;
+        const char *command = line;
+        int timed = FALSE;
+
+        if (interactive) {
+            printf(SHELL_PROMPT);
+            fflush(stdout);
+        }
+        if (!fgets(line, sizeof(line), stdin)) {
+            if (interactive) {
+                printf("\n");
+            }
+            break;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        while (*command == ' ' || *command == '\t') {
+            command++;
+        }
+        if (!*command) {
+            continue;
+        }
+
+        if (!strcmp(command, "exit") || !strcmp(command, "quit")) {
+            break;
+        }
+        if (!strcmp(command, "history")) {
+            for (int i = 0; i < count; i++) {
+                printf("%5d  %s\n", i + 1, history[i]);
+            }
+            continue;
+        }
+        if (command[0] == '!') {
+            int n = !strcmp(command, "!!") ? count : atoi(command + 1);
+
+            if (n < 1 || n > count) {
+                printf("%s: event not found\n", command);
+                continue;
+            }
+            snprintf(line, sizeof(line), "%s", history[n - 1]);
+            command = line;
+            printf("%s\n", command);
+        }
+
+        if (count == SHELL_HISTORY_MAX) {
+            free(history[0]);
+            memmove(history, history + 1, (SHELL_HISTORY_MAX - 1) * sizeof(*history));
+            count--;
+        }
+        history[count++] = strdup(command);
+        if (saved) {
+            fprintf(saved, "%s\n", command);
+            fflush(saved);
+        }
+
+        if (!strncmp(command, "time ", 5)) {
+            timed = TRUE;
+            command += 5;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (shell_command(client_fd, id++, format_command(command, formatted, sizeof(formatted))) == -1) {
+            fprintf(stderr, "The SatoriNOW daemon hung up\n");
+            result = -1;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (timed) {
+            printf("time: %.3f ms\n", (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(history[i]);
+    }
+    if (saved) {
+        fclose(saved);
+    }
+    return result;
+}
+
 /**
  * int main(int argc, char *argv[])
  * This is the main function for the SatoriNOW CLI client
@@ -120,11 +680,30 @@ int main(int argc, char *argv[]) {
     char buffer[BUFFER_SIZE];
     ssize_t tx;
 
+    /**
+     * A leading --format <name> asks for text, json or ndjson output, for
+     * the command or for every command of a batch or shell
+     */
+    if (argc > 1 && (!strcmp(argv[1], "--format") || !strncmp(argv[1], "--format=", 9))) {
+        int shift = argv[1][8] == '=' ? 1 : 2;
+
+        output_format = argv[1][8] == '=' ? argv[1] + 9 : argc > 2 ? argv[2] : "";
+        if (strcmp(output_format, "text") && strcmp(output_format, "json") && strcmp(output_format, "ndjson")) {
+            fprintf(stderr, "%s: unknown output format '%s', use text, json or ndjson\n", argv[0], output_format);
+            exit(EXIT_FAILURE);
+        }
+        argv[shift] = argv[0];
+        argv += shift;
+        argc -= shift;
+    }
+
     /**
      * Make sure we have at least a one work command from the user
      */
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <command>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--format (text | json | ndjson)] <command>\n", argv[0]);
+        fprintf(stderr, "       %s -        run the commands on stdin, one per line, over one connection\n", argv[0]);
+        fprintf(stderr, "       %s shell    run commands at a prompt over one connection\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -146,12 +725,29 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    if (argc == 2 && !strcmp(argv[1], "shell")) {
+        int result = run_shell(client_fd);
+
+        close(client_fd);
+        return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc == 2 && !strcmp(argv[1], "-")) {
+        int result = run_batch(client_fd);
+
+        close(client_fd);
+        return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     /**
      * Send the user's requested command to the SatoriNOW server
      */
     memset(buffer, 0, sizeof(buffer));
+    if (output_format) {
+        snprintf(buffer, BUFFER_SIZE - 1, "--format %s", output_format);
+    }
     for (int i = 1; i < argc; i++) {
-        if (i > 1) {
+        if (i > 1 || output_format) {
             snprintf(&buffer[strlen(buffer)], BUFFER_SIZE - strlen(buffer) - 1, " ");
         }
         snprintf(&buffer[strlen(buffer)], BUFFER_SIZE - strlen(buffer) - 1, "%s", argv[i]);
@@ -19,33 +19,175 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <satorinow.h>
 #include "satorinow/cli.h"
+#include "satorinow/config.h"
+#include "satorinow/event.h"
+#include "satorinow/http/http_neuron.h"
 #include "satorinow/repository.h"
 
-static int server_fd = -1;
-pthread_mutex_t server_fd_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** The listening socket, watched by the event loop */
+static struct satnow_event listen_event = { .fd = -1 };
+
+/**
+ * One word of a registered command, lowercased. Siblings are kept in
+ * alphabetic order, so a depth first walk visits the operations sorted as
+ * help lists them. The trie is built while operations are registered at
+ * startup and is read-only once satnow_cli_start() publishes it, so
+ * dispatch walks it without a lock.
+ */
+struct cli_trie_node {
+    char *word;
+    struct satnow_cli_op *op;           /** the command ending at this word, if any */
+    struct cli_trie_node *children;
+    struct cli_trie_node *sibling;
+};
+
+static struct cli_trie_node op_trie;
+static pthread_mutex_t op_trie_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int op_trie_published = FALSE;
+
+/**
+ * Messages for the client being served by this thread, sent with one
+ * syscall when the buffer fills, on an input prompt or on CLI_DONE
+ */
+#define CLI_OUTPUT_BUFFER (64 * 1024)
+
+struct cli_client;
+
+static __thread struct {
+    int fd;
+    struct cli_client *stream;      /** the v2 request fd belongs to, NULL for a v1 client */
+    size_t len;
+    char data[CLI_OUTPUT_BUFFER];
+} output = { .fd = -1 };
+
+/**
+ * A request that continues on its own thread after the CLI thread has moved
+ * on to the next client. It owns copies of the arguments and the connection.
+ */
+struct cli_detached {
+    struct satnow_cli_args args;
+    char *argv[SATNOW_CLI_MAX_COMMAND_WORDS];
+    void (*handler)(struct satnow_cli_args *request);
+    struct cli_detached *next;
+};
 
-static struct satnow_cli_op *op_list_head = NULL;
-pthread_mutex_t op_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct cli_detached *detached_head = NULL;
+static pthread_mutex_t detached_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t detached_cond = PTHREAD_COND_INITIALIZER;
+
+/** Requests a v2 connection may have in flight before it is no longer read */
+#define CLI_V2_MAX_INFLIGHT 256
+
+struct cli_connection;
+
+/**
+ * A request, waiting for its command, queued for a worker or being served
+ * by one. A v1 client sends one command on a connection of its own. Each
+ * request of a v2 connection is served through a dup() of the connection,
+ * so its responses can be told apart by descriptor.
+ */
+struct cli_client {
+    int fd;
+    struct satnow_event event;          /** v1: readable once the command has arrived */
+    char *command;
+    struct cli_connection *connection;  /** v2 only */
+    uint32_t id;
+    char *input;                        /** v2: answer to an input prompt */
+    size_t input_len;
+    struct cli_client *next;
+    struct cli_client *stream_next;     /** v2: in the streams list */
+};
+
+/**
+ * A v2 connection, read by the event loop for request frames until the
+ * client shuts down its sending side. Requests in flight then still finish
+ * and the connection closes with the last one.
+ */
+struct cli_connection {
+    int fd;
+    struct satnow_event event;
+    pthread_mutex_t mutex;              /** guards the fields below and the requests' input */
+    pthread_mutex_t write_mutex;        /** keeps frames of concurrent requests whole */
+    pthread_cond_t input_cond;
+    int inflight;
+    int refs;                           /** the event loop's and one per request in flight */
+    int hungup;                         /** the client is gone, requests in flight are cancelled */
+    int closed;                         /** no longer read, no more requests or input will come */
+    int paused;                         /** too many requests in flight, not read */
+    char *rx;                           /** partial frame, event loop only */
+    size_t rx_len;
+    struct cli_connection *next;
+};
+
+/**
+ * Workers that serve CLI requests. The event loop reads each client's
+ * command and queues it; once cli_max_clients are connected it stops
+ * accepting, so later clients wait in the socket backlog. Up to
+ * cli_max_clients workers are started as needed and stay for reuse.
+ */
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;            /** a client was queued, a worker freed up or the pool is stopping */
+    struct cli_client *reading;     /** accepted, command not read yet */
+    struct cli_client *queue;       /** waiting for a worker, oldest first */
+    struct cli_client **queue_tail;
+    struct cli_client *serving;     /** being served, hung up on when the daemon stops */
+    struct cli_connection *connections;
+    int workers;
+    int idle;                       /** workers waiting for a client */
+    int clients;                    /** connected, in any of the above or on a v2 connection */
+    int peak;
+    int paused;                     /** not accepting until a client finishes */
+    int stopping;
+    unsigned long served;
+    unsigned long pipelined;        /** requests received on v2 connections */
+    unsigned long waits;            /** times accepting paused for a free slot */
+    unsigned long cancelled;        /** requests given up because their client hung up */
+} pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .queue_tail = &pool.queue,
+};
 
-static int op_list_size = 0;
+/** v2 requests in flight, found by descriptor when responding */
+static struct cli_client *streams = NULL;
+static pthread_mutex_t streams_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void send_header(int client_fd, int op_code, int bytes_to_come);
+static void cli_worker_start();
+static void cli_trie_walk(struct cli_trie_node *node, void (*visit)(struct satnow_cli_op *op, void *context), void *context);
+static void cli_trie_free(struct cli_trie_node *node);
+static char *cli_daemon_stats(struct satnow_cli_args *request);
 static char *cli_show_help(struct satnow_cli_args *request);
 static char *cli_shutdown(struct satnow_cli_args *request);
 
 static struct satnow_cli_op satori_cli_operations[] = {
     {
+        { "daemon", "stats", NULL }
+        , "Display the daemon's resource usage"
+        , "Usage: daemon stats"
+        , 0
+        , 0
+        , 0
+        , cli_daemon_stats
+        , 0
+    },{
         { "help", NULL }
         , "Display supported commands"
         , "Usage: help"
@@ -80,40 +222,107 @@ static char *cli_shutdown(struct satnow_cli_args *request) {
 
 
 /**
- * cli_show_help(int client_fd)
- * Display the available CLI operations
- * @param client_fd
+ * static char *cli_daemon_stats(struct satnow_cli_args *request)
+ * Display the daemon's resource usage
+ * @param request
+ * @return
  */
-static char *cli_show_help(struct satnow_cli_args *request) {
+static char *cli_daemon_stats(struct satnow_cli_args *request) {
+    struct neuron_memory_stats memory;
+    struct neuron_cancel_stats cancel;
+    struct satnow_cli_client_stats clients;
+    char tbuf[BUFFER_SIZE];
+
+    satnow_http_neuron_memory_stats(&memory);
+    snprintf(tbuf, sizeof(tbuf)
+        , "RESPONSE MEMORY\n"
+        "  budget:   %12ld bytes\n"
+        "  in use:   %12ld bytes (%.1f%%)\n"
+        "  peak:     %12ld bytes\n"
+        "  spilled:  %12ld bytes in temp files\n"
+        "  spills:   %12lu responses\n"
+        "  rejected: %12lu responses\n"
+        "  kept:     %12ld bytes of %ld for the cache\n"
+        , memory.budget
+        , memory.in_use, memory.budget ? 100.0 * memory.in_use / memory.budget : 0.0
+        , memory.peak
+        , memory.spilled
+        , memory.spills
+        , memory.rejected
+        , memory.kept, memory.kept_max);
+    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+
+    satnow_cli_client_stats(&clients);
+    snprintf(tbuf, sizeof(tbuf)
+        , "\nCLI CLIENTS\n"
+        "  max:      %12d at once\n"
+        "  current:  %12d\n"
+        "  peak:     %12d\n"
+        "  workers:  %12d (%d idle)\n"
+        "  served:   %12lu\n"
+        "  pipelined:%12lu on v2 connections\n"
+        "  waits:    %12lu for a free worker\n"
+        , clients.max_clients
+        , clients.clients
+        , clients.peak
+        , clients.workers, clients.idle
+        , clients.served
+        , clients.pipelined
+        , clients.waits);
+    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+
+    satnow_http_neuron_cancel_stats(&cancel);
+    snprintf(tbuf, sizeof(tbuf)
+        , "\nCANCELLED WORK\n"
+        "  requests: %12lu client hung up\n"
+        "  aborted:  %12lu neuron transfers\n"
+        "  skipped:  %12lu neuron requests\n"
+        "  wasted:   %12lu bytes received\n"
+        , clients.cancelled
+        , cancel.aborted
+        , cancel.skipped
+        , cancel.wasted_bytes);
+    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+
+    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    return 0;
+}
+
+/**
+ * static void cli_help_line(struct satnow_cli_op *op, void *context)
+ * Send one operation's line of the help listing
+ * @param op
+ * @param context the request
+ */
+static void cli_help_line(struct satnow_cli_op *op, void *context) {
+    struct satnow_cli_args *request = context;
     char response[BUFFER_SIZE];
-    struct satnow_cli_op *current = NULL;
-
-    pthread_mutex_lock(&op_list_mutex);
-    current = op_list_head;
-
-    while (current) {
-        size_t response_len = snprintf(response, sizeof(response), "%s", current->command[0]);
-        for (int i = 1; current->command[i]; i++) {
-            response_len += snprintf(response + response_len, sizeof(response) - response_len, " %s", current->command[i]);
-            if (response_len >= sizeof(response) - 1) {
-                /** Don't exceed the buffer */
-                break;
-            }
-        }
 
-        response_len += snprintf(response + response_len, sizeof(response) - response_len, " - %s\n", current->description);
+    size_t response_len = snprintf(response, sizeof(response), "%s", op->command[0]);
+    for (int i = 1; op->command[i]; i++) {
+        response_len += snprintf(response + response_len, sizeof(response) - response_len, " %s", op->command[i]);
         if (response_len >= sizeof(response) - 1) {
-            response[sizeof(response) - 1] = '\0';
+            /** Don't exceed the buffer */
+            break;
         }
+    }
 
-        satnow_cli_send_response(request->fd, CLI_MORE, response);
-        current = current->next;
+    response_len += snprintf(response + response_len, sizeof(response) - response_len, " - %s\n", op->description);
+    if (response_len >= sizeof(response) - 1) {
+        response[sizeof(response) - 1] = '\0';
     }
 
-    pthread_mutex_unlock(&op_list_mutex);
+    satnow_cli_send_response(request->fd, CLI_MORE, response);
+}
 
-    snprintf(response, sizeof(response), "\n");
-    satnow_cli_send_response(request->fd, CLI_DONE, response);
+/**
+ * cli_show_help(int client_fd)
+ * Display the available CLI operations
+ * @param client_fd
+ */
+static char *cli_show_help(struct satnow_cli_args *request) {
+    cli_trie_walk(&op_trie, cli_help_line, request);
+    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
 
     return NULL;
 }
@@ -140,23 +349,523 @@ int satnow_register_core_cli_operations() {
 
 
 /**
- * void *satnow_cli_start()
- * Main processing loop for the CLI socket engine
- * @return
+ * static void cli_client_unlink(struct cli_client **head, struct cli_client *client)
+ * Remove the client from one of the pool's lists. Caller holds pool.mutex.
+ * @param head
+ * @param client
  */
-void *satnow_cli_start() {
-    struct sockaddr_un server_addr;
-    char buffer[BUFFER_SIZE];
-    int client_fd;
+static void cli_client_unlink(struct cli_client **head, struct cli_client *client) {
+    for (struct cli_client **link = head; *link; link = &(*link)->next) {
+        if (*link == client) {
+            *link = client->next;
+            break;
+        }
+    }
+}
+
+/**
+ * static void cli_listen_resume()
+ * Accept again if accepting paused and a slot is free. Caller holds pool.mutex.
+ */
+static void cli_listen_resume() {
+    if (pool.paused && !pool.stopping && pool.clients < satnow_config_get(CONFIG_CLI_MAX_CLIENTS)) {
+        if (satnow_event_modify(&listen_event, EPOLLIN) == 0) {
+            pool.paused = FALSE;
+        }
+    }
+}
+
+/**
+ * static void cli_client_release(struct cli_client *client)
+ * Hang up on a v1 client and free its slot. Caller holds pool.mutex.
+ * @param client
+ */
+static void cli_client_release(struct cli_client *client) {
+    close(client->fd);
+    free(client->command);
+    free(client);
+    pool.clients--;
+    cli_listen_resume();
+}
+
+/**
+ * static void cli_queue(struct cli_client *client)
+ * Queue a request for a worker. Caller holds pool.mutex.
+ * @param client
+ */
+static void cli_queue(struct cli_client *client) {
+    client->next = NULL;
+    *pool.queue_tail = client;
+    pool.queue_tail = &client->next;
+    if (pool.idle == 0 && pool.workers < satnow_config_get(CONFIG_CLI_MAX_CLIENTS)) {
+        cli_worker_start();
+    }
+    pthread_cond_broadcast(&pool.cond);
+}
+
+/**
+ * static struct cli_client *cli_stream_find(int fd)
+ * Find the v2 request served through the descriptor
+ * @param fd
+ * @return the request, or NULL for a v1 client
+ */
+static struct cli_client *cli_stream_find(int fd) {
+    struct cli_client *client;
+
+    pthread_mutex_lock(&streams_mutex);
+    for (client = streams; client && client->fd != fd; client = client->stream_next) {
+    }
+    pthread_mutex_unlock(&streams_mutex);
+
+    return client;
+}
+
+/**
+ * static void cli_connection_release(struct cli_connection *connection)
+ * Drop a reference to a v2 connection, the last one closes it and frees its
+ * slot. Caller holds pool.mutex.
+ * @param connection
+ */
+static void cli_connection_release(struct cli_connection *connection) {
+    int refs;
+
+    pthread_mutex_lock(&connection->mutex);
+    refs = --connection->refs;
+    pthread_mutex_unlock(&connection->mutex);
+    if (refs > 0) {
+        return;
+    }
+
+    for (struct cli_connection **link = &pool.connections; *link; link = &(*link)->next) {
+        if (*link == connection) {
+            *link = connection->next;
+            break;
+        }
+    }
+    close(connection->fd);
+    pthread_mutex_destroy(&connection->mutex);
+    pthread_mutex_destroy(&connection->write_mutex);
+    pthread_cond_destroy(&connection->input_cond);
+    free(connection->rx);
+    free(connection);
+    pool.clients--;
+    cli_listen_resume();
+}
+
+/**
+ * static void cli_client_done(struct cli_client *client)
+ * Release a request that was served or will not be. Caller holds pool.mutex.
+ * @param client
+ */
+static void cli_client_done(struct cli_client *client) {
+    struct cli_connection *connection = client->connection;
+
+    if (!connection) {
+        cli_client_release(client);
+        return;
+    }
+
+    pthread_mutex_lock(&streams_mutex);
+    for (struct cli_client **link = &streams; *link; link = &(*link)->stream_next) {
+        if (*link == client) {
+            *link = client->stream_next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&streams_mutex);
+    close(client->fd);
+
+    pthread_mutex_lock(&connection->mutex);
+    connection->inflight--;
+    if (connection->paused && !connection->closed && connection->inflight < CLI_V2_MAX_INFLIGHT) {
+        if (satnow_event_modify(&connection->event, EPOLLIN) == 0) {
+            connection->paused = FALSE;
+        }
+    }
+    pthread_mutex_unlock(&connection->mutex);
+
+    free(client->input);
+    free(client->command);
+    free(client);
+    cli_connection_release(connection);
+}
+
+/**
+ * static void cli_connection_close(struct cli_connection *connection, int hungup)
+ * Stop reading a v2 connection and fail pending input prompts, which can no
+ * longer be answered. Requests in flight finish, cancelled if the client has
+ * hung up, and the last of them closes the connection.
+ * @param connection
+ * @param hungup
+ */
+static void cli_connection_close(struct cli_connection *connection, int hungup) {
+    satnow_event_remove(&connection->event);
+
+    pthread_mutex_lock(&connection->mutex);
+    connection->closed = TRUE;
+    if (hungup) {
+        connection->hungup = TRUE;
+    }
+    pthread_cond_broadcast(&connection->input_cond);
+    pthread_mutex_unlock(&connection->mutex);
+
+    pthread_mutex_lock(&pool.mutex);
+    cli_connection_release(connection);
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+/**
+ * static int cli_connection_refuse(struct cli_connection *connection, uint32_t id, const char *message)
+ * Answer a request that cannot be served with a single CLI_DONE frame. The
+ * event loop must not wait on a client, so the frame is only sent if it
+ * goes out whole right away.
+ * @param connection
+ * @param id
+ * @param message
+ * @return 0, or -1 if the frame could not be sent and the client must be hung up on
+ */
+static int cli_connection_refuse(struct cli_connection *connection, uint32_t id, const char *message) {
+    char frame[CLI_V2_RESPONSE_HEADER_SIZE + BUFFER_SIZE];
+    uint32_t header[3] = { htonl(id), htonl(CLI_DONE), htonl(strlen(message)) };
+    size_t len = CLI_V2_RESPONSE_HEADER_SIZE + strlen(message);
+    ssize_t tx;
+
+    memcpy(frame, header, CLI_V2_RESPONSE_HEADER_SIZE);
+    memcpy(frame + CLI_V2_RESPONSE_HEADER_SIZE, message, strlen(message));
+    /** A worker holding the lock may be blocked writing to a client that stopped reading */
+    if (pthread_mutex_trylock(&connection->write_mutex)) {
+        printf("CLI client is not reading its responses, hanging up\n");
+        return -1;
+    }
+    tx = send(connection->fd, frame, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    pthread_mutex_unlock(&connection->write_mutex);
+    if (tx != (ssize_t)len) {
+        /** Part of a frame would leave the rest of the stream unreadable */
+        if (tx == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("satorinow refuse");
+        } else {
+            printf("CLI client is not reading its responses, hanging up\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * static int cli_connection_request(struct cli_connection *connection, uint32_t id, const char *command, size_t len)
+ * Queue a command that arrived on a v2 connection
+ * @param connection
+ * @param id
+ * @param command
+ * @param len
+ * @return 0, or -1 if the client must be hung up on
+ */
+static int cli_connection_request(struct cli_connection *connection, uint32_t id, const char *command, size_t len) {
+    struct cli_client *client = calloc(1, sizeof(*client));
+
+    if (!client || !(client->command = malloc(len + 1))) {
+        free(client);
+        return cli_connection_refuse(connection, id, "Out of memory\n");
+    }
+    memcpy(client->command, command, len);
+    client->command[len] = '\0';
+    client->id = id;
+    client->connection = connection;
+    client->fd = fcntl(connection->fd, F_DUPFD_CLOEXEC, 0);
+    if (client->fd == -1) {
+        perror("satorinow request dup");
+        free(client->command);
+        free(client);
+        return cli_connection_refuse(connection, id, "Too many requests\n");
+    }
+
+    pthread_mutex_lock(&connection->mutex);
+    connection->refs++;
+    if (++connection->inflight >= CLI_V2_MAX_INFLIGHT && !connection->paused) {
+        if (satnow_event_modify(&connection->event, 0) == 0) {
+            connection->paused = TRUE;
+        }
+    }
+    pthread_mutex_unlock(&connection->mutex);
+
+    pthread_mutex_lock(&streams_mutex);
+    client->stream_next = streams;
+    streams = client;
+    pthread_mutex_unlock(&streams_mutex);
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.pipelined++;
+    cli_queue(client);
+    pthread_mutex_unlock(&pool.mutex);
+
+    return 0;
+}
+
+/**
+ * static void cli_connection_input(struct cli_connection *connection, uint32_t id, const char *input, size_t len)
+ * Hand the answer to an input prompt to the request waiting for it
+ * @param connection
+ * @param id
+ * @param input
+ * @param len
+ */
+static void cli_connection_input(struct cli_connection *connection, uint32_t id, const char *input, size_t len) {
+    pthread_mutex_lock(&streams_mutex);
+    for (struct cli_client *client = streams; client; client = client->stream_next) {
+        if (client->connection == connection && client->id == id) {
+            pthread_mutex_lock(&connection->mutex);
+            free(client->input);
+            client->input = malloc(len ? len : 1);
+            if (client->input) {
+                memcpy(client->input, input, len);
+                client->input_len = len;
+            }
+            pthread_cond_broadcast(&connection->input_cond);
+            pthread_mutex_unlock(&connection->mutex);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&streams_mutex);
+}
+
+/**
+ * static int cli_connection_frames(struct cli_connection *connection)
+ * Act on the complete request frames received so far
+ * @param connection
+ * @return 0, or -1 if the client broke the protocol or must be hung up on
+ */
+static int cli_connection_frames(struct cli_connection *connection) {
+    size_t offset = 0;
+
+    while (connection->rx_len - offset >= CLI_V2_REQUEST_HEADER_SIZE) {
+        uint32_t header[4];
+        uint32_t id, type, len;
+        const char *payload = connection->rx + offset + CLI_V2_REQUEST_HEADER_SIZE;
+
+        memcpy(header, connection->rx + offset, CLI_V2_REQUEST_HEADER_SIZE);
+        id = ntohl(header[1]);
+        type = ntohl(header[2]);
+        len = ntohl(header[3]);
+        if (ntohl(header[0]) != CLI_PROTOCOL_V2 || len > CLI_V2_MAX_REQUEST) {
+            printf("CLI client broke the v2 protocol, hanging up\n");
+            return -1;
+        }
+        if (connection->rx_len - offset - CLI_V2_REQUEST_HEADER_SIZE < len) {
+            break;
+        }
+
+        if (type == CLI_FRAME_COMMAND) {
+            if (cli_connection_request(connection, id, payload, len) == -1) {
+                return -1;
+            }
+        } else if (type == CLI_FRAME_INPUT) {
+            cli_connection_input(connection, id, payload, len);
+        } else {
+            printf("CLI client broke the v2 protocol, hanging up\n");
+            return -1;
+        }
+        offset += CLI_V2_REQUEST_HEADER_SIZE + len;
+    }
+
+    memmove(connection->rx, connection->rx + offset, connection->rx_len - offset);
+    connection->rx_len -= offset;
+    return 0;
+}
+
+/**
+ * static void cli_connection_read(struct satnow_event *event, uint32_t events)
+ * Event loop callback, read request frames from a v2 connection. One read
+ * per call keeps a busy connection from holding up the loop.
+ * @param event
+ * @param events
+ */
+static void cli_connection_read(struct satnow_event *event, uint32_t events) {
+    struct cli_connection *connection = event->context;
+    size_t room = CLI_V2_REQUEST_HEADER_SIZE + CLI_V2_MAX_REQUEST - connection->rx_len;
     ssize_t rx;
 
-    pthread_mutex_lock(&server_fd_mutex);
+    (void)events;
+    if (!connection->rx) {
+        connection->rx = malloc(CLI_V2_REQUEST_HEADER_SIZE + CLI_V2_MAX_REQUEST);
+        if (!connection->rx) {
+            cli_connection_close(connection, TRUE);
+            return;
+        }
+    }
+
+    rx = recv(connection->fd, connection->rx + connection->rx_len, room, MSG_DONTWAIT);
+    if (rx == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (rx == 0) {
+        /** The client sent all its requests, it may still be reading the responses */
+        cli_connection_close(connection, FALSE);
+        return;
+    }
+    if (rx == -1) {
+        cli_connection_close(connection, TRUE);
+        return;
+    }
+
+    connection->rx_len += rx;
+    if (cli_connection_frames(connection) == -1) {
+        shutdown(connection->fd, SHUT_RDWR);
+        cli_connection_close(connection, TRUE);
+    }
+}
 
-    server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (server_fd == -1) {
+/**
+ * static void cli_connection_open(struct cli_client *client)
+ * Turn a client that opened with a v2 request frame into a connection that
+ * stays open for more requests
+ * @param client
+ */
+static void cli_connection_open(struct cli_client *client) {
+    struct cli_connection *connection = calloc(1, sizeof(*connection));
+
+    pthread_mutex_lock(&pool.mutex);
+    cli_client_unlink(&pool.reading, client);
+    if (!connection) {
+        cli_client_release(client);
+        pthread_mutex_unlock(&pool.mutex);
+        return;
+    }
+    connection->fd = client->fd;
+    connection->refs = 1;
+    connection->event.fd = client->fd;
+    connection->event.callback = cli_connection_read;
+    connection->event.context = connection;
+    pthread_mutex_init(&connection->mutex, NULL);
+    pthread_mutex_init(&connection->write_mutex, NULL);
+    pthread_cond_init(&connection->input_cond, NULL);
+    connection->next = pool.connections;
+    pool.connections = connection;
+    free(client);
+
+    if (satnow_event_add(&connection->event, EPOLLIN) == -1) {
+        connection->hungup = TRUE;
+        connection->closed = TRUE;
+        cli_connection_release(connection);
+    }
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+/**
+ * static void cli_read(struct satnow_event *event, uint32_t events)
+ * Event loop callback, read a v1 client's command and queue it for a worker
+ * @param event
+ * @param events
+ */
+static void cli_read(struct satnow_event *event, uint32_t events) {
+    struct cli_client *client = event->context;
+    char first;
+    ssize_t rx;
+
+    (void)events;
+    satnow_event_remove(&client->event);
+
+    /** A v2 client opens with a request frame, whose first byte is 0 */
+    if (recv(client->fd, &first, 1, MSG_PEEK | MSG_DONTWAIT) == 1 && first == 0) {
+        cli_connection_open(client);
+        return;
+    }
+
+    /** The command is ready, this read does not block the loop */
+    client->command = malloc(BUFFER_SIZE);
+    rx = client->command ? read(client->fd, client->command, BUFFER_SIZE - 1) : -1;
+
+    pthread_mutex_lock(&pool.mutex);
+    cli_client_unlink(&pool.reading, client);
+    if (rx <= 0) {
+        if (rx == -1) {
+            perror("satorinow read");
+        }
+        cli_client_release(client);
+        pthread_mutex_unlock(&pool.mutex);
+        return;
+    }
+    client->command[rx] = '\0';
+    cli_queue(client);
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+/**
+ * static void cli_accept(struct satnow_event *event, uint32_t events)
+ * Event loop callback, accept pending clients up to cli_max_clients and
+ * wait for their commands
+ * @param event
+ * @param events
+ */
+static void cli_accept(struct satnow_event *event, uint32_t events) {
+    (void)events;
+
+    for (;;) {
+        struct cli_client *client;
+        int client_fd;
+
+        pthread_mutex_lock(&pool.mutex);
+        if (pool.clients >= satnow_config_get(CONFIG_CLI_MAX_CLIENTS)) {
+            /** Leave clients past the cap in the backlog until a slot frees up */
+            if (!pool.paused && satnow_event_modify(&listen_event, 0) == 0) {
+                pool.paused = TRUE;
+                pool.waits++;
+            }
+            pthread_mutex_unlock(&pool.mutex);
+            return;
+        }
+        pthread_mutex_unlock(&pool.mutex);
+
+        client_fd = accept(event->fd, NULL, NULL);
+        if (client_fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("satorinow accept");
+            }
+            return;
+        }
+
+        client = calloc(1, sizeof(*client));
+        if (!client) {
+            close(client_fd);
+            continue;
+        }
+        client->fd = client_fd;
+        client->event.fd = client_fd;
+        client->event.callback = cli_read;
+        client->event.context = client;
+
+        pthread_mutex_lock(&pool.mutex);
+        client->next = pool.reading;
+        pool.reading = client;
+        pool.clients++;
+        if (pool.clients > pool.peak) {
+            pool.peak = pool.clients;
+        }
+        if (satnow_event_add(&client->event, EPOLLIN) == -1) {
+            cli_client_unlink(&pool.reading, client);
+            cli_client_release(client);
+        }
+        pthread_mutex_unlock(&pool.mutex);
+    }
+}
+
+/**
+ * int satnow_cli_start()
+ * Open the CLI socket and add it to the event loop
+ * @return 0 on success, -1 on failure
+ */
+int satnow_cli_start() {
+    struct sockaddr_un server_addr;
+    int fd;
+
+    /** Operations are registered by now, dispatch reads them without a lock */
+    pthread_mutex_lock(&op_trie_mutex);
+    op_trie_published = TRUE;
+    pthread_mutex_unlock(&op_trie_mutex);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
         perror("satorinow socket");
-        pthread_mutex_unlock(&server_fd_mutex);
-        pthread_exit(NULL);
+        return -1;
     }
 
     memset(&server_addr, 0, sizeof(server_addr));
@@ -164,98 +873,372 @@ void *satnow_cli_start() {
     strncpy(server_addr.sun_path, SOCKET_PATH, sizeof(server_addr.sun_path) - 1);
 
     unlink(SOCKET_PATH);
-    if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+    if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
         perror("satorinow bind");
-        close(server_fd);
-        pthread_mutex_unlock(&server_fd_mutex);
-        pthread_exit(NULL);
+        close(fd);
+        return -1;
     }
 
-    if (listen(server_fd, 5) == -1) {
+    if (listen(fd, SOMAXCONN) == -1) {
         perror("satorinow listen");
-        close(server_fd);
-        pthread_mutex_unlock(&server_fd_mutex);
-        pthread_exit(NULL);
+        close(fd);
+        unlink(SOCKET_PATH);
+        return -1;
+    }
+
+    listen_event.fd = fd;
+    listen_event.callback = cli_accept;
+    if (satnow_event_add(&listen_event, EPOLLIN) == -1) {
+        close(fd);
+        listen_event.fd = -1;
+        unlink(SOCKET_PATH);
+        return -1;
     }
 
-    pthread_mutex_unlock(&server_fd_mutex);
     printf("SatoriNOW listening for commands\n");
+    return 0;
+}
 
-    while (!satnow_ready_to_shutdown()) {
+/**
+ * static void cli_serve(struct cli_client *client)
+ * Run the client's command
+ * @param client
+ */
+static void cli_serve(struct cli_client *client) {
+    printf("RX: [%s]\n", client->command);
+    satnow_cli_execute(client->fd, client->command);
+    satnow_cli_flush(client->fd);
+}
+
+/**
+ * static void *cli_worker(void *arg)
+ * Thread body of a pool worker: serve queued clients until the pool stops
+ * @param arg
+ * @return
+ */
+static void *cli_worker(void *arg) {
+    (void)arg;
 
-        pthread_mutex_lock(&server_fd_mutex);
+    pthread_mutex_lock(&pool.mutex);
+    for (;;) {
+        struct cli_client *client;
 
-        client_fd = accept(server_fd, NULL, NULL);
-        if (client_fd == -1) {
-            perror("satorinow accept");
-            pthread_mutex_unlock(&server_fd_mutex);
-            continue;
+        while (!pool.queue && !pool.stopping) {
+            pool.idle++;
+            pthread_cond_wait(&pool.cond, &pool.mutex);
+            pool.idle--;
+        }
+        if (!pool.queue) {
+            break;
         }
 
-        pthread_mutex_unlock(&server_fd_mutex);
+        client = pool.queue;
+        pool.queue = client->next;
+        if (!pool.queue) {
+            pool.queue_tail = &pool.queue;
+        }
+        client->next = pool.serving;
+        pool.serving = client;
+        pthread_mutex_unlock(&pool.mutex);
 
-        memset(buffer, 0, sizeof(buffer));
-        rx = read(client_fd, buffer, sizeof(buffer) - 1);
+        cli_serve(client);
 
-        if (rx > 0) {
-            buffer[rx] = '\0';
-            printf("RX: [%s]\n", buffer);
-            satnow_cli_execute(client_fd, buffer);
-        } else if (rx == -1) {
-            perror("satorinow read");
-        }
+        pthread_mutex_lock(&pool.mutex);
+        cli_client_unlink(&pool.serving, client);
+        cli_client_done(client);
+        pool.served++;
+        pthread_cond_broadcast(&pool.cond);
+    }
+    pool.workers--;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.mutex);
+
+    return NULL;
+}
 
-        close(client_fd);
+/**
+ * static void cli_worker_start()
+ * Add a worker to the pool. Caller holds pool.mutex.
+ */
+static void cli_worker_start() {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, cli_worker, NULL) == 0) {
+        pool.workers++;
+    } else {
+        perror("satorinow worker pthread_create");
     }
+    pthread_attr_destroy(&attr);
+}
 
-    close(server_fd);
-    unlink(SOCKET_PATH);
-    pthread_exit(NULL);
+/**
+ * void satnow_cli_client_stats(struct satnow_cli_client_stats *stats)
+ * Report the CLI worker pool's activity
+ * @param stats
+ */
+void satnow_cli_client_stats(struct satnow_cli_client_stats *stats) {
+    pthread_mutex_lock(&pool.mutex);
+    stats->max_clients = satnow_config_get(CONFIG_CLI_MAX_CLIENTS);
+    stats->clients = pool.clients;
+    stats->peak = pool.peak;
+    stats->workers = pool.workers;
+    stats->idle = pool.idle;
+    stats->served = pool.served;
+    stats->pipelined = pool.pipelined;
+    stats->waits = pool.waits;
+    stats->cancelled = pool.cancelled;
+    pthread_mutex_unlock(&pool.mutex);
 }
 
+/**
+ * short satnow_cli_hangup_events(int client_fd)
+ * The poll events, besides POLLHUP and POLLERR, that tell the CLI client has
+ * gone away: POLLRDHUP for a v1 client and none for a v2 request, whose
+ * client may shut down its sending side and still read the responses.
+ * @param client_fd
+ * @return
+ */
+short satnow_cli_hangup_events(int client_fd) {
+    return cli_stream_find(client_fd) ? 0 : POLLRDHUP;
+}
 
 /**
- * void satnow_cli_stop()
- * Stop the CLI
+ * int satnow_cli_hungup(int client_fd)
+ * Check, without waiting, whether the CLI client has gone away. A request
+ * of a v2 connection also ends when the event loop sees the connection fail
+ * or a response to it could not be written.
+ * @param client_fd
+ * @return
  */
-void satnow_cli_stop() {
-    struct satnow_cli_op *current = NULL;
+int satnow_cli_hungup(int client_fd) {
+    struct cli_client *client;
+    struct pollfd pfd;
 
-    pthread_mutex_lock(&server_fd_mutex);
-    if (server_fd != -1) {
-        close(server_fd);
-        server_fd = -1;
-        unlink(SOCKET_PATH);
+    if (client_fd <= 0) {
+        return FALSE;
     }
-    pthread_mutex_unlock(&server_fd_mutex);
 
-    pthread_mutex_lock(&op_list_mutex);
+    client = cli_stream_find(client_fd);
+    if (client) {
+        int hungup;
+
+        pthread_mutex_lock(&client->connection->mutex);
+        hungup = client->connection->hungup;
+        pthread_mutex_unlock(&client->connection->mutex);
+        if (hungup) {
+            return TRUE;
+        }
+    }
+
+    pfd.fd = client_fd;
+    pfd.events = client ? 0 : POLLRDHUP;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (pfd.events | POLLHUP | POLLERR | POLLNVAL));
+}
+
+/**
+ * int satnow_cli_cancelled(struct satnow_cli_args *request)
+ * The request's cancellation token. It is triggered once the client hangs
+ * up and stays triggered, so work still queued for the request can be
+ * skipped from any thread.
+ * @param request
+ * @return
+ */
+int satnow_cli_cancelled(struct satnow_cli_args *request) {
+    if (__atomic_load_n(&request->cancelled, __ATOMIC_RELAXED)) {
+        return TRUE;
+    }
+    if (!satnow_cli_hungup(request->fd)) {
+        return FALSE;
+    }
+    if (!__atomic_exchange_n(&request->cancelled, TRUE, __ATOMIC_RELAXED)) {
+        printf("CLI client hung up, cancelling %s %s\n", request->ref->command[0], request->ref->command[1] ? request->ref->command[1] : "");
+        pthread_mutex_lock(&pool.mutex);
+        pool.cancelled++;
+        pthread_mutex_unlock(&pool.mutex);
+    }
+    return TRUE;
+}
 
-    current = op_list_head;
-    while (current) {
-        struct satnow_cli_op *next = current->next;
 
-        if (current->description) {
-            free((char *)current->description);
+/**
+ * static void *cli_detached_run(void *arg)
+ * Thread body of a detached request
+ * @param arg
+ * @return
+ */
+static void *cli_detached_run(void *arg) {
+    struct cli_detached *detached = arg;
+    struct cli_detached **link;
+
+    detached->handler(&detached->args);
+    satnow_cli_flush(detached->args.fd);
+    close(detached->args.fd);
+
+    pthread_mutex_lock(&detached_mutex);
+    for (link = &detached_head; *link; link = &(*link)->next) {
+        if (*link == detached) {
+            *link = detached->next;
+            break;
         }
-        if (current->syntax) {
-            free((char *)current->syntax);
+    }
+    pthread_cond_broadcast(&detached_cond);
+    pthread_mutex_unlock(&detached_mutex);
+
+    for (int i = 0; i < detached->args.argc; i++) {
+        free(detached->argv[i]);
+    }
+    free(detached);
+    return NULL;
+}
+
+/**
+ * int satnow_cli_detach(struct satnow_cli_args *request, void (*handler)(struct satnow_cli_args *request))
+ * Finish the request on a thread of its own so the CLI thread can serve the
+ * next client. The handler receives a copy of the request, must end its
+ * response with CLI_DONE, and the connection is closed when it returns.
+ * @param request
+ * @param handler
+ * @return 0 on success, -1 if the request must be handled inline
+ */
+int satnow_cli_detach(struct satnow_cli_args *request, void (*handler)(struct satnow_cli_args *request)) {
+    struct cli_detached *detached = calloc(1, sizeof(*detached));
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    /** A v2 request answers through the worker's descriptor only */
+    if (!detached || cli_stream_find(request->fd)) {
+        free(detached);
+        return -1;
+    }
+
+    /** Output the request produced so far goes out before the detached thread's */
+    satnow_cli_flush(request->fd);
+
+    detached->handler = handler;
+    detached->args.ref = request->ref;
+    detached->args.format = request->format;
+    detached->args.argv = detached->argv;
+    for (int i = 0; i < request->argc && i < SATNOW_CLI_MAX_COMMAND_WORDS; i++) {
+        detached->argv[i] = strdup(request->argv[i]);
+        detached->args.argc++;
+    }
+
+    /** The CLI thread closes its descriptor as soon as the handler returns */
+    detached->args.fd = dup(request->fd);
+    if (detached->args.fd == -1) {
+        perror("satnow_cli_detach dup");
+        for (int i = 0; i < detached->args.argc; i++) {
+            free(detached->argv[i]);
         }
-        for (int i = 0; i < SATNOW_CLI_MAX_COMMAND_WORDS; i++) {
-            if (current->command[i]) {
-                free((char *)current->command[i]);
-            }
+        free(detached);
+        return -1;
+    }
+
+    pthread_mutex_lock(&detached_mutex);
+    detached->next = detached_head;
+    detached_head = detached;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, cli_detached_run, detached) != 0) {
+        perror("satnow_cli_detach pthread_create");
+        detached_head = detached->next;
+        pthread_mutex_unlock(&detached_mutex);
+        pthread_attr_destroy(&attr);
+        close(detached->args.fd);
+        for (int i = 0; i < detached->args.argc; i++) {
+            free(detached->argv[i]);
         }
-        if (current->user_command) {
-            free((char *)current->user_command);
+        free(detached);
+        return -1;
+    }
+    pthread_mutex_unlock(&detached_mutex);
+    pthread_attr_destroy(&attr);
+
+    return 0;
+}
+
+/**
+ * void satnow_cli_stop()
+ * Stop the CLI
+ */
+void satnow_cli_stop() {
+    /**
+     * The event loop has stopped. Stop accepting, drop clients whose command
+     * was not read or that still wait for a worker, hang up on those being
+     * served and on v2 connections, which cancels their neuron work, and
+     * wait for the workers.
+     */
+    pthread_mutex_lock(&pool.mutex);
+    pool.stopping = TRUE;
+    if (listen_event.fd != -1) {
+        satnow_event_remove(&listen_event);
+        close(listen_event.fd);
+        listen_event.fd = -1;
+        unlink(SOCKET_PATH);
+    }
+    while (pool.reading) {
+        struct cli_client *client = pool.reading;
+
+        pool.reading = client->next;
+        satnow_event_remove(&client->event);
+        cli_client_release(client);
+    }
+    while (pool.queue) {
+        struct cli_client *client = pool.queue;
+
+        pool.queue = client->next;
+        cli_client_done(client);
+    }
+    pool.queue_tail = &pool.queue;
+    for (struct cli_client *client = pool.serving; client; client = client->next) {
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    for (struct cli_connection *connection = pool.connections, *next; connection; connection = next) {
+        int closed;
+
+        next = connection->next;
+        pthread_mutex_lock(&connection->mutex);
+        closed = connection->closed;
+        connection->hungup = TRUE;
+        connection->closed = TRUE;
+        pthread_cond_broadcast(&connection->input_cond);
+        pthread_mutex_unlock(&connection->mutex);
+        shutdown(connection->fd, SHUT_RDWR);
+        if (!closed) {
+            /** The event loop's reference */
+            satnow_event_remove(&connection->event);
+            cli_connection_release(connection);
         }
+    }
+    pthread_cond_broadcast(&pool.cond);
+    while (pool.workers > 0) {
+        pthread_cond_wait(&pool.cond, &pool.mutex);
+    }
+    pthread_mutex_unlock(&pool.mutex);
 
-        free(current);
-        current = next;
+    /**
+     * Hang up on detached requests, which cancels their neuron work, and
+     * wait for them before the operations they reference are released
+     */
+    pthread_mutex_lock(&detached_mutex);
+    for (struct cli_detached *d = detached_head; d; d = d->next) {
+        shutdown(d->args.fd, SHUT_RDWR);
+    }
+    while (detached_head) {
+        pthread_cond_wait(&detached_cond, &detached_mutex);
     }
+    pthread_mutex_unlock(&detached_mutex);
 
-    op_list_head = NULL;
-    pthread_mutex_unlock(&op_list_mutex);
+    pthread_mutex_lock(&op_trie_mutex);
+    cli_trie_free(op_trie.children);
+    memset(&op_trie, 0, sizeof(op_trie));
+    op_trie_published = FALSE;
+    pthread_mutex_unlock(&op_trie_mutex);
 }
 
 
@@ -271,7 +1254,7 @@ void satnow_cli_request_repository_password(int fd) {
 
     satnow_cli_send_response(fd, CLI_INPUT_ECHO_OFF, "Repository Password:");
     memset(buffer, 0, BUFFER_SIZE);
-    rx = read(fd, buffer, BUFFER_SIZE);
+    rx = satnow_cli_read_input(fd, buffer, BUFFER_SIZE - 1);
     if (rx > 0) {
         buffer[rx - 1] = '\0';
         satnow_cli_send_response(fd, CLI_MORE, "\nRemember to store your SatoriNOW repository password in a secure location.\n\n");
@@ -280,54 +1263,162 @@ void satnow_cli_request_repository_password(int fd) {
 }
 
 /**
- * static int compare_commands(char *cmd1[], char *cmd2[])
- * Compare the two supplied command arrays. This is a helper function for
- * alphabetizing the CLI operation linked-list.
- * @param cmd1
- * @param cmd2
+ * static struct cli_trie_node *cli_trie_find(struct cli_trie_node *node, const char *word)
+ * Find the child of the node for the word, ignoring case
+ * @param node
+ * @param word
+ * @return the child, or NULL
+ */
+static struct cli_trie_node *cli_trie_find(struct cli_trie_node *node, const char *word) {
+    for (struct cli_trie_node *child = node->children; child; child = child->sibling) {
+        int cmp = strcasecmp(word, child->word);
+        if (cmp == 0) {
+            return child;
+        }
+        if (cmp < 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * static struct satnow_cli_op *cli_trie_first(struct cli_trie_node *node)
+ * The node's own operation, or else the first operation below it in
+ * alphabetic order
+ * @param node
  * @return
  */
-static int compare_commands(const char *cmd1[], const char *cmd2[]) {
-    for (int i = 0; i < SATNOW_CLI_MAX_COMMAND_WORDS; i++) {
+static struct satnow_cli_op *cli_trie_first(struct cli_trie_node *node) {
+    while (node && !node->op) {
+        node = node->children;
+    }
+    return node ? node->op : NULL;
+}
 
-        if (!cmd1[i] && !cmd2[i]) {
-            return 0;
+/**
+ * static void cli_trie_walk(struct cli_trie_node *node, void (*visit)(struct satnow_cli_op *op, void *context), void *context)
+ * Visit the operations at and below the node in alphabetic order
+ * @param node
+ * @param visit
+ * @param context
+ */
+static void cli_trie_walk(struct cli_trie_node *node, void (*visit)(struct satnow_cli_op *op, void *context), void *context) {
+    if (node->op) {
+        visit(node->op, context);
+    }
+    for (struct cli_trie_node *child = node->children; child; child = child->sibling) {
+        cli_trie_walk(child, visit, context);
+    }
+}
+
+/**
+ * static void cli_op_free(struct satnow_cli_op *op)
+ * Release a registered copy of a CLI operation
+ * @param op
+ */
+static void cli_op_free(struct satnow_cli_op *op) {
+    if (op->description) {
+        free((char *)op->description);
+    }
+    if (op->syntax) {
+        free((char *)op->syntax);
+    }
+    for (int i = 0; i < SATNOW_CLI_MAX_COMMAND_WORDS; i++) {
+        if (op->command[i]) {
+            free((char *)op->command[i]);
         }
-        if (!cmd1[i]) {
-            return -1;
+    }
+    if (op->user_command) {
+        free((char *)op->user_command);
+    }
+    free(op);
+}
+
+/**
+ * static void cli_trie_free(struct cli_trie_node *node)
+ * Release the node, its siblings and everything below them
+ * @param node
+ */
+static void cli_trie_free(struct cli_trie_node *node) {
+    while (node) {
+        struct cli_trie_node *sibling = node->sibling;
+
+        cli_trie_free(node->children);
+        if (node->op) {
+            cli_op_free(node->op);
         }
-        if (!cmd2[i]) {
-            return 1;
+        free(node->word);
+        free(node);
+        node = sibling;
+    }
+}
+
+/**
+ * static struct cli_trie_node *cli_trie_insert(struct cli_trie_node *node, const char *word)
+ * Find or add the child of the node for the word, keeping the children in
+ * alphabetic order. Caller holds op_trie_mutex.
+ * @param node
+ * @param word
+ * @return the child, or NULL when out of memory
+ */
+static struct cli_trie_node *cli_trie_insert(struct cli_trie_node *node, const char *word) {
+    struct cli_trie_node **link = &node->children;
+    struct cli_trie_node *child;
+
+    while (*link) {
+        int cmp = strcasecmp(word, (*link)->word);
+        if (cmp == 0) {
+            return *link;
         }
-        int cmp = strcasecmp(cmd1[i], cmd2[i]);
-        if (cmp != 0) {
-            return cmp;
+        if (cmp < 0) {
+            break;
         }
+        link = &(*link)->sibling;
     }
-    return 0;
+
+    child = calloc(1, sizeof(struct cli_trie_node));
+    if (!child || !(child->word = strdup(word))) {
+        free(child);
+        return NULL;
+    }
+    for (char *c = child->word; *c; c++) {
+        *c = (char)tolower((unsigned char)*c);
+    }
+    child->sibling = *link;
+    *link = child;
+
+    return child;
 }
 
 
 /**
  * int satnow_cli_register(struct satnow_cli_op)
  * Perform a deep copy of the specified CLI operation and add the operation
- * to the CLI operation linked-list in alphabetic order
+ * to the CLI operation trie, one node per command word. Operations are
+ * registered before satnow_cli_start(); a command that is already
+ * registered keeps its first operation.
  *
  * @param op
  * @return
  */
 int satnow_cli_register(struct satnow_cli_op *op) {
     struct satnow_cli_op *new_op = NULL;
+    struct cli_trie_node *node = &op_trie;
 
-    new_op = (struct satnow_cli_op *)calloc(1, sizeof(struct satnow_cli_op));
-    if (!new_op) {
-        perror("calloc struct satnow_cli_op");
+    if (!op->handler) {
+        fprintf(stderr, "CLI operation missing handler\n");
         return -1;
     }
 
-    if (!op->handler) {
-        free(new_op);
-        perror("CLI operation missing handler");
+    if (!op->command[0]) {
+        fprintf(stderr, "CLI operation missing command\n");
+        return -1;
+    }
+
+    new_op = (struct satnow_cli_op *)calloc(1, sizeof(struct satnow_cli_op));
+    if (!new_op) {
+        perror("calloc struct satnow_cli_op");
         return -1;
     }
     new_op->handler = op->handler;
@@ -346,91 +1437,303 @@ int satnow_cli_register(struct satnow_cli_op *op) {
         new_op->syntax = strdup(op->syntax);
     }
 
-    pthread_mutex_lock(&op_list_mutex);
-    if (op_list_head == NULL || compare_commands(new_op->command, op_list_head->command) < 0) {
-        new_op->next = op_list_head;
-        op_list_head = new_op;
-        op_list_size++;
-        pthread_mutex_unlock(&op_list_mutex);
-        return 0;
+    pthread_mutex_lock(&op_trie_mutex);
+    if (op_trie_published) {
+        pthread_mutex_unlock(&op_trie_mutex);
+        fprintf(stderr, "CLI operation %s registered after startup\n", new_op->syntax);
+        cli_op_free(new_op);
+        return -1;
     }
 
-    struct satnow_cli_op *p = op_list_head;
-    while (p->next != NULL && compare_commands(new_op->command, p->next->command) > 0) {
-        p = p->next;
+    for (int i = 0; node && i < SATNOW_CLI_MAX_COMMAND_WORDS && new_op->command[i]; i++) {
+        node = cli_trie_insert(node, new_op->command[i]);
     }
-
-    new_op->next = p->next;
-    p->next = new_op;
-    op_list_size++;
-    pthread_mutex_unlock(&op_list_mutex);
+    if (!node) {
+        pthread_mutex_unlock(&op_trie_mutex);
+        perror("calloc struct cli_trie_node");
+        cli_op_free(new_op);
+        return -1;
+    }
+    if (node->op) {
+        pthread_mutex_unlock(&op_trie_mutex);
+        fprintf(stderr, "CLI operation %s already registered\n", new_op->syntax);
+        cli_op_free(new_op);
+        return -1;
+    }
+    node->op = new_op;
+    pthread_mutex_unlock(&op_trie_mutex);
 
     printf("CLI Operation: %s\n", new_op->syntax);
     return 0;
 }
 
+/**
+ * static void cli_print_operation(struct satnow_cli_op *op, void *context)
+ * Print one CLI operation
+ * @param op
+ * @param context unused
+ */
+static void cli_print_operation(struct satnow_cli_op *op, void *context) {
+    (void)context;
+    printf("Command: %s", op->command[0]);
+    for (int i = 1; i < SATNOW_CLI_MAX_COMMAND_WORDS && op->command[i]; i++) {
+        printf(" %s", op->command[i]);
+    }
+    printf(", Description: %s, Syntax: %s\n", op->description, op->syntax);
+}
+
 /**
  * void satnow_print_cli_operations()
  * Print all the current CLI operations
  */
 void satnow_print_cli_operations() {
-    struct satnow_cli_op *current = NULL;
-
-    pthread_mutex_lock(&op_list_mutex);
-    current = op_list_head;
-    while (current) {
-        printf("Command: %s", current->command[0]);
-        if (current->command[1]) printf(" %s", current->command[1]);
-        if (current->command[2]) printf(" %s", current->command[2]);
-        printf(", Description: %s, Syntax: %s\n", current->description, current->syntax);
-        current = current->next;
-    }
-    pthread_mutex_unlock(&op_list_mutex);
+    pthread_mutex_lock(&op_trie_mutex);
+    cli_trie_walk(&op_trie, cli_print_operation, NULL);
+    pthread_mutex_unlock(&op_trie_mutex);
 }
 
 /**
- * static void send_header(int client_fd, int op_code, int bytes_to_come)
- * Write the header for the send-message out to the CLI client
- * @param client_fd
+ * static size_t frame_header(char *header, int op_code, int bytes_to_come)
+ * Fill in the header that precedes a message to the client being served by
+ * this thread, tagged with the request id on a v2 connection
+ * @param header
  * @param op_code
  * @param bytes_to_come
+ * @return the header's size
  */
-static void send_header(int client_fd, int op_code, int bytes_to_come) {
+static size_t frame_header(char *header, int op_code, int bytes_to_come) {
     /**
      * Convert op_code and bytes_to_come to network byte order
      */
     uint32_t op_code_network = htonl(op_code);
     uint32_t bytes_to_come_network = htonl(bytes_to_come);
 
-    char header[HEADER_SIZE];
+    if (output.stream) {
+        uint32_t id_network = htonl(output.stream->id);
+
+        memcpy(header, &id_network, 4);
+        memcpy(header + 4, &op_code_network, 4);
+        memcpy(header + 8, &bytes_to_come_network, 4);
+        return CLI_V2_RESPONSE_HEADER_SIZE;
+    }
+
     /**
      * Copy the OP_CODE and BYTE-TO-COME to the header
      */
     memcpy(header, &op_code_network, 4);
     memcpy(header + 4, &bytes_to_come_network, 4);
+    return HEADER_SIZE;
+}
 
-    if (write(client_fd, header, HEADER_SIZE) == -1) {
-        perror("Error sending header");
+/**
+ * static int output_writev(int client_fd, struct iovec *iov, int iovcnt)
+ * Write all of the vectors to the CLI client, continuing after short writes
+ * @param client_fd
+ * @param iov
+ * @param iovcnt
+ * @return 0, or -1 if the client could not be written to
+ */
+static int output_writev(int client_fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(client_fd, iov, iovcnt);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /** A client that hung up is noticed by the request itself */
+            if (errno != EPIPE && errno != ECONNRESET) {
+                perror("Error sending response");
+            }
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
     }
+    return 0;
+}
+
+/**
+ * static void output_send(struct iovec *iov, int iovcnt)
+ * Send the buffered output, which iov starts with, and let the next
+ * message look up its client again
+ * @param iov
+ * @param iovcnt
+ */
+static void output_send(struct iovec *iov, int iovcnt) {
+    if (output.stream) {
+        struct cli_connection *connection = output.stream->connection;
+        int failed;
+
+        /** Requests of one connection respond concurrently, keep their frames whole */
+        pthread_mutex_lock(&connection->write_mutex);
+        failed = output_writev(output.fd, iov, iovcnt);
+        pthread_mutex_unlock(&connection->write_mutex);
+        if (failed) {
+            /** Responses no longer reach the client, cancel the other requests too */
+            pthread_mutex_lock(&connection->mutex);
+            connection->hungup = TRUE;
+            pthread_cond_broadcast(&connection->input_cond);
+            pthread_mutex_unlock(&connection->mutex);
+        }
+    } else {
+        output_writev(output.fd, iov, iovcnt);
+    }
+    output.len = 0;
+    output.fd = -1;
+    output.stream = NULL;
+}
+
+/**
+ * void satnow_cli_flush(int client_fd)
+ * Send the messages buffered for the CLI client
+ * @param client_fd
+ */
+void satnow_cli_flush(int client_fd) {
+    struct iovec iov;
+
+    if (output.fd != client_fd || output.len == 0) {
+        return;
+    }
+    iov.iov_base = output.data;
+    iov.iov_len = output.len;
+    output_send(&iov, 1);
 }
 
 /**
  * void satnow_cli_send_response(int client_fd, int op_code, const char *message)
- * Send a response to the CLI client
+ * Send a response to the CLI client. CLI_MORE messages are buffered until
+ * the buffer fills, anything else sends the buffer along with the message.
  * @param client_fd
  * @param op_code
  * @param message
  */
 void satnow_cli_send_response(int client_fd, int op_code, const char *message) {
-    int bytes_to_come = message ? strlen(message) : 0;
+    size_t bytes_to_come = message ? strlen(message) : 0;
+    char header[CLI_V2_RESPONSE_HEADER_SIZE];
+    size_t header_len;
+
+    if (output.fd != client_fd) {
+        satnow_cli_flush(output.fd);
+        output.fd = client_fd;
+        output.stream = cli_stream_find(client_fd);
+    }
+
+    header_len = frame_header(header, op_code, (int)bytes_to_come);
 
-    send_header(client_fd, op_code, bytes_to_come);
+    if (output.len + header_len + bytes_to_come > sizeof(output.data)) {
+        /** Too big to buffer: send what is pending and this message in one call */
+        struct iovec iov[3] = {
+            { output.data, output.len },
+            { header, header_len },
+            { (char *)message, bytes_to_come },
+        };
+
+        output_send(iov, 3);
+        return;
+    }
+
+    memcpy(output.data + output.len, header, header_len);
+    output.len += header_len;
     if (bytes_to_come > 0) {
-        printf("%04d%04d::%s", op_code, bytes_to_come, message);
-        if (write(client_fd, message, bytes_to_come) == -1) {
-            perror("Error sending response");
-        }
+        memcpy(output.data + output.len, message, bytes_to_come);
+        output.len += bytes_to_come;
     }
+
+    /** The client waits for input prompts and the end of the response */
+    if (op_code != CLI_MORE) {
+        satnow_cli_flush(client_fd);
+    }
+}
+
+/**
+ * void satnow_cli_send_data(int client_fd, int op_code, const char *data, size_t len)
+ * Send a message to the CLI client right away, behind anything buffered for
+ * it. The data goes out from the caller's memory without being copied.
+ * @param client_fd
+ * @param op_code
+ * @param data
+ * @param len
+ */
+void satnow_cli_send_data(int client_fd, int op_code, const char *data, size_t len) {
+    char header[CLI_V2_RESPONSE_HEADER_SIZE];
+    struct iovec iov[3];
+
+    if (output.fd != client_fd) {
+        satnow_cli_flush(output.fd);
+        output.fd = client_fd;
+        output.stream = cli_stream_find(client_fd);
+    }
+
+    iov[0].iov_base = output.data;
+    iov[0].iov_len = output.len;
+    iov[1].iov_base = header;
+    iov[1].iov_len = frame_header(header, op_code, (int)len);
+    iov[2].iov_base = (char *)data;
+    iov[2].iov_len = len;
+    output_send(iov, 3);
+}
+
+/**
+ * ssize_t satnow_cli_read_input(int fd, char *buffer, size_t size)
+ * Read the client's answer to an input prompt. On a v2 connection the
+ * answer arrives as an input frame for the request.
+ * @param fd
+ * @param buffer
+ * @param size
+ * @return bytes read, 0 if the client hung up, -1 on error
+ */
+ssize_t satnow_cli_read_input(int fd, char *buffer, size_t size) {
+    struct cli_client *client = cli_stream_find(fd);
+    struct cli_connection *connection;
+    size_t len;
+
+    if (!client) {
+        return read(fd, buffer, size);
+    }
+
+    connection = client->connection;
+    pthread_mutex_lock(&connection->mutex);
+    while (!client->input && !connection->closed && !connection->hungup) {
+        pthread_cond_wait(&connection->input_cond, &connection->mutex);
+    }
+    if (!client->input) {
+        pthread_mutex_unlock(&connection->mutex);
+        return 0;
+    }
+    len = client->input_len < size ? client->input_len : size;
+    memcpy(buffer, client->input, len);
+    free(client->input);
+    client->input = NULL;
+    pthread_mutex_unlock(&connection->mutex);
+
+    return (ssize_t)len;
+}
+
+/**
+ * static int cli_format_parse(const char *name)
+ * Look up an output format by name
+ * @param name
+ * @return the enum CliFormat, or -1 if unknown
+ */
+static int cli_format_parse(const char *name) {
+    if (!strcasecmp(name, "text")) {
+        return CLI_FORMAT_TEXT;
+    }
+    if (!strcasecmp(name, "json")) {
+        return CLI_FORMAT_JSON;
+    }
+    if (!strcasecmp(name, "ndjson")) {
+        return CLI_FORMAT_NDJSON;
+    }
+    return -1;
 }
 
 /**
@@ -441,50 +1744,58 @@ void satnow_cli_send_response(int client_fd, int op_code, const char *message) {
  * @param buffer
  */
 void satnow_cli_execute(int client_fd, const char *buffer) {
-    struct satnow_cli_op *current = NULL;
+    struct cli_trie_node *node = &op_trie;
     struct satnow_cli_op *best_match = NULL;
-    struct satnow_cli_args *args = NULL;
+    struct satnow_cli_args args;
 
     char *buffer_copy = strdup(buffer);
     char *token = NULL;
+    char *save = NULL;
     char *words[SATNOW_CLI_MAX_COMMAND_WORDS];
 
     int word_count = 0;
-    int best_match_score = 0;
+    int format = CLI_FORMAT_TEXT;
+
+    if (!buffer_copy) {
+        perror("strdup CLI command");
+        return;
+    }
 
     /**
-     * Split buffer into words
+     * Split buffer into words. A leading --format <name> or --format=<name>
+     * picks the output format and is not passed to the handler.
      */
-    token = strtok(buffer_copy, " \t\n");
+    token = strtok_r(buffer_copy, " \t\n", &save);
+    while (token && !strncasecmp(token, "--format", 8) && (token[8] == '\0' || token[8] == '=')) {
+        const char *name = token[8] == '=' ? token + 9 : strtok_r(NULL, " \t\n", &save);
+
+        format = name ? cli_format_parse(name) : -1;
+        if (format == -1) {
+            printf("Unknown output format\n");
+            satnow_cli_send_response(client_fd, CLI_DONE, "Unknown output format, use --format (text | json | ndjson)\n");
+            free(buffer_copy);
+            return;
+        }
+        token = strtok_r(NULL, " \t\n", &save);
+    }
     while (token && word_count < SATNOW_CLI_MAX_COMMAND_WORDS) {
         words[word_count++] = token;
-        token = strtok(NULL, " \t\n");
+        token = strtok_r(NULL, " \t\n", &save);
     }
 
     /**
-     * Find the best match
+     * Follow the words down the trie as far as they match. A command that
+     * stops short of an operation runs the first operation below it.
      */
-    pthread_mutex_lock(&op_list_mutex);
-    current = op_list_head;
-    best_match = NULL;
-
-    while (current) {
-        int match_score = 0;
-
-        for (int i = 0; current->command[i] && i < word_count; ++i) {
-            if (!strcasecmp(words[i], current->command[i])) {
-                ++match_score;
-            } else {
-                break;
-            }
-        }
-
-        if (match_score > best_match_score) {
-            best_match = current;
-            best_match_score = match_score;
+    for (int i = 0; i < word_count; i++) {
+        struct cli_trie_node *child = cli_trie_find(node, words[i]);
+        if (!child) {
+            break;
         }
-
-        current = current->next;
+        node = child;
+    }
+    if (node != &op_trie) {
+        best_match = cli_trie_first(node);
     }
 
     if (best_match) {
@@ -494,22 +1805,16 @@ void satnow_cli_execute(int client_fd, const char *buffer) {
         }
         printf("\n");
 
-        args = calloc(1, sizeof(struct satnow_cli_args));
-        args->fd = client_fd;
-        args->argc = word_count;
-        args->argv = words;
-        args->ref = best_match;
+        memset(&args, 0, sizeof(args));
+        args.fd = client_fd;
+        args.argc = word_count;
+        args.argv = words;
+        args.ref = best_match;
+        args.format = format;
+        best_match->handler(&args);
     } else {
         printf("Match not found\n");
     }
-    pthread_mutex_unlock(&op_list_mutex);
-
-    if (best_match) {
-        best_match->handler(args);
-        if (args) {
-            free(args);
-        }
-    }
 
     if (buffer_copy) {
         free(buffer_copy);
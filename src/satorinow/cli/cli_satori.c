@@ -22,15 +22,21 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
 #include <satorinow.h>
 #include "satorinow/cli.h"
 #include "satorinow/cli/cli_satori.h"
+#include "satorinow/config.h"
+#include "satorinow/fanout.h"
 #include "satorinow/http/http_neuron.h"
+#include "satorinow/http/http_neuron_host.h"
 #include "satorinow/repository.h"
 #include "satorinow/json.h"
 
@@ -38,17 +44,40 @@
 #pragma message ("SATORINOW DEBUG: CLI SATORI")
 #endif
 
+#define VAULT_BATCH_MAX_JOBS 256
+#define VAULT_BATCH_CONCURRENCY 4
+#define VAULT_BATCH_MAX_CONCURRENCY 32
+
+#define PING_MAX_COUNT 10000
+#define PING_MAX_INTERVAL_MS 60000
+#define PING_DEFAULT_INTERVAL_MS 1000
+
+#define STATS_CONCURRENCY 16
+
 static char *cli_neuron_addresses(struct satnow_cli_args *request);
 static char *cli_neuron_delegate(struct satnow_cli_args *request);
+static char *cli_neuron_endpoints(struct satnow_cli_args *request);
+static char *cli_neuron_latency(struct satnow_cli_args *request);
+static char *cli_neuron_latency_reset(struct satnow_cli_args *request);
 static char *cli_neuron_parent_status(struct satnow_cli_args *request);
 static char *cli_neuron_ping(struct satnow_cli_args *request);
+static char *cli_neuron_pins(struct satnow_cli_args *request);
+static char *cli_neuron_pin_forget(struct satnow_cli_args *request);
+static char *cli_neuron_prefetch(struct satnow_cli_args *request);
+static char *cli_neuron_prefetch_cancel(struct satnow_cli_args *request);
 static char *cli_neuron_pool_participants(struct satnow_cli_args *request);
 static char *cli_neuron_register(struct satnow_cli_args *request);
 static char *cli_neuron_system_metrics(struct satnow_cli_args *request);
 static char *cli_neuron_stats(struct satnow_cli_args *request);
+static char *cli_neuron_status(struct satnow_cli_args *request);
 static char *cli_neuron_unlock(struct satnow_cli_args *request);
 static char *cli_neuron_vault(struct satnow_cli_args *request);
+static char *cli_neuron_vault_batch(struct satnow_cli_args *request);
 static char *cli_neuron_vault_transfer(struct satnow_cli_args *request);
+static void neuron_ping_samples(struct satnow_cli_args *request, const char *target, int count, long interval_ms);
+static void neuron_session_free(struct neuron_session *session);
+static struct neuron_session *repository_entry_session(struct repository_entry *entry);
+static int repository_entry_count(struct repository_entry *list);
 
 static struct satnow_cli_op satori_cli_operations[] = {
     {
@@ -82,13 +111,73 @@ static struct satnow_cli_op satori_cli_operations[] = {
         , 0
     },
     {
-        { "neuron", "parent", "status", NULL }
-        , "Display the specified neuron's parent status report"
-        , "Usage: neuron parent status (<ip>:<port> | <nickname>) [json]"
+        { "neuron", "endpoints", NULL }
+        , "Display per-endpoint latency and response volume for each neuron contacted since startup"
+        , "Usage: neuron endpoints"
         , 0
         , 0
         , 0
-        , cli_neuron_parent_status
+        , cli_neuron_endpoints
+        , 0
+    },
+    {
+        { "neuron", "latency", NULL }
+        , "Display per-endpoint latency percentiles, split into lookup, connect, TLS and first byte, for each neuron contacted since startup"
+        , "Usage: neuron latency [<ip>:<port>]"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_latency
+        , 0
+    },
+    {
+        { "neuron", "latency", "reset", NULL }
+        , "Forget the latency histograms of every neuron, or of the specified neuron"
+        , "Usage: neuron latency reset [<ip>:<port>]"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_latency_reset
+        , 0
+    },
+    {
+        { "neuron", "prefetch", NULL }
+        , "Display the background prefetch queue and response cache settings"
+        , "Usage: neuron prefetch"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_prefetch
+        , 0
+    },
+    {
+        { "neuron", "prefetch", "cancel", NULL }
+        , "Drop queued background prefetches and cancel those in flight"
+        , "Usage: neuron prefetch cancel"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_prefetch_cancel
+        , 0
+    },
+    {
+        { "neuron", "pins", NULL }
+        , "Display the public keys https neurons are pinned to"
+        , "Usage: neuron pins"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_pins
+        , 0
+    },
+    {
+        { "neuron", "pin", "forget", NULL }
+        , "Forget an https neuron's pinned public key, pinning the key it presents next"
+        , "Usage: neuron pin forget https://<ip>:<port>"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_pin_forget
         , 0
     },
     {
@@ -104,7 +193,7 @@ static struct satnow_cli_op satori_cli_operations[] = {
     {
         { "neuron", "register", NULL }
         , "Register a protected neuron."
-        , "Usage: neuron register <ip>:<port> [<nickname>]"
+        , "Usage: neuron register [https://]<ip>:<port> [<nickname>]"
         , 0
         , 0
         , 0
@@ -113,13 +202,23 @@ static struct satnow_cli_op satori_cli_operations[] = {
     },{
         { "neuron", "stats", NULL }
         , "Display neuron stats"
-        , "Usage: neuron stats [(<ip>:<port> | <nickname>)]"
+        , "Usage: neuron stats [--ordered] [(<ip>:<port> | <nickname>)]"
         , 0
         , 0
         , 0
         , cli_neuron_stats
         , 0
     },
+    {
+        { "neuron", "status", NULL }
+        , "Display the circuit breaker state of each neuron contacted since startup"
+        , "Usage: neuron status"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_status
+        , 0
+    },
     {
         { "neuron", "system", "metrics", NULL }
         , "Display neuron system metrics"
@@ -150,6 +249,16 @@ static struct satnow_cli_op satori_cli_operations[] = {
         , cli_neuron_vault
         , 0
     },
+    {
+        { "neuron", "vault", "batch", NULL }
+        , "Transfer from many neuron vaults concurrently, as listed in a batch file"
+        , "Usage: neuron vault batch <file> [concurrency <n>]\n  Each line of <file>: ( <host:ip> | <nickname> ) ( <amount> | sweep ) <wallet-address>"
+        , 0
+        , 0
+        , 0
+        , cli_neuron_vault_batch
+        , 0
+    },
     {
         { "neuron", "vault", "transfer", NULL }
         , "Transfer the specified amount of satori from the vault to the specified wallet address"
@@ -162,8 +271,8 @@ static struct satnow_cli_op satori_cli_operations[] = {
     },
     {
         { "neuron", "ping", NULL }
-        , "Ping the specified neuron"
-        , "Usage: neuron ping ( <host:ip> | <nickname> )"
+        , "Ping the specified neuron, or every registered neuron, once or for a series of samples"
+        , "Usage: neuron ping ( <host:ip> | <nickname> ) [json]\n       neuron ping ( <host:ip> | <nickname> | all ) [count <n>] [interval <ms>]"
         , 0
         , 0
         , 0
@@ -185,16 +294,726 @@ int satnow_register_satori_cli_operations() {
             }
             printf(" %s", satori_cli_operations[i].command[j]);
         }
-        printf("\n");
-        satnow_cli_register(&satori_cli_operations[i]);
+        printf("\n");
+        satnow_cli_register(&satori_cli_operations[i]);
+    }
+    return 0;
+}
+
+static double time_diff_ms(struct timespec start, struct timespec end) {
+    double start_ms = start.tv_sec * 1000.0 + start.tv_nsec / 1.0e6;
+    double end_ms = end.tv_sec * 1000.0 + end.tv_nsec / 1.0e6;
+    return end_ms - start_ms;
+}
+
+/**
+ * Output rendered from a neuron response, collected so an unchanged
+ * response can be answered later without parsing it again
+ */
+struct cli_render {
+    char *text;
+    size_t len;
+    size_t size;
+    int failed;
+};
+
+/**
+ * static int render_reserve(struct cli_render *render, size_t n)
+ * Make room for n more bytes and the terminating NUL
+ * @param render
+ * @param n
+ * @return 0, or -1 if the rendered output failed
+ */
+static int render_reserve(struct cli_render *render, size_t n) {
+    if (render->failed) {
+        return -1;
+    }
+
+    if (render->len + n + 1 > render->size) {
+        size_t size = render->size ? render->size : 4096;
+        char *text;
+
+        while (size < render->len + n + 1) {
+            size *= 2;
+        }
+        text = realloc(render->text, size);
+        if (!text) {
+            render->failed = TRUE;
+            return -1;
+        }
+        render->text = text;
+        render->size = size;
+    }
+    return 0;
+}
+
+/**
+ * static void render_append(struct cli_render *render, const char *data, size_t n)
+ * Append n bytes to the rendered output
+ * @param render
+ * @param data
+ * @param n
+ */
+static void render_append(struct cli_render *render, const char *data, size_t n) {
+    if (render_reserve(render, n)) {
+        return;
+    }
+    memcpy(render->text + render->len, data, n);
+    render->len += n;
+    render->text[render->len] = '\0';
+}
+
+/**
+ * static void render_vprintf(struct cli_render *render, const char *format, va_list ap)
+ * Append formatted text to the rendered output
+ * @param render
+ * @param format
+ * @param ap
+ */
+static void render_vprintf(struct cli_render *render, const char *format, va_list ap) {
+    va_list copy;
+    int n;
+
+    if (render->failed) {
+        return;
+    }
+
+    va_copy(copy, ap);
+    n = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (n < 0) {
+        render->failed = TRUE;
+        return;
+    }
+    if (render_reserve(render, n)) {
+        return;
+    }
+
+    vsnprintf(render->text + render->len, n + 1, format, ap);
+    render->len += n;
+}
+
+/**
+ * static void render_printf(struct cli_render *render, const char *format, ...)
+ * Append formatted text to the rendered output
+ * @param render
+ * @param format
+ */
+static void render_printf(struct cli_render *render, const char *format, ...) {
+    va_list ap;
+
+    va_start(ap, format);
+    render_vprintf(render, format, ap);
+    va_end(ap);
+}
+
+/**
+ * static void render_json_string(struct cli_render *render, const char *value)
+ * Append the value as a quoted JSON string, or null
+ * @param render
+ * @param value
+ */
+static void render_json_string(struct cli_render *render, const char *value) {
+    const unsigned char *c = (const unsigned char *)value;
+
+    if (!value) {
+        render_append(render, "null", 4);
+        return;
+    }
+
+    render_append(render, "\"", 1);
+    while (*c) {
+        const unsigned char *run = c;
+
+        /** Most strings need no escaping, copy them a run at a time */
+        while (*c && *c != '"' && *c != '\\' && *c >= 0x20) {
+            c++;
+        }
+        render_append(render, (const char *)run, c - run);
+        if (!*c) {
+            break;
+        }
+        if (*c == '"' || *c == '\\') {
+            char escaped[2] = { '\\', (char)*c };
+
+            render_append(render, escaped, 2);
+        } else if (*c == '\n') {
+            render_append(render, "\\n", 2);
+        } else if (*c == '\t') {
+            render_append(render, "\\t", 2);
+        } else {
+            render_printf(render, "\\u%04x", *c);
+        }
+        c++;
+    }
+    render_append(render, "\"", 1);
+}
+
+/**
+ * Table rows on their way to the client in the request's output format:
+ * text columns, one JSON array for the whole command or one JSON object
+ * per line. A field is given once, with the printf format that places it
+ * in a text row and the name that labels it in a JSON object. A NULL
+ * format leaves the field out of the text row.
+ */
+struct cli_rows {
+    int fd;
+    int format;
+    struct cli_render *render;      /** collects a copy of the output for reuse, or NULL */
+    struct cli_render row;          /** the row being built */
+    int fields;                     /** in the row being built */
+    int count;                      /** rows sent */
+};
+
+/**
+ * static void rows_begin(struct cli_rows *rows, struct satnow_cli_args *request, struct cli_render *render)
+ * Start the rows of a command
+ * @param rows
+ * @param request
+ * @param render collects a copy of the output for reuse, or NULL
+ */
+static void rows_begin(struct cli_rows *rows, struct satnow_cli_args *request, struct cli_render *render) {
+    memset(rows, 0, sizeof(*rows));
+    rows->fd = request->fd;
+    rows->format = request->format;
+    rows->render = render;
+}
+
+/**
+ * static int rows_text(struct cli_rows *rows)
+ * @param rows
+ * @return TRUE when the rows are shown as text
+ */
+static int rows_text(struct cli_rows *rows) {
+    return rows->format == CLI_FORMAT_TEXT;
+}
+
+/**
+ * static void rows_put(struct cli_rows *rows, const char *text)
+ * Send finished output, which goes out whenever the client's output buffer
+ * fills, keeping a copy when one is collected
+ * @param rows
+ * @param text
+ */
+static void rows_put(struct cli_rows *rows, const char *text) {
+    satnow_cli_send_response(rows->fd, CLI_MORE, text);
+    if (rows->render) {
+        render_printf(rows->render, "%s", text);
+    }
+}
+
+/**
+ * static void rows_printf(struct cli_rows *rows, const char *format, ...)
+ * Send text outside of any row, such as a heading or a summary, which only
+ * text output shows
+ * @param rows
+ * @param format
+ */
+static void rows_printf(struct cli_rows *rows, const char *format, ...) {
+    struct cli_render text = { 0 };
+    va_list ap;
+
+    if (!rows_text(rows)) {
+        return;
+    }
+
+    va_start(ap, format);
+    render_vprintf(&text, format, ap);
+    va_end(ap);
+    if (!text.failed && text.text) {
+        rows_put(rows, text.text);
+    }
+    free(text.text);
+}
+
+/**
+ * static void row_begin(struct cli_rows *rows, const char *type)
+ * Start a row
+ * @param rows
+ * @param type labels the row in JSON when a command sends more than one kind, or NULL
+ */
+static void row_begin(struct cli_rows *rows, const char *type) {
+    rows->row.len = 0;
+    rows->row.failed = FALSE;
+    rows->fields = 0;
+
+    if (rows->format == CLI_FORMAT_JSON) {
+        render_printf(&rows->row, rows->count ? ",\n{" : "[\n{");
+    } else if (rows->format == CLI_FORMAT_NDJSON) {
+        render_printf(&rows->row, "{");
+    }
+    if (type && !rows_text(rows)) {
+        render_printf(&rows->row, "\"type\":");
+        render_json_string(&rows->row, type);
+        rows->fields++;
+    }
+}
+
+/**
+ * static void row_name(struct cli_rows *rows, const char *name)
+ * Start a JSON field
+ * @param rows
+ * @param name
+ */
+static void row_name(struct cli_rows *rows, const char *name) {
+    if (rows->fields++) {
+        render_printf(&rows->row, ",");
+    }
+    render_json_string(&rows->row, name);
+    render_printf(&rows->row, ":");
+}
+
+/**
+ * static void row_text(struct cli_rows *rows, const char *format, ...)
+ * Add text to the row that only text output shows
+ * @param rows
+ * @param format
+ */
+static void row_text(struct cli_rows *rows, const char *format, ...) {
+    va_list ap;
+
+    if (!rows_text(rows)) {
+        return;
+    }
+
+    va_start(ap, format);
+    render_vprintf(&rows->row, format, ap);
+    va_end(ap);
+}
+
+/**
+ * static void row_string(struct cli_rows *rows, const char *name, const char *format, const char *value)
+ * Add a string field, shown as N/A in text and null in JSON when missing
+ * @param rows
+ * @param name
+ * @param format
+ * @param value
+ */
+static void row_string(struct cli_rows *rows, const char *name, const char *format, const char *value) {
+    if (rows_text(rows)) {
+        if (format) {
+            render_printf(&rows->row, format, value ? value : "N/A");
+        }
+        return;
+    }
+    row_name(rows, name);
+    render_json_string(&rows->row, value);
+}
+
+/**
+ * static void row_long(struct cli_rows *rows, const char *name, const char *format, long value)
+ * Add an integer field
+ * @param rows
+ * @param name
+ * @param format
+ * @param value
+ */
+static void row_long(struct cli_rows *rows, const char *name, const char *format, long value) {
+    if (rows_text(rows)) {
+        if (format) {
+            render_printf(&rows->row, format, value);
+        }
+        return;
+    }
+    row_name(rows, name);
+    render_printf(&rows->row, "%ld", value);
+}
+
+/**
+ * static void row_double(struct cli_rows *rows, const char *name, const char *format, double value)
+ * Add a number field, null in JSON when it is not finite
+ * @param rows
+ * @param name
+ * @param format
+ * @param value
+ */
+static void row_double(struct cli_rows *rows, const char *name, const char *format, double value) {
+    if (rows_text(rows)) {
+        if (format) {
+            render_printf(&rows->row, format, value);
+        }
+        return;
+    }
+    row_name(rows, name);
+    if (isfinite(value)) {
+        render_printf(&rows->row, "%.17g", value);
+    } else {
+        render_printf(&rows->row, "null");
+    }
+}
+
+/**
+ * static void row_bool(struct cli_rows *rows, const char *name, const char *format, int value)
+ * Add a yes or no field, shown as YES, NO or N/A in text
+ * @param rows
+ * @param name
+ * @param format
+ * @param value TRUE, FALSE or -1 when unknown
+ */
+static void row_bool(struct cli_rows *rows, const char *name, const char *format, int value) {
+    if (rows_text(rows)) {
+        if (format) {
+            render_printf(&rows->row, format, value < 0 ? "N/A" : value ? "YES" : "NO");
+        }
+        return;
+    }
+    row_name(rows, name);
+    render_printf(&rows->row, value < 0 ? "null" : value ? "true" : "false");
+}
+
+/**
+ * static void row_json(struct cli_rows *rows, const char *name, const cJSON *value)
+ * Add a JSON value as is, left out of text rows
+ * @param rows
+ * @param name
+ * @param value
+ */
+static void row_json(struct cli_rows *rows, const char *name, const cJSON *value) {
+    char *printed;
+
+    if (rows_text(rows)) {
+        return;
+    }
+    printed = cJSON_PrintUnformatted(value);
+    row_name(rows, name);
+    render_printf(&rows->row, "%s", printed ? printed : "null");
+    if (printed) {
+        cJSON_free(printed);
+    }
+}
+
+/**
+ * static void row_body(struct cli_rows *rows, const char *name, const char *format, const char *body)
+ * Add a neuron's response body, as a JSON value when it parses as one and
+ * as a string otherwise
+ * @param rows
+ * @param name
+ * @param format
+ * @param body
+ */
+static void row_body(struct cli_rows *rows, const char *name, const char *format, const char *body) {
+    cJSON *parsed;
+
+    if (rows_text(rows) || !body || !(parsed = cJSON_Parse(body))) {
+        row_string(rows, name, format, body);
+        return;
+    }
+    row_json(rows, name, parsed);
+    cJSON_Delete(parsed);
+}
+
+/**
+ * static void row_end(struct cli_rows *rows)
+ * Finish the row and send it
+ * @param rows
+ */
+static void row_end(struct cli_rows *rows) {
+    if (rows->format == CLI_FORMAT_TEXT) {
+        render_printf(&rows->row, "\n");
+    } else if (rows->format == CLI_FORMAT_JSON) {
+        render_printf(&rows->row, "}");
+    } else {
+        render_printf(&rows->row, "}\n");
+    }
+
+    if (rows->row.failed) {
+        fprintf(stderr, "Out of memory rendering a row\n");
+        return;
+    }
+    rows_put(rows, rows->row.text);
+    rows->count++;
+}
+
+/**
+ * static void rows_end(struct cli_rows *rows)
+ * Finish the rows of a command and release them
+ * @param rows
+ */
+static void rows_end(struct cli_rows *rows) {
+    if (rows->format == CLI_FORMAT_JSON) {
+        rows_put(rows, rows->count ? "\n]\n" : "[]\n");
+    }
+    free(rows->row.text);
+    rows->row.text = NULL;
+}
+
+/**
+ * static void send_note(struct satnow_cli_args *request, const char *text)
+ * Send progress text meant for a person, which only text output shows
+ * @param request
+ * @param text
+ */
+static void send_note(struct satnow_cli_args *request, const char *text) {
+    if (request->format == CLI_FORMAT_TEXT) {
+        satnow_cli_send_response(request->fd, CLI_MORE, text);
+    }
+}
+
+/**
+ * static void rows_error(struct cli_rows *rows, const char *text)
+ * Report a problem as a row of type error, so json and ndjson output stay
+ * valid. Text output shows the message as is.
+ * @param rows
+ * @param text ending in a newline
+ */
+static void rows_error(struct cli_rows *rows, const char *text) {
+    char message[BUFFER_SIZE];
+    size_t len = strlen(text);
+
+    if (len && text[len - 1] == '\n') {
+        len--;
+    }
+    snprintf(message, sizeof(message), "%.*s", (int)len, text);
+    row_begin(rows, "error");
+    row_string(rows, "message", "%s", message);
+    row_end(rows);
+}
+
+/**
+ * static void send_error(struct satnow_cli_args *request, const char *text)
+ * Report a problem of a command that sends no other rows
+ * @param request
+ * @param text ending in a newline
+ */
+static void send_error(struct satnow_cli_args *request, const char *text) {
+    struct cli_rows rows;
+
+    rows_begin(&rows, request, NULL);
+    rows_error(&rows, text);
+    rows_end(&rows);
+}
+
+/**
+ * static void send_body(struct satnow_cli_args *request, struct neuron_session *session)
+ * Send the neuron's raw response asked for with the trailing json argument
+ * when it was not already passed through. json and ndjson output only take
+ * a body that is JSON.
+ * @param request
+ * @param session
+ */
+static void send_body(struct satnow_cli_args *request, struct neuron_session *session) {
+    cJSON *parsed;
+
+    if (request->format != CLI_FORMAT_TEXT) {
+        if (!session->buffer || !(parsed = cJSON_Parse(session->buffer))) {
+            send_error(request, "The neuron's response is not JSON\n");
+            return;
+        }
+        cJSON_Delete(parsed);
+    }
+    if (session->buffer) {
+        satnow_cli_send_response(request->fd, CLI_MORE, session->buffer);
+    }
+}
+
+/**
+ * static void send_done(struct satnow_cli_args *request)
+ * End the response, with a blank line only under text output
+ * @param request
+ */
+static void send_done(struct satnow_cli_args *request) {
+    satnow_cli_send_response(request->fd, CLI_DONE, request->format == CLI_FORMAT_TEXT ? "\n" : "");
+}
+
+/**
+ * static const char *json_string(const cJSON *item)
+ * @param item
+ * @return the item's string, or NULL if it is not a string
+ */
+static const char *json_string(const cJSON *item) {
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+/**
+ * static void row_address(struct cli_rows *rows, const char *name, const char *address)
+ * Add a wallet address field, shortened to its ends in text
+ * @param rows
+ * @param name
+ * @param address
+ */
+static void row_address(struct cli_rows *rows, const char *name, const char *address) {
+    size_t len = address ? strlen(address) : 0;
+
+    row_string(rows, name, NULL, address);
+    if (len >= 4) {
+        row_text(rows, "%.4s...%.4s\t", address, address + len - 4);
+    } else {
+        row_text(rows, "%10s\t", "N/A");
+    }
+}
+
+/**
+ * static int render_delegated_neurons(const char *body, const char *name, struct cli_rows *rows)
+ * Render the neurons listed by a parent status or pool participants response
+ * @param body
+ * @param name the neuron as the client named it
+ * @param rows
+ * @return 0 on success, -1 if the response is not a JSON array
+ */
+static int render_delegated_neurons(const char *body, const char *name, struct cli_rows *rows) {
+    int neuron_count = 0;
+    cJSON *element = NULL;
+    cJSON *json = cJSON_Parse(body);
+
+    if (json == NULL) {
+        fprintf(stderr, "Error parsing JSON\n");
+        return -1;
+    }
+
+    if (!cJSON_IsArray(json)) {
+        fprintf(stderr, "Error: response is not a valid JSON array\n");
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    rows_printf(rows
+                , "%6s\t%6s\t%7s\t%4s\t%10s\t%10s\t%8s\t%7s\t\t%s\n"
+                , "PARENT"
+                , "CHILD"
+                , "CHARITY"
+                , "AUTO"
+                , "WALLET"
+                , "VAULT"
+                , "REWARD"
+                , "POINTED"
+                , "DATE"
+            );
+
+    cJSON_ArrayForEach(element, json) {
+        if (cJSON_IsObject(element)) {
+            cJSON *parent = cJSON_GetObjectItem(element, "parent");
+            cJSON *child = cJSON_GetObjectItem(element, "child");
+            cJSON *charity = cJSON_GetObjectItem(element, "charity");
+            cJSON *automatic = cJSON_GetObjectItem(element, "automatic");
+            cJSON *reward = cJSON_GetObjectItem(element, "reward");
+            cJSON *pointed = cJSON_GetObjectItem(element, "pointed");
+
+            row_begin(rows, NULL);
+            row_string(rows, "neuron", NULL, name);
+            row_long(rows, "parent", "%6ld\t", cJSON_IsNumber(parent) ? parent->valueint : -1);
+            row_long(rows, "child", "%6ld\t", cJSON_IsNumber(child) ? child->valueint : -1);
+            row_bool(rows, "charity", "%7s\t", cJSON_IsNumber(charity) ? charity->valueint != 0 : -1);
+            row_bool(rows, "automatic", "%4s\t", cJSON_IsNumber(automatic) ? automatic->valueint != 0 : -1);
+            row_address(rows, "address", json_string(cJSON_GetObjectItem(element, "address")));
+            row_address(rows, "vaultaddress", json_string(cJSON_GetObjectItem(element, "vaultaddress")));
+            row_double(rows, "reward", "%1.8f\t", cJSON_IsNumber(reward) ? reward->valuedouble : 0.0);
+            row_bool(rows, "pointed", "%7s\t\t", cJSON_IsNumber(pointed) ? pointed->valueint != 0 : -1);
+            row_string(rows, "ts", "%s", json_string(cJSON_GetObjectItem(element, "ts")));
+            row_end(rows);
+            neuron_count++;
+        }
+    }
+    cJSON_Delete(json);
+
+    rows_printf(rows, "\nNEURON '%s' HAS %d DELEGATED NEURONS\n", name, neuron_count);
+    return 0;
+}
+
+/**
+ * static int render_delegates(const char *body, const char *nickname, struct cli_rows *rows)
+ * Render the delegates listed by a delegate response
+ * @param body
+ * @param nickname
+ * @param rows
+ * @return 0 on success, -1 if the response is not a JSON array
+ */
+static int render_delegates(const char *body, const char *nickname, struct cli_rows *rows) {
+    cJSON *element = NULL;
+    cJSON *json = cJSON_Parse(body);
+
+    if (json == NULL) {
+        fprintf(stderr, "Error parsing JSON\n");
+        return -1;
+    }
+
+    if (!cJSON_IsArray(json)) {
+        fprintf(stderr, "Error: response is not a valid JSON array\n");
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    rows_printf(rows
+                , "%20s\t%35s\t%35s\t%8s\t%9s\t%s\n"
+                , "NICKNAME"
+                , "WALLET"
+                , "VAULT"
+                , "OFFER"
+                , "ACCEPTING"
+                , "ALIAS"
+            );
+
+    cJSON_ArrayForEach(element, json) {
+        if (cJSON_IsObject(element)) {
+            cJSON *offer = cJSON_GetObjectItem(element, "offer");
+            cJSON *accepting = cJSON_GetObjectItem(element, "accepting");
+
+            row_begin(rows, NULL);
+            row_string(rows, "nickname", "%20s\t", nickname);
+            row_string(rows, "wallet", "%35s\t", json_string(cJSON_GetObjectItem(element, "wallet")));
+            row_string(rows, "vault", "%35s\t", json_string(cJSON_GetObjectItem(element, "vault")));
+            row_double(rows, "offer", "%1.8f\t", cJSON_IsNumber(offer) ? offer->valuedouble : 0.0);
+            row_bool(rows, "accepting", "%9s\t", cJSON_IsNumber(accepting) ? accepting->valueint != 0 : -1);
+            row_string(rows, "alias", "%s", json_string(cJSON_GetObjectItem(element, "alias")));
+            row_end(rows);
+        }
     }
+    cJSON_Delete(json);
+
     return 0;
 }
 
-static double time_diff_ms(struct timespec start, struct timespec end) {
-    double start_ms = start.tv_sec * 1000.0 + start.tv_nsec / 1.0e6;
-    double end_ms = end.tv_sec * 1000.0 + end.tv_nsec / 1.0e6;
-    return end_ms - start_ms;
+/**
+ * static void send_rendered(struct satnow_cli_args *request, struct neuron_session *session, enum neuron_endpoint endpoint, const char *key, int (*render_fn)(const char *body, const char *key, struct cli_rows *rows))
+ * Send the output rendered from the session's response in the request's
+ * format, row by row. When the neuron returned the same content as last
+ * time, the output rendered from it then is sent without parsing the
+ * response again. A copy is kept for that only while responses are kept.
+ * @param request
+ * @param session
+ * @param endpoint
+ * @param key what the output depends on besides the response and the format
+ * @param render_fn
+ */
+static void send_rendered(struct satnow_cli_args *request, struct neuron_session *session, enum neuron_endpoint endpoint, const char *key, int (*render_fn)(const char *body, const char *key, struct cli_rows *rows)) {
+    static const char *format_names[] = { "text", "json", "ndjson" };
+    struct neuron_host *nh = satnow_neuron_host_get(session->host);
+    struct cli_render render = { 0 };
+    struct cli_rows rows;
+    char render_key[BUFFER_SIZE];
+    char *rendered;
+
+    if (!session->buffer) {
+        fprintf(stderr, "Error parsing JSON\n");
+        return;
+    }
+
+    /** Text keeps the plain key, so its cached output is unaffected */
+    if (request->format == CLI_FORMAT_TEXT) {
+        snprintf(render_key, sizeof(render_key), "%s", key ? key : "");
+    } else {
+        snprintf(render_key, sizeof(render_key), "%s:%s", format_names[request->format], key ? key : "");
+    }
+
+    rendered = satnow_neuron_host_rendered_get(nh, endpoint, session->digest, render_key);
+    if (rendered) {
+        printf("%s%s unchanged, reusing the rendered output\n", session->host, satnow_http_neuron_endpoint_name(endpoint));
+        satnow_cli_send_response(request->fd, CLI_MORE, rendered);
+        free(rendered);
+        return;
+    }
+
+    rows_begin(&rows, request, satnow_neuron_host_cache_enabled() ? &render : NULL);
+    if (render_fn(session->buffer, key, &rows) < 0) {
+        /** Nothing was sent, leave out the closing of an empty JSON array too */
+        free(rows.row.text);
+        free(render.text);
+        return;
+    }
+    rows_end(&rows);
+    if (!render.failed && render.text) {
+        satnow_neuron_host_rendered_put(nh, endpoint, session->digest, render_key, render.text);
+    }
+    free(render.text);
 }
 
 /**
@@ -242,7 +1061,7 @@ static char *cli_neuron_register(struct satnow_cli_args *request) {
     satnow_cli_send_response(request->fd, CLI_INPUT_ECHO_OFF, "Neuron Password:");
 
     memset(buffer, 0, BUFFER_SIZE);
-    rx = read(request->fd, passbuf, CONFIG_MAX_PASSWORD);
+    rx = satnow_cli_read_input(request->fd, passbuf, CONFIG_MAX_PASSWORD);
 
     if (rx > 0) {
         char *contents = NULL;
@@ -318,6 +1137,7 @@ static char *cli_neuron_unlock(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
 
         while (current) {
 #ifdef __DEBUG__
@@ -394,7 +1214,7 @@ static char *cli_neuron_unlock(struct satnow_cli_args *request) {
         satnow_repository_entry_list_free(list);
         free(session);
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
@@ -421,6 +1241,7 @@ static char *cli_neuron_addresses(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -471,18 +1292,22 @@ static char *cli_neuron_addresses(struct satnow_cli_args *request) {
                         : NULL;
 
                     if ((session->host && !strcasecmp(session->host, request->argv[2])) || (session->nickname && !strcasecmp(session->nickname, request->argv[2]))) {
-                        char tbuf[1024];
+                        struct cli_rows rows;
 
                         satnow_http_neuron_unlock(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron Authenticated.\n");
+                        send_note(request, "Neuron Authenticated.\n");
 
                         printf("satnow_http_neuron_proxy_parent_status(BEFORE) buffer len: %ld\n", session->buffer_len);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron wallet addresses to follow:\n\n");
+                        send_note(request, "Neuron wallet addresses to follow:\n\n");
                         satnow_http_neuron_mining_to_address(session);
-                        snprintf(tbuf, sizeof(tbuf), "'%s' is mining to wallet address: %s\n", request->argv[2], session->buffer);
-                        satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-
-                        satnow_cli_send_response(request->fd, CLI_MORE, "\n");
+                        rows_begin(&rows, request, NULL);
+                        row_begin(&rows, NULL);
+                        row_string(&rows, "neuron", "'%s' is mining to wallet address: ", request->argv[2]);
+                        row_string(&rows, "address", "%s", session->buffer);
+                        row_end(&rows);
+                        rows_end(&rows);
+
+                        send_note(request, "\n");
                     }
 
                     cJSON_Delete(json);
@@ -504,11 +1329,7 @@ static char *cli_neuron_addresses(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                        session->buffer_len = 0;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                 }
             }
             current = current->next;
@@ -516,7 +1337,7 @@ static char *cli_neuron_addresses(struct satnow_cli_args *request) {
         satnow_repository_entry_list_free(list);
         free(session);
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
@@ -543,6 +1364,7 @@ static char *cli_neuron_parent_status(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -594,81 +1416,22 @@ static char *cli_neuron_parent_status(struct satnow_cli_args *request) {
 
                     if ((session->host && !strcasecmp(session->host, request->argv[3])) || (session->nickname && !strcasecmp(session->nickname, request->argv[3]))) {
                         satnow_http_neuron_unlock(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron Authenticated.\n");
+                        send_note(request, "Neuron Authenticated.\n");
 
                         printf("satnow_http_neuron_proxy_parent_status(BEFORE) buffer len: %ld\n", session->buffer_len);
+                        send_note(request, "Neuron parent status to follow:\n\n");
+                        session->passthrough = request->argc == 5 && !strcasecmp(request->argv[4], "json");
                         satnow_http_neuron_proxy_parent_status(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron parent status to follow:\n\n");
-                        if (request->argc == 5 && !strcasecmp(request->argv[4], "json")) {
-                            satnow_cli_send_response(request->fd, CLI_MORE, session->buffer);
-                        } else {
-                            char tbuf[1023];
-                            int neuron_count = 0;
-                            cJSON *element = NULL;
-                            cJSON *json = cJSON_Parse(session->buffer);
-
-                            if (json == NULL) {
-                                fprintf(stderr, "Error parsing JSON\n");
-                                break;
-                            }
-
-                            if (!cJSON_IsArray(json)) {
-                                fprintf(stderr, "Error: response is not a valid JSON array\n");
-                                cJSON_Delete(json);
-                                break;
-                            }
-
-                            snprintf(tbuf, sizeof(tbuf)
-                                        , "%6s\t%6s\t%7s\t%4s\t%10s\t%10s\t%8s\t%7s\t\t%s\n"
-                                        , "PARENT"
-                                        , "CHILD"
-                                        , "CHARITY"
-                                        , "AUTO"
-                                        , "WALLET"
-                                        , "VAULT"
-                                        , "REWARD"
-                                        , "POINTED"
-                                        , "DATE"
-                                    );
-                            satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-
-                            cJSON_ArrayForEach(element, json) {
-                                if (cJSON_IsObject(element)) {
-                                    cJSON *parent = cJSON_GetObjectItem(element, "parent");
-                                    cJSON *child = cJSON_GetObjectItem(element, "child");
-                                    cJSON *charity = cJSON_GetObjectItem(element, "charity");
-                                    cJSON *automatic = cJSON_GetObjectItem(element, "automatic");
-                                    cJSON *address = cJSON_GetObjectItem(element, "address");
-                                    cJSON *vaultaddress = cJSON_GetObjectItem(element, "vaultaddress");
-                                    cJSON *reward = cJSON_GetObjectItem(element, "reward");
-                                    cJSON *pointed = cJSON_GetObjectItem(element, "pointed");
-                                    cJSON *ts = cJSON_GetObjectItem(element, "ts");
-
-                                    size_t address_len = strlen(address->valuestring);
-                                    size_t vaultaddress_len = strlen(vaultaddress->valuestring);
-
-                                    snprintf(tbuf, sizeof(tbuf)
-                                        , "%6d\t%6d\t%7s\t%4s\t%.4s...%.4s\t%.4s...%.4s\t%1.8f\t%7s\t\t%s\n"
-                                        , cJSON_IsNumber(parent) ? parent->valueint : -1
-                                        , cJSON_IsNumber(child) ? child->valueint : -1
-                                        , cJSON_IsNumber(charity) ? charity->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , cJSON_IsNumber(automatic) ? automatic->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , address->valuestring, address->valuestring + address_len - 4
-                                        , vaultaddress->valuestring, vaultaddress->valuestring + vaultaddress_len - 4
-                                        , cJSON_IsNumber(reward) ? reward->valuedouble : 0.0
-                                        , cJSON_IsNumber(pointed) ? pointed->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , cJSON_IsString(ts) ? ts->valuestring : "N/A"
-                                    );
-
-                                    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-                                    neuron_count++;
-                                }
+                        if (session->passthrough) {
+                            /** The body went to the client as it arrived unless it came from the cache */
+                            if (!session->forwarded) {
+                                send_body(request, session);
                             }
-
-                            snprintf(tbuf, sizeof(tbuf), "\nNEURON '%s' HAS %d DELEGATED NEURONS\n", request->argv[3], neuron_count);
-                            satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+                            session->passthrough = FALSE;
+                        } else {
+                            send_rendered(request, session, NEURON_ENDPOINT_PROXY_PARENT_STATUS, request->argv[3], render_delegated_neurons);
                         }
-                        satnow_cli_send_response(request->fd, CLI_MORE, "\n");
+                        send_note(request, "\n");
                     }
 
                     cJSON_Delete(json);
@@ -690,11 +1453,7 @@ static char *cli_neuron_parent_status(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                        session->buffer_len = 0;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                 }
             }
             current = current->next;
@@ -702,7 +1461,7 @@ static char *cli_neuron_parent_status(struct satnow_cli_args *request) {
         satnow_repository_entry_list_free(list);
         free(session);
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
@@ -729,6 +1488,7 @@ static char *cli_neuron_delegate(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -780,63 +1540,18 @@ static char *cli_neuron_delegate(struct satnow_cli_args *request) {
 
                     if ((session->host && !strcasecmp(session->host, request->argv[2])) || (session->nickname && !strcasecmp(session->nickname, request->argv[2]))) {
                         printf("satnow_http_neuron_delegate(BEFORE) buffer len: %ld\n", session->buffer_len);
+                        send_note(request, "Neuron delegate to follow:\n\n");
+                        session->passthrough = request->argc == 4 && !strcasecmp(request->argv[3], "json");
                         satnow_http_neuron_delegate(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron delegate to follow:\n\n");
-                        if (request->argc == 4 && !strcasecmp(request->argv[3], "json")) {
-                            satnow_cli_send_response(request->fd, CLI_MORE, session->buffer);
-                        } else {
-                            char tbuf[1023];
-                            int neuron_count = 0;
-                            size_t host_len;
-                            cJSON *element = NULL;
-                            cJSON *json = cJSON_Parse(session->buffer);
-
-                            if (json == NULL) {
-                                fprintf(stderr, "Error parsing JSON\n");
-                                break;
-                            }
-
-                            if (!cJSON_IsArray(json)) {
-                                fprintf(stderr, "Error: response is not a valid JSON array\n");
-                                cJSON_Delete(json);
-                                break;
-                            }
-
-                            host_len = strlen(session->nickname);
-
-                            snprintf(tbuf, sizeof(tbuf)
-                                        , "%20s\t%35s\t%35s\t%8s\t%9s\t%s\n"
-                                        , "NICKNAME"
-                                        , "WALLET"
-                                        , "VAULT"
-                                        , "OFFER"
-                                        , "ACCEPTING"
-                                        , "ALIAS"
-                                    );
-                            satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-
-                            cJSON_ArrayForEach(element, json) {
-                                if (cJSON_IsObject(element)) {
-                                    cJSON *wallet = cJSON_GetObjectItem(element, "wallet");
-                                    cJSON *vault = cJSON_GetObjectItem(element, "vault");
-                                    cJSON *alias = cJSON_GetObjectItem(element, "alias");
-                                    cJSON *offer = cJSON_GetObjectItem(element, "offer");
-                                    cJSON *accepting = cJSON_GetObjectItem(element, "accepting");
-
-                                    snprintf(tbuf, sizeof(tbuf), "%20s\t%35s\t%35s\t%1.8f\t%9s\t%s\n"
-                                        , session->nickname
-                                        , wallet->valuestring
-                                        , vault->valuestring
-                                        , cJSON_IsNumber(offer) ? offer->valuedouble : 0.0
-                                        , cJSON_IsNumber(accepting) ? accepting->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , alias->valuestring);
-
-                                    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-                                    neuron_count++;
-                                }
+                        if (session->passthrough) {
+                            if (!session->forwarded) {
+                                send_body(request, session);
                             }
+                            session->passthrough = FALSE;
+                        } else {
+                            send_rendered(request, session, NEURON_ENDPOINT_DELEGATE, session->nickname, render_delegates);
                         }
-                        satnow_cli_send_response(request->fd, CLI_MORE, "\n");
+                        send_note(request, "\n");
                     }
 
                     cJSON_Delete(json);
@@ -858,11 +1573,7 @@ static char *cli_neuron_delegate(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                        session->buffer_len = 0;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                 }
             }
             current = current->next;
@@ -870,7 +1581,7 @@ static char *cli_neuron_delegate(struct satnow_cli_args *request) {
         satnow_repository_entry_list_free(list);
         free(session);
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
@@ -897,6 +1608,7 @@ static char *cli_neuron_pool_participants(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -948,81 +1660,21 @@ static char *cli_neuron_pool_participants(struct satnow_cli_args *request) {
 
                     if ((session->host && !strcasecmp(session->host, request->argv[3])) || (session->nickname && !strcasecmp(session->nickname, request->argv[3]))) {
                         satnow_http_neuron_unlock(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron Authenticated.\n");
+                        send_note(request, "Neuron Authenticated.\n");
 
                         printf("satnow_http_neuron_proxy_parent_status(BEFORE) buffer len: %ld\n", session->buffer_len);
+                        send_note(request, "Neuron pool participants to follow:\n\n");
+                        session->passthrough = request->argc == 5 && !strcasecmp(request->argv[4], "json");
                         satnow_http_neuron_pool_participants(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron pool participants to follow:\n\n");
-                        if (request->argc == 5 && !strcasecmp(request->argv[4], "json")) {
-                            satnow_cli_send_response(request->fd, CLI_MORE, session->buffer);
-                        } else {
-                            char tbuf[1023];
-                            int neuron_count = 0;
-                            cJSON *element = NULL;
-                            cJSON *json = cJSON_Parse(session->buffer);
-
-                            if (json == NULL) {
-                                fprintf(stderr, "Error parsing JSON\n");
-                                break;
-                            }
-
-                            if (!cJSON_IsArray(json)) {
-                                fprintf(stderr, "Error: response is not a valid JSON array\n");
-                                cJSON_Delete(json);
-                                break;
-                            }
-
-                            snprintf(tbuf, sizeof(tbuf)
-                                        , "%6s\t%6s\t%7s\t%4s\t%10s\t%10s\t%8s\t%7s\t\t%s\n"
-                                        , "PARENT"
-                                        , "CHILD"
-                                        , "CHARITY"
-                                        , "AUTO"
-                                        , "WALLET"
-                                        , "VAULT"
-                                        , "REWARD"
-                                        , "POINTED"
-                                        , "DATE"
-                                    );
-                            satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-
-                            cJSON_ArrayForEach(element, json) {
-                                if (cJSON_IsObject(element)) {
-                                    cJSON *parent = cJSON_GetObjectItem(element, "parent");
-                                    cJSON *child = cJSON_GetObjectItem(element, "child");
-                                    cJSON *charity = cJSON_GetObjectItem(element, "charity");
-                                    cJSON *automatic = cJSON_GetObjectItem(element, "automatic");
-                                    cJSON *address = cJSON_GetObjectItem(element, "address");
-                                    cJSON *vaultaddress = cJSON_GetObjectItem(element, "vaultaddress");
-                                    cJSON *reward = cJSON_GetObjectItem(element, "reward");
-                                    cJSON *pointed = cJSON_GetObjectItem(element, "pointed");
-                                    cJSON *ts = cJSON_GetObjectItem(element, "ts");
-
-                                    size_t address_len = strlen(address->valuestring);
-                                    size_t vaultaddress_len = strlen(vaultaddress->valuestring);
-
-                                    snprintf(tbuf, sizeof(tbuf)
-                                        , "%6d\t%6d\t%7s\t%4s\t%.4s...%.4s\t%.4s...%.4s\t%1.8f\t%7s\t\t%s\n"
-                                        , cJSON_IsNumber(parent) ? parent->valueint : -1
-                                        , cJSON_IsNumber(child) ? child->valueint : -1
-                                        , cJSON_IsNumber(charity) ? charity->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , cJSON_IsNumber(automatic) ? automatic->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , address->valuestring, address->valuestring + address_len - 4
-                                        , vaultaddress->valuestring, vaultaddress->valuestring + vaultaddress_len - 4
-                                        , cJSON_IsNumber(reward) ? reward->valuedouble : 0.0
-                                        , cJSON_IsNumber(pointed) ? pointed->valueint == 0 ? "NO":"YES" : "N/A"
-                                        , cJSON_IsString(ts) ? ts->valuestring : "N/A"
-                                    );
-
-                                    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-                                    neuron_count++;
-                                }
+                        if (session->passthrough) {
+                            if (!session->forwarded) {
+                                send_body(request, session);
                             }
-
-                            snprintf(tbuf, sizeof(tbuf), "\nNEURON '%s' HAS %d DELEGATED NEURONS\n", request->argv[3], neuron_count);
-                            satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+                            session->passthrough = FALSE;
+                        } else {
+                            send_rendered(request, session, NEURON_ENDPOINT_POOL_PARTICIPANTS, request->argv[3], render_delegated_neurons);
                         }
-                        satnow_cli_send_response(request->fd, CLI_MORE, "\n");
+                        send_note(request, "\n");
                     }
 
                     cJSON_Delete(json);
@@ -1044,11 +1696,7 @@ static char *cli_neuron_pool_participants(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                        session->buffer_len = 0;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                 }
             }
             current = current->next;
@@ -1056,7 +1704,7 @@ static char *cli_neuron_pool_participants(struct satnow_cli_args *request) {
         satnow_repository_entry_list_free(list);
         free(session);
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
@@ -1073,16 +1721,44 @@ static char *cli_neuron_ping(struct satnow_cli_args *request) {
     }
 
     /** neuron ping ( <host:ip> | <nickname> ) [json] */
-    if (request->argc < 3 || request->argc > 4) {
+    /** neuron ping ( <host:ip> | <nickname> | all ) [count <n>] [interval <ms>] */
+    if (request->argc < 3 || (request->argc > 4 && !strcasecmp(request->argv[3], "json"))) {
         satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
         satnow_cli_send_response(request->fd, CLI_DONE, "\n");
         return 0;
     }
 
+    if (!strcasecmp(request->argv[2], "all") || (request->argc > 3 && strcasecmp(request->argv[3], "json"))) {
+        int count = 0;
+        long interval_ms = PING_DEFAULT_INTERVAL_MS;
+        int valid = TRUE;
+
+        for (int i = 3; valid && i < request->argc; i++) {
+            if (!strcasecmp(request->argv[i], "count") && i + 1 < request->argc) {
+                count = atoi(request->argv[++i]);
+                valid = count > 0 && count <= PING_MAX_COUNT;
+            } else if (!strcasecmp(request->argv[i], "interval") && i + 1 < request->argc) {
+                interval_ms = atol(request->argv[++i]);
+                valid = interval_ms >= 0 && interval_ms <= PING_MAX_INTERVAL_MS;
+            } else {
+                valid = FALSE;
+            }
+        }
+        if (!valid) {
+            satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+            satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+            return 0;
+        }
+
+        neuron_ping_samples(request, request->argv[2], count ? count : 1, interval_ms);
+        return 0;
+    }
+
     list = satnow_repository_entry_list();
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -1141,10 +1817,10 @@ static char *cli_neuron_ping(struct satnow_cli_args *request) {
                         clock_gettime(CLOCK_MONOTONIC, &afterTime);
                         pingTime = time_diff_ms(beforeTime, afterTime);
 
-                        if (request->argc == 3 && !strcasecmp(request->argv[2], "json")) {
+                        if (request->argc == 4 && !strcasecmp(request->argv[3], "json")) {
                             satnow_cli_send_response(request->fd, CLI_MORE, session->buffer);
                         } else {
-                            char tbuf[1024];
+                            struct cli_rows rows;
                             cJSON *ping = cJSON_Parse(session->buffer);
 
                             if (ping == NULL) {
@@ -1158,16 +1834,18 @@ static char *cli_neuron_ping(struct satnow_cli_args *request) {
                                 break;
                             }
 
-                            cJSON *now = cJSON_GetObjectItem(ping, "now");
-                            if (now && now->valuestring) {
-                                snprintf(tbuf, sizeof(tbuf), "'%s' reports current time '%s', ping time: %f ms\n", request->argv[2], now->valuestring, pingTime);
-                                satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-                            }
-
+                            const char *now = json_string(cJSON_GetObjectItem(ping, "now"));
                             if (now) {
-                                cJSON_Delete(now);
-                                now = NULL;
+                                rows_begin(&rows, request, NULL);
+                                row_begin(&rows, NULL);
+                                row_string(&rows, "neuron", "'%s' reports current time ", request->argv[2]);
+                                row_string(&rows, "now", "'%s', ", now);
+                                row_double(&rows, "ping_ms", "ping time: %f ms", pingTime);
+                                row_end(&rows);
+                                rows_end(&rows);
                             }
+
+                            cJSON_Delete(ping);
                         }
                     }
 
@@ -1187,11 +1865,7 @@ static char *cli_neuron_ping(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                        session->buffer_len = 0;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                 }
 
                 cJSON_Delete(json);
@@ -1202,7 +1876,7 @@ static char *cli_neuron_ping(struct satnow_cli_args *request) {
         satnow_repository_entry_list_free(list);
         free(session);
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
@@ -1229,6 +1903,7 @@ static char *cli_neuron_system_metrics(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -1280,13 +1955,22 @@ static char *cli_neuron_system_metrics(struct satnow_cli_args *request) {
 
                     if ((session->host && !strcasecmp(session->host, request->argv[3])) || (session->nickname && !strcasecmp(session->nickname, request->argv[3]))) {
                         satnow_http_neuron_unlock(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron Authenticated.\n");
+                        send_note(request, "Neuron Authenticated.\n");
 
                         printf("satnow_http_neuron_system_metrics(BEFORE) buffer len: %ld\n", session->buffer_len);
                         satnow_http_neuron_system_metrics(session);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Neuron system metrics to follow:\n\n");
+                        send_note(request, "Neuron system metrics to follow:\n\n");
                         if (request->argc == 5 && !strcasecmp(request->argv[4], "json")) {
-                            satnow_cli_send_response(request->fd, CLI_MORE, session->buffer);
+                            send_body(request, session);
+                        } else if (request->format != CLI_FORMAT_TEXT) {
+                            struct cli_rows rows;
+
+                            rows_begin(&rows, request, NULL);
+                            row_begin(&rows, NULL);
+                            row_string(&rows, "neuron", NULL, request->argv[3]);
+                            row_body(&rows, "metrics", NULL, session->buffer);
+                            row_end(&rows);
+                            rows_end(&rows);
                         } else {
                             char tbuf[1023];
                             cJSON *json_response = cJSON_Parse(session->buffer);
@@ -1398,7 +2082,7 @@ static char *cli_neuron_system_metrics(struct satnow_cli_args *request) {
                             // Cleanup
                             cJSON_Delete(json_response);
                         }
-                        satnow_cli_send_response(request->fd, CLI_MORE, "\n");
+                        send_note(request, "\n");
                     }
 
                     cJSON_Delete(json);
@@ -1420,10 +2104,7 @@ static char *cli_neuron_system_metrics(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                 }
             }
             current = current->next;
@@ -1435,13 +2116,89 @@ static char *cli_neuron_system_metrics(struct satnow_cli_args *request) {
             session = NULL;
         }
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
+/**
+ * One neuron queried by neuron stats
+ */
+struct stats_run {
+    struct neuron_session *session;
+    double ms;
+    int done;                   /** answered, waiting for its turn in --ordered mode */
+};
+
+struct stats_fleet {
+    struct satnow_cli_args *request;
+    struct stats_run *runs;
+    int neurons;
+    int ordered;                /** keep repository order rather than send rows as neurons answer */
+    int next;                   /** --ordered: first neuron whose row has not been sent */
+    pthread_mutex_t send_mutex; /** keeps rows from interleaving */
+    struct cli_rows rows;
+};
+
+/**
+ * static void stats_row(struct stats_fleet *fleet, struct stats_run *run)
+ * Send a neuron's stats row and release its response. Caller holds send_mutex.
+ * @param fleet
+ * @param run
+ */
+static void stats_row(struct stats_fleet *fleet, struct stats_run *run) {
+    struct neuron_session *session = run->session;
+
+    row_begin(&fleet->rows, NULL);
+    row_string(&fleet->rows, "neuron", "%s: ", session->nickname ? session->nickname : session->host);
+    row_double(&fleet->rows, "ms", NULL, run->ms);
+    row_body(&fleet->rows, "stats", "%s", session->buffer);
+    row_end(&fleet->rows);
+    satnow_http_neuron_buffer_free(session);
+}
+
+/**
+ * static void stats_run_neuron(int index, void *context)
+ * Unlock one neuron, read its stats and send the row as soon as it is
+ * allowed to go: at once, or in --ordered mode once every neuron before
+ * it in the repository has been sent
+ * @param index
+ * @param context
+ */
+static void stats_run_neuron(int index, void *context) {
+    struct stats_fleet *fleet = context;
+    struct stats_run *run = &fleet->runs[index];
+    struct timespec start, end;
+
+    if (satnow_cli_cancelled(fleet->request)) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    satnow_http_neuron_unlock(run->session);
+    printf("satnow_http_neuron_stats(BEFORE) buffer len: %ld\n", run->session->buffer_len);
+    satnow_http_neuron_stats(run->session);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    run->ms = time_diff_ms(start, end);
+
+    pthread_mutex_lock(&fleet->send_mutex);
+    if (fleet->ordered) {
+        run->done = TRUE;
+        while (fleet->next < fleet->neurons && fleet->runs[fleet->next].done) {
+            stats_row(fleet, &fleet->runs[fleet->next++]);
+        }
+    } else {
+        stats_row(fleet, run);
+    }
+    satnow_cli_flush(fleet->request->fd);
+    pthread_mutex_unlock(&fleet->send_mutex);
+}
+
 static char *cli_neuron_stats(struct satnow_cli_args *request) {
+    struct stats_fleet fleet = { request, NULL, 0, FALSE, 0, PTHREAD_MUTEX_INITIALIZER, { 0 } };
     struct repository_entry *list = NULL;
-    struct neuron_session *session = NULL;
+    const char *target = NULL;
+    struct timespec start, end;
+    int valid = TRUE;
 
     if (!satnow_repository_password_valid()) {
         satnow_cli_request_repository_password(request->fd);
@@ -1451,116 +2208,391 @@ static char *cli_neuron_stats(struct satnow_cli_args *request) {
         printf("ARG[%d]: %s\n", i, request->argv[i]);
     }
 
-    /** neuron stats ( <host:ip> | <nickname> ) */
-    if (request->argc < 2 || request->argc > 3) {
+    /** neuron stats [--ordered] [( <host:ip> | <nickname> )] */
+    for (int i = 2; i < request->argc; i++) {
+        if (!strcasecmp(request->argv[i], "--ordered")) {
+            fleet.ordered = TRUE;
+        } else if (!target) {
+            target = request->argv[i];
+        } else {
+            valid = FALSE;
+        }
+    }
+    if (!valid) {
         satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
         satnow_cli_send_response(request->fd, CLI_DONE, "\n");
         return 0;
     }
 
     list = satnow_repository_entry_list();
+    fleet.runs = calloc(repository_entry_count(list) + 1, sizeof(*fleet.runs));
+    for (struct repository_entry *current = list; fleet.runs && current; current = current->next) {
+        struct neuron_session *session = repository_entry_session(current);
+
+        if (!session || (target && strcasecmp(session->host, target) && (!session->nickname || strcasecmp(session->nickname, target)))) {
+            neuron_session_free(session);
+            continue;
+        }
+        session->client_fd = request->fd;
+        fleet.runs[fleet.neurons++].session = session;
+    }
     if (list) {
-        struct repository_entry *current = list;
+        satnow_repository_entry_list_free(list);
+    }
 
-        while (current) {
-            session = calloc(1, sizeof(*session));
-            session->buffer = NULL;
-            session->buffer_len = 0;
+    rows_begin(&fleet.rows, request, NULL);
+    if (fleet.neurons) {
+        /** Rows go out as neurons answer, the slowest one no longer holds up the rest */
+        satnow_cli_flush(request->fd);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        satnow_fanout(fleet.neurons, STATS_CONCURRENCY, stats_run_neuron, &fleet);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (!satnow_cli_cancelled(request)) {
+            row_begin(&fleet.rows, "summary");
+            row_long(&fleet.rows, "neurons", "\n%ld", fleet.neurons);
+            row_text(&fleet.rows, " neuron%s", fleet.neurons == 1 ? "" : "s");
+            row_double(&fleet.rows, "ms", " in %.0f ms", time_diff_ms(start, end));
+            for (int i = 0; i < fleet.neurons; i++) {
+                struct neuron_session *session = fleet.runs[i].session;
+
+                row_text(&fleet.rows, "%s %s %.0f ms", i ? "," : ":", session->nickname ? session->nickname : session->host, fleet.runs[i].ms);
+            }
+            row_end(&fleet.rows);
+        }
+    }
+    rows_end(&fleet.rows);
 
-#ifdef __DEBUG__
-            printf("Entry:\n");
-            printf("  Salt: ");
-            for (int i = 0; i < SALT_LEN; i++) printf("%02x", current->salt[i]);
-            printf("\n");
-            printf("  IV: ");
-            for (int i = 0; i < IV_LEN; i++) printf("%02x", current->iv[i]);
-            printf("\n");
-            printf("  Ciphertext length: %lu\n", current->ciphertext_len);
-#endif
+    for (int i = 0; i < fleet.neurons; i++) {
+        neuron_session_free(fleet.runs[i].session);
+    }
+    free(fleet.runs);
+    pthread_mutex_destroy(&fleet.send_mutex);
+
+    send_done(request);
+    return 0;
+}
+
+/**
+ * static void neuron_endpoints_rows(struct neuron_host *nh, void *context)
+ * Send one row per endpoint the neuron has answered
+ * @param nh
+ * @param context the rows
+ */
+static void neuron_endpoints_rows(struct neuron_host *nh, void *context) {
+    struct cli_rows *rows = context;
+
+    for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+        struct neuron_endpoint_traffic *t = &nh->traffic[i];
+
+        if (!t->transfers && !t->cache_hits) {
+            continue;
+        }
+        row_begin(rows, NULL);
+        row_string(rows, "host", "%-24s", nh->host);
+        row_string(rows, "endpoint", " %-42s", satnow_http_neuron_endpoint_name(i));
+        row_long(rows, "transfers", " %9ld", (long)t->transfers);
+        row_long(rows, "cache_hits", " %10ld", (long)t->cache_hits);
+        row_long(rows, "unchanged", " %9ld", (long)t->unchanged);
+        row_long(rows, "parses_skipped", " %14ld", (long)t->parses_skipped);
+        row_double(rows, "srtt_ms", " %8.1f", nh->latency[i].srtt_ms);
+        row_double(rows, "rttvar_ms", " %9.1f", nh->latency[i].rttvar_ms);
+        row_long(rows, "wire_bytes", " %12ld", (long)t->wire_bytes);
+        row_long(rows, "decoded_bytes", " %12ld", (long)t->decoded_bytes);
+        row_double(rows, "ratio", " %6.2f", t->wire_bytes ? (double)t->decoded_bytes / t->wire_bytes : 1.0);
+        row_end(rows);
+    }
+}
+
+static char *cli_neuron_endpoints(struct satnow_cli_args *request) {
+    struct cli_rows rows;
+
+    /** neuron endpoints */
+    if (request->argc != 2) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    rows_begin(&rows, request, NULL);
+    rows_printf(&rows, "%-24s %-42s %9s %10s %9s %14s %8s %9s %12s %12s %6s\n", "HOST", "ENDPOINT", "TRANSFERS", "CACHE HITS", "UNCHANGED", "PARSES SKIPPED", "SRTT MS", "RTTVAR MS", "WIRE BYTES", "DECODED", "RATIO");
+    satnow_neuron_host_foreach(neuron_endpoints_rows, &rows);
+    rows_end(&rows);
+
+    send_done(request);
+    return 0;
+}
+
+struct neuron_latency_context {
+    struct satnow_cli_args *request;
+    const char *host;       /** only this host, or every host when NULL */
+    struct cli_rows *rows;
+};
+
+/**
+ * static void neuron_latency_rows(struct neuron_host *nh, void *context)
+ * Send the percentiles of every timing phase the neuron's endpoints have recorded
+ * @param nh
+ * @param context
+ */
+static void neuron_latency_rows(struct neuron_host *nh, void *context) {
+    struct neuron_latency_context *ctx = context;
+
+    if (ctx->host && strcasecmp(ctx->host, nh->host)) {
+        return;
+    }
+
+    for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+        struct neuron_endpoint_timing *timing = satnow_neuron_host_timing(nh, i);
+
+        for (int m = 0; timing && m < NEURON_TIMING_MAX; m++) {
+            struct satnow_histogram *h = &timing->metrics[m];
+            /** times are kept in microseconds and shown in milliseconds */
+            double scale = m == NEURON_TIMING_BYTES ? 1.0 : 1000.0;
+            const char *format = m == NEURON_TIMING_BYTES ? " %10.0f" : " %10.3f";
+
+            if (!satnow_histogram_count(h)) {
+                continue;
+            }
+            row_begin(ctx->rows, NULL);
+            row_string(ctx->rows, "host", "%-24s", nh->host);
+            row_string(ctx->rows, "endpoint", " %-42s", satnow_http_neuron_endpoint_name(i));
+            row_string(ctx->rows, "phase", " %-10s", satnow_neuron_host_timing_name(m));
+            row_string(ctx->rows, "unit", NULL, m == NEURON_TIMING_BYTES ? "bytes" : "ms");
+            row_long(ctx->rows, "samples", " %8ld", (long)satnow_histogram_count(h));
+            row_double(ctx->rows, "p50", format, satnow_histogram_percentile(h, 50.0) / scale);
+            row_double(ctx->rows, "p90", format, satnow_histogram_percentile(h, 90.0) / scale);
+            row_double(ctx->rows, "p99", format, satnow_histogram_percentile(h, 99.0) / scale);
+            row_double(ctx->rows, "max", format, satnow_histogram_max(h) / scale);
+            row_end(ctx->rows);
+        }
+    }
+}
+
+static char *cli_neuron_latency(struct satnow_cli_args *request) {
+    struct cli_rows rows;
+    struct neuron_latency_context ctx = { request, NULL, &rows };
+
+    /** neuron latency [<ip>:<port>] */
+    if (request->argc > 3) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+    if (request->argc == 3) {
+        ctx.host = request->argv[2];
+    }
+
+    rows_begin(&rows, request, NULL);
+    rows_printf(&rows, "%-24s %-42s %-10s %8s %10s %10s %10s %10s\n", "HOST", "ENDPOINT", "PHASE", "SAMPLES", "P50", "P90", "P99", "MAX");
+    satnow_neuron_host_foreach(neuron_latency_rows, &ctx);
+    rows_printf(&rows, "\nTimes are in milliseconds, bytes are as received. dns, connect and tls are only sampled when a new connection was opened.\n");
+    rows_end(&rows);
+
+    send_done(request);
+    return 0;
+}
+
+/**
+ * static void neuron_latency_reset_host(struct neuron_host *nh, void *context)
+ * Forget the neuron's timing histograms when it matches the requested host
+ * @param nh
+ * @param context
+ */
+static void neuron_latency_reset_host(struct neuron_host *nh, void *context) {
+    struct neuron_latency_context *ctx = context;
+
+    if (ctx->host && strcasecmp(ctx->host, nh->host)) {
+        return;
+    }
+    satnow_neuron_host_timing_reset(nh);
+    row_begin(ctx->rows, NULL);
+    row_string(ctx->rows, "host", "Latency histograms reset for %s", nh->host);
+    row_end(ctx->rows);
+}
+
+static char *cli_neuron_latency_reset(struct satnow_cli_args *request) {
+    struct cli_rows rows;
+    struct neuron_latency_context ctx = { request, NULL, &rows };
+
+    /** neuron latency reset [<ip>:<port>] */
+    if (request->argc > 4) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+    if (request->argc == 4) {
+        ctx.host = request->argv[3];
+    }
+
+    rows_begin(&rows, request, NULL);
+    satnow_neuron_host_foreach(neuron_latency_reset_host, &ctx);
+    rows_end(&rows);
+
+    send_done(request);
+    return 0;
+}
+
+static char *cli_neuron_prefetch(struct satnow_cli_args *request) {
+    struct neuron_prefetch_stats stats;
+    struct cli_rows rows;
+
+    /** neuron prefetch */
+    if (request->argc != 2) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    satnow_http_neuron_prefetch_stats(&stats);
+    rows_begin(&rows, request, NULL);
+    rows_printf(&rows, "response_cache_ms: %ld\nprefetch: %ld\nprefetch_rate: %ld per second\n\n"
+        , satnow_config_get(CONFIG_RESPONSE_CACHE_MS)
+        , satnow_config_get(CONFIG_PREFETCH)
+        , satnow_config_get(CONFIG_PREFETCH_RATE));
+    rows_printf(&rows, "%6s %6s %9s %7s %9s\n", "QUEUED", "ACTIVE", "COMPLETED", "SKIPPED", "CANCELLED");
+    row_begin(&rows, NULL);
+    row_long(&rows, "response_cache_ms", NULL, satnow_config_get(CONFIG_RESPONSE_CACHE_MS));
+    row_long(&rows, "prefetch", NULL, satnow_config_get(CONFIG_PREFETCH));
+    row_long(&rows, "prefetch_rate", NULL, satnow_config_get(CONFIG_PREFETCH_RATE));
+    row_long(&rows, "queued", "%6ld", stats.queued);
+    row_long(&rows, "active", " %6ld", stats.active);
+    row_long(&rows, "completed", " %9ld", (long)stats.completed);
+    row_long(&rows, "skipped", " %7ld", (long)stats.skipped);
+    row_long(&rows, "cancelled", " %9ld", (long)stats.cancelled);
+    row_end(&rows);
+    rows_end(&rows);
+
+    send_done(request);
+    return 0;
+}
+
+static char *cli_neuron_prefetch_cancel(struct satnow_cli_args *request) {
+    char tbuf[BUFFER_SIZE];
+    int count;
+
+    /** neuron prefetch cancel */
+    if (request->argc != 3) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    count = satnow_http_neuron_prefetch_cancel();
+
+    snprintf(tbuf, sizeof(tbuf), "Cancelled %d prefetch%s\n", count, count == 1 ? "" : "es");
+    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+
+    send_done(request);
+    return 0;
+}
+
+/**
+ * static void neuron_pin_row(const char *host, const char *pin, void *context)
+ * Send one saved pin to the client
+ * @param host
+ * @param pin
+ * @param context the rows
+ */
+static void neuron_pin_row(const char *host, const char *pin, void *context) {
+    struct cli_rows *rows = context;
+
+    row_begin(rows, NULL);
+    row_string(rows, "host", "%-32s", host);
+    row_string(rows, "public_key", " %s", pin);
+    row_end(rows);
+}
+
+static char *cli_neuron_pins(struct satnow_cli_args *request) {
+    struct cli_rows rows;
+
+    /** neuron pins */
+    if (request->argc != 2) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    rows_begin(&rows, request, NULL);
+    rows_printf(&rows, "tls_pin: %ld\ntls_verify_ca: %ld\n\n%-32s %s\n"
+        , satnow_config_get(CONFIG_TLS_PIN)
+        , satnow_config_get(CONFIG_TLS_VERIFY_CA)
+        , "HOST", "PUBLIC KEY");
+    satnow_neuron_host_pin_foreach(neuron_pin_row, &rows);
+    rows_end(&rows);
+
+    send_done(request);
+    return 0;
+}
+
+static char *cli_neuron_pin_forget(struct satnow_cli_args *request) {
+    char tbuf[BUFFER_SIZE];
+
+    /** neuron pin forget <host> */
+    if (request->argc != 4) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    if (satnow_neuron_host_pin_forget(request->argv[3])) {
+        snprintf(tbuf, sizeof(tbuf), "Forgot the public key pinned for %s\n", request->argv[3]);
+    } else {
+        snprintf(tbuf, sizeof(tbuf), "No public key is pinned for %s\n", request->argv[3]);
+    }
+    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
 
-            if (current->plaintext) {
-                free(current->plaintext);
-                current->plaintext = NULL;
-            }
-            current->plaintext = malloc(current->ciphertext_len + 1);
-            if (!current->plaintext) {
-                printf("Out of memory\n");
-            }
-            else {
-                cJSON *json = NULL;
+    send_done(request);
+    return 0;
+}
 
-                satnow_encrypt_ciphertext2text(current->ciphertext, (int)current->ciphertext_len, current->file_key, current->iv, current->plaintext, (int *)&current->plaintext_len);
-                current->plaintext[current->plaintext_len] = '\0';
+/**
+ * static void neuron_status_row(struct neuron_host *nh, void *context)
+ * Send one neuron's circuit breaker state to the client
+ * @param nh
+ * @param context the rows
+ */
+static void neuron_status_row(struct neuron_host *nh, void *context) {
+    struct cli_rows *rows = context;
+    char when[32] = "-";
 
-                if (strcasecmp((const char *)current->plaintext, REPOSITORY_MARKER) != 0) {
-                    json = cJSON_Parse((char *)current->plaintext);
-                    if (!json) {
-                        fprintf(stderr, "Invalid JSON format. (%d) [%s]\n", __LINE__, (char *)current->plaintext);
-                    } else {
-                        char tbuf[1023];
-                        const cJSON *json_host = cJSON_GetObjectItemCaseSensitive(json, "host");
-                        const cJSON *json_password = cJSON_GetObjectItemCaseSensitive(json, "password");
-                        const cJSON *json_nickname = cJSON_GetObjectItemCaseSensitive(json, "nickname");
-
-                        session->host = json_host && json_host->valuestring
-                            ? satnow_json_string_unescape(json_host->valuestring)
-                            : NULL;
-
-                        session->pass = json_password && json_password->valuestring
-                            ? satnow_json_string_unescape(json_password->valuestring)
-                            : NULL;
-
-                        session->nickname = json_nickname && json_nickname->valuestring
-                            ? satnow_json_string_unescape(json_nickname->valuestring)
-                            : NULL;
-
-                        if (request->argc == 2
-                            || (session->host && !strcasecmp(session->host, request->argv[2]))
-                            || (session->nickname && !strcasecmp(session->nickname, request->argv[2]))) {
-
-                            satnow_http_neuron_unlock(session);
-                            printf("satnow_http_neuron_stats(BEFORE) buffer len: %ld\n", session->buffer_len);
-                            satnow_http_neuron_stats(session);
-                            snprintf(tbuf, sizeof(tbuf), "%s: %s\n", session->nickname ? session->nickname : session->host, session->buffer);
-                            satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
-                            }
+    if (nh->last_error_time) {
+        struct tm tm;
 
-                        cJSON_Delete(json);
-                        json = NULL;
-                    }
-                }
+        localtime_r(&nh->last_error_time, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    }
 
-                if (session->host) {
-                    free(session->host);
-                    session->host = NULL;
-                }
-                if (session->pass) {
-                    free(session->pass);
-                    session->pass = NULL;
-                }
-                if (session->nickname) {
-                    free(session->nickname);
-                    session->nickname = NULL;
-                }
-                if (session->session) {
-                    free(session->session);
-                    session->session = NULL;
-                }
-                if (session->buffer) {
-                    free(session->buffer);
-                    session->buffer = NULL;
-                }
-            }
-            current = current->next;
+    row_begin(rows, NULL);
+    row_string(rows, "host", "%-24s", nh->host);
+    row_string(rows, "state", " %-9s", satnow_neuron_host_breaker_name(nh->breaker));
+    row_long(rows, "failures", " %8ld", nh->failures);
+    row_long(rows, "skipped", " %8ld", (long)nh->skipped);
+    row_long(rows, "retry_ms", " %8ld", satnow_neuron_host_retry_in_ms(nh));
+    row_long(rows, "transfers", " %9ld", (long)nh->transfers);
+    row_long(rows, "connects", " %8ld", (long)nh->connects);
+    row_string(rows, "last_error_time", NULL, nh->last_error_time ? when : NULL);
+    row_string(rows, "last_error", NULL, nh->last_error[0] ? nh->last_error : NULL);
+    row_text(rows, "  %s %s", when, nh->last_error);
+    row_end(rows);
+}
 
-            if (session) {
-                free(session);
-                session = NULL;
-            }
-        }
-        satnow_repository_entry_list_free(list);
+static char *cli_neuron_status(struct satnow_cli_args *request) {
+    struct cli_rows rows;
+
+    /** neuron status */
+    if (request->argc != 2) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+
+    rows_begin(&rows, request, NULL);
+    rows_printf(&rows, "%-24s %-9s %8s %8s %8s %9s %8s  %s\n", "HOST", "STATE", "FAILURES", "SKIPPED", "RETRY MS", "TRANSFERS", "CONNECTS", "LAST ERROR");
+    satnow_neuron_host_foreach(neuron_status_row, &rows);
+    rows_end(&rows);
+
+    send_done(request);
     return 0;
 }
 
@@ -1587,6 +2619,7 @@ static char *cli_neuron_vault(struct satnow_cli_args *request) {
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -1641,7 +2674,7 @@ static char *cli_neuron_vault(struct satnow_cli_args *request) {
                         satnow_http_neuron_unlock(session);
                         satnow_http_neuron_vault(session);
                         satnow_cli_send_response(request->fd, CLI_MORE, session->csrf_token);
-                        satnow_cli_send_response(request->fd, CLI_MORE, "\n");
+                        send_note(request, "\n");
                     }
 
                     cJSON_Delete(json);
@@ -1663,10 +2696,7 @@ static char *cli_neuron_vault(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                     if (session->csrf_token) {
                         free(session->csrf_token);
                         session->csrf_token = NULL;
@@ -1682,33 +2712,45 @@ static char *cli_neuron_vault(struct satnow_cli_args *request) {
             session = NULL;
         }
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
     return 0;
 }
 
-static char *cli_neuron_vault_transfer(struct satnow_cli_args *request) {
-    struct repository_entry *list = NULL;
-    struct neuron_session *session = NULL;
-
-    if (!satnow_repository_password_valid()) {
-        satnow_cli_request_repository_password(request->fd);
-    }
+/**
+ * static int cli_confirm(int fd, const char *prompt)
+ * Ask the CLI client a yes/no question
+ * @param fd
+ * @param prompt
+ * @return TRUE if the answer starts with Y
+ */
+static int cli_confirm(int fd, const char *prompt) {
+    char buffer[BUFFER_SIZE];
+    ssize_t rx;
 
-    for (int i = 0; i < request->argc; i++) {
-        printf("ARG[%d]: %s\n", i, request->argv[i]);
+    satnow_cli_send_response(fd, CLI_INPUT, prompt);
+    rx = satnow_cli_read_input(fd, buffer, sizeof(buffer) - 1);
+    if (rx <= 0) {
+        return FALSE;
     }
+    buffer[rx] = '\0';
+    return toupper((unsigned char)buffer[0]) == 'Y';
+}
 
-    /** neuron vault transfer <amount> satori <wallet-address> ( <host:ip> | <nickname> ) */
-    if (request->argc != 7) {
-        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
-        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
-        return 0;
-    }
+/**
+ * static void vault_transfer_job(struct satnow_cli_args *request)
+ * Open, decrypt and transfer from the requested neuron's vault. Runs on its
+ * own thread, the vault may take a while to decrypt.
+ * @param request
+ */
+static void vault_transfer_job(struct satnow_cli_args *request) {
+    struct repository_entry *list = NULL;
+    struct neuron_session *session = NULL;
 
     list = satnow_repository_entry_list();
     if (list) {
         struct repository_entry *current = list;
         session = calloc(1, sizeof(*session));
+        session->client_fd = request->fd;
         session->buffer = NULL;
         session->buffer_len = 0;
 
@@ -1759,18 +2801,32 @@ static char *cli_neuron_vault_transfer(struct satnow_cli_args *request) {
                         : NULL;
 
                     if ((session->host && !strcasecmp(session->host, request->argv[6])) || (session->nickname && !strcasecmp(session->nickname, request->argv[6]))) {
+                        struct timespec start, end;
+                        char tbuf[BUFFER_SIZE];
+
                         satnow_cli_send_response(request->fd, CLI_MORE, "Neuron located. Connecting...\n");
-                        satnow_http_neuron_unlock(session);
-                        satnow_http_neuron_vault(session);
-                        satnow_http_neuron_decrypt_vault(session);
-                        satnow_cli_send_response(request->fd, CLI_INPUT_ECHO_OFF, "Proceed [Y/N]:");
-                        printf("sleep");
-                        sleep(10);
-                        printf("sleep done");
-
-                        satnow_cli_send_response(request->fd, CLI_MORE, "Transferring satori\n");
-                        satnow_http_neuron_vault_transfer(session, request->argv[3] /* amount */, request->argv[5] /* destination address */);
-                        satnow_cli_send_response(request->fd, CLI_MORE, session->csrf_token);
+                        if (satnow_http_neuron_unlock(session)
+                            || satnow_http_neuron_vault(session)
+                            || satnow_http_neuron_decrypt_vault(session)) {
+                            satnow_cli_send_response(request->fd, CLI_MORE, "Unable to open the neuron's vault\n");
+                        } else if (!cli_confirm(request->fd, "Proceed [Y/N]:")) {
+                            satnow_cli_send_response(request->fd, CLI_MORE, "Transfer cancelled\n");
+                        } else {
+                            /** The neuron decrypts while the user answers, usually nothing is left to wait for */
+                            clock_gettime(CLOCK_MONOTONIC, &start);
+                            if (satnow_http_neuron_wait_vault_ready(session)) {
+                                satnow_cli_send_response(request->fd, CLI_MORE, "The neuron's vault was not decrypted in time\n");
+                            } else {
+                                satnow_cli_send_response(request->fd, CLI_MORE, "Transferring satori\n");
+                                if (satnow_http_neuron_vault_transfer(session, request->argv[3] /* amount */, request->argv[5] /* destination address */, FALSE)) {
+                                    satnow_cli_send_response(request->fd, CLI_MORE, "Transfer failed\n");
+                                } else {
+                                    clock_gettime(CLOCK_MONOTONIC, &end);
+                                    snprintf(tbuf, sizeof(tbuf), "Transfer submitted, %.0f ms after confirmation\n", time_diff_ms(start, end));
+                                    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+                                }
+                            }
+                        }
                     }
 
                     cJSON_Delete(json);
@@ -1792,10 +2848,7 @@ static char *cli_neuron_vault_transfer(struct satnow_cli_args *request) {
                         free(session->session);
                         session->session = NULL;
                     }
-                    if (session->buffer) {
-                        free(session->buffer);
-                        session->buffer = NULL;
-                    }
+                    satnow_http_neuron_buffer_free(session);
                     if (session->csrf_token) {
                         free(session->csrf_token);
                         session->csrf_token = NULL;
@@ -1811,6 +2864,603 @@ static char *cli_neuron_vault_transfer(struct satnow_cli_args *request) {
             session = NULL;
         }
     }
-    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    send_done(request);
+}
+
+/**
+ * static void neuron_session_free(struct neuron_session *session)
+ * Release a session and everything it holds
+ * @param session
+ */
+static void neuron_session_free(struct neuron_session *session) {
+    if (!session) {
+        return;
+    }
+    free(session->host);
+    free(session->pass);
+    free(session->nickname);
+    free(session->session);
+    free(session->csrf_token);
+    satnow_http_neuron_buffer_free(session);
+    free(session);
+}
+
+/**
+ * static struct neuron_session *repository_entry_session(struct repository_entry *entry)
+ * Decrypt a repository entry into a new neuron session
+ * @param entry
+ * @return the session, or NULL for the repository marker and unreadable entries
+ */
+static struct neuron_session *repository_entry_session(struct repository_entry *entry) {
+    struct neuron_session *session = NULL;
+    cJSON *json = NULL;
+
+    free(entry->plaintext);
+    entry->plaintext = malloc(entry->ciphertext_len + 1);
+    if (!entry->plaintext) {
+        printf("Out of memory\n");
+        return NULL;
+    }
+
+    satnow_encrypt_ciphertext2text(entry->ciphertext, (int)entry->ciphertext_len, entry->file_key, entry->iv, entry->plaintext, (int *)&entry->plaintext_len);
+    entry->plaintext[entry->plaintext_len] = '\0';
+    if (!strcasecmp((const char *)entry->plaintext, REPOSITORY_MARKER)) {
+        return NULL;
+    }
+
+    json = cJSON_Parse((char *)entry->plaintext);
+    if (!json) {
+        fprintf(stderr, "Invalid JSON format. (%d) [%s]\n", __LINE__, (char *)entry->plaintext);
+        return NULL;
+    }
+
+    const cJSON *json_host = cJSON_GetObjectItemCaseSensitive(json, "host");
+    const cJSON *json_password = cJSON_GetObjectItemCaseSensitive(json, "password");
+    const cJSON *json_nickname = cJSON_GetObjectItemCaseSensitive(json, "nickname");
+
+    if (json_host && json_host->valuestring) {
+        session = calloc(1, sizeof(*session));
+    }
+    if (session) {
+        session->host = satnow_json_string_unescape(json_host->valuestring);
+        session->pass = json_password && json_password->valuestring
+            ? satnow_json_string_unescape(json_password->valuestring)
+            : NULL;
+        session->nickname = json_nickname && json_nickname->valuestring
+            ? satnow_json_string_unescape(json_nickname->valuestring)
+            : NULL;
+    }
+    cJSON_Delete(json);
+
+    return session;
+}
+
+/**
+ * static int repository_entry_count(struct repository_entry *list)
+ * @param list
+ * @return the entries in the list, which bounds the neurons registered in it
+ */
+static int repository_entry_count(struct repository_entry *list) {
+    int count = 0;
+
+    for (struct repository_entry *current = list; current; current = current->next) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * static struct neuron_session *repository_session(struct repository_entry *list, const char *name)
+ * Decrypt repository entries until the neuron with the specified host or
+ * nickname is found and return a new session for it
+ * @param list
+ * @param name
+ * @return NULL if the neuron is not registered
+ */
+static struct neuron_session *repository_session(struct repository_entry *list, const char *name) {
+    for (struct repository_entry *current = list; current; current = current->next) {
+        struct neuron_session *session = repository_entry_session(current);
+
+        if (session && ((session->host && !strcasecmp(session->host, name)) || (session->nickname && !strcasecmp(session->nickname, name)))) {
+            return session;
+        }
+        neuron_session_free(session);
+    }
+    return NULL;
+}
+
+
+/**
+ * Samples collected from one neuron by neuron ping ... count
+ */
+struct ping_run {
+    struct neuron_session *session;
+    double *samples;            /** total time of each answered request, in order */
+    int sent;
+    int received;
+    int first_ok;
+    double first_ms;
+    long first_connects;        /** whether the first request had to connect */
+    double stats[6];            /** steady state min, avg, p50, p99, max, stddev */
+    int steady;                 /** answered requests after the first */
+};
+
+enum ping_stat {
+    PING_MIN = 0,
+    PING_AVG,
+    PING_P50,
+    PING_P99,
+    PING_MAX,
+    PING_STDDEV,
+};
+
+struct ping_fleet {
+    struct satnow_cli_args *request;
+    struct ping_run *runs;
+    int neurons;
+    int count;
+    long interval_ms;
+    pthread_mutex_t send_mutex;     /** keeps sample rows from interleaving */
+    struct cli_rows rows;
+};
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * static void ping_run_stats(struct ping_run *run)
+ * Summarize the samples that followed the first request
+ * @param run
+ */
+static void ping_run_stats(struct ping_run *run) {
+    double *steady = run->samples + (run->first_ok ? 1 : 0);
+    int n = run->received - (run->first_ok ? 1 : 0);
+    double sum = 0.0;
+    double squares = 0.0;
+
+    run->steady = n;
+    if (n <= 0) {
+        return;
+    }
+
+    qsort(steady, n, sizeof(*steady), compare_double);
+    for (int i = 0; i < n; i++) {
+        sum += steady[i];
+    }
+    run->stats[PING_AVG] = sum / n;
+    for (int i = 0; i < n; i++) {
+        squares += (steady[i] - run->stats[PING_AVG]) * (steady[i] - run->stats[PING_AVG]);
+    }
+    run->stats[PING_MIN] = steady[0];
+    run->stats[PING_MAX] = steady[n - 1];
+    /** nearest rank percentiles */
+    run->stats[PING_P50] = steady[(int)ceil(0.50 * n) - 1];
+    run->stats[PING_P99] = steady[(int)ceil(0.99 * n) - 1];
+    run->stats[PING_STDDEV] = sqrt(squares / n);
+}
+
+/**
+ * static void ping_run_neuron(int index, void *context)
+ * Ping one neuron count times, streaming each sample back to the client
+ * @param index
+ * @param context
+ */
+static void ping_run_neuron(int index, void *context) {
+    struct ping_fleet *fleet = context;
+    struct ping_run *run = &fleet->runs[index];
+    struct neuron_session *session = run->session;
+    const char *name = session->nickname ? session->nickname : session->host;
+
+    for (int seq = 1; seq <= fleet->count && !satnow_cli_cancelled(fleet->request); seq++) {
+        struct neuron_sample sample = { 0 };
+        int ok = satnow_http_neuron_ping_sample(session, &sample) == 0;
+
+        run->sent++;
+        if (ok) {
+            run->samples[run->received++] = sample.total_ms;
+        }
+        if (seq == 1) {
+            run->first_ok = ok;
+            run->first_ms = sample.total_ms;
+            run->first_connects = sample.connects;
+        }
+
+        /** Samples stream as they are taken, not buffered on this thread */
+        pthread_mutex_lock(&fleet->send_mutex);
+        row_begin(&fleet->rows, "sample");
+        row_string(&fleet->rows, "neuron", "'%s'", name);
+        row_long(&fleet->rows, "seq", " seq=%ld", seq);
+        row_bool(&fleet->rows, "ok", NULL, ok);
+        if (ok) {
+            row_double(&fleet->rows, "time_ms", " time=%.3f ms", sample.total_ms);
+            row_double(&fleet->rows, "first_byte_ms", " first byte=%.3f ms", sample.first_byte_ms);
+            row_bool(&fleet->rows, "new_connection", NULL, sample.connects > 0);
+            row_text(&fleet->rows, "%s", sample.connects > 0 ? " (new connection)" : "");
+        } else if (sample.status) {
+            row_long(&fleet->rows, "http_status", " failed, HTTP %ld", sample.status);
+        } else {
+            row_text(&fleet->rows, " failed, no response");
+        }
+        row_end(&fleet->rows);
+        satnow_cli_flush(fleet->request->fd);
+        pthread_mutex_unlock(&fleet->send_mutex);
+
+        if (seq < fleet->count && satnow_http_neuron_sleep(session, fleet->interval_ms)) {
+            break;
+        }
+    }
+
+    ping_run_stats(run);
+}
+
+/**
+ * static int compare_ping_run(const void *a, const void *b)
+ * Order neurons by steady state median, then first request time. Neurons that
+ * never answered go last.
+ * @param a
+ * @param b
+ * @return
+ */
+static int compare_ping_run(const void *a, const void *b) {
+    const struct ping_run *x = a;
+    const struct ping_run *y = b;
+    double kx = x->steady ? x->stats[PING_P50] : x->first_ok ? x->first_ms : INFINITY;
+    double ky = y->steady ? y->stats[PING_P50] : y->first_ok ? y->first_ms : INFINITY;
+
+    return kx < ky ? -1 : kx > ky;
+}
+
+/**
+ * static void neuron_ping_samples(struct satnow_cli_args *request, const char *target, int count, long interval_ms)
+ * Ping the specified neuron, or every registered neuron concurrently, count
+ * times and print latency statistics sorted by steady state median
+ * @param request
+ * @param target host, nickname or all
+ * @param count
+ * @param interval_ms
+ */
+static void neuron_ping_samples(struct satnow_cli_args *request, const char *target, int count, long interval_ms) {
+    struct ping_fleet fleet = { request, NULL, 0, count, interval_ms, PTHREAD_MUTEX_INITIALIZER, { 0 } };
+    struct repository_entry *list = satnow_repository_entry_list();
+    int all = !strcasecmp(target, "all");
+    char tbuf[BUFFER_SIZE];
+
+    fleet.runs = calloc(repository_entry_count(list) + 1, sizeof(*fleet.runs));
+    for (struct repository_entry *current = list; fleet.runs && current; current = current->next) {
+        struct neuron_session *session = repository_entry_session(current);
+
+        if (!session || (!all && strcasecmp(session->host, target) && (!session->nickname || strcasecmp(session->nickname, target)))) {
+            neuron_session_free(session);
+            continue;
+        }
+        session->client_fd = request->fd;
+        fleet.runs[fleet.neurons].session = session;
+        fleet.runs[fleet.neurons].samples = calloc(count, sizeof(double));
+        if (!fleet.runs[fleet.neurons].samples) {
+            neuron_session_free(session);
+            break;
+        }
+        fleet.neurons++;
+        if (!all) {
+            break;
+        }
+    }
+    satnow_repository_entry_list_free(list);
+    rows_begin(&fleet.rows, request, NULL);
+
+    if (!fleet.neurons) {
+        snprintf(tbuf, sizeof(tbuf), "No registered neuron matches '%s'\n", target);
+        rows_error(&fleet.rows, tbuf);
+    } else {
+        rows_printf(&fleet.rows, "Pinging %d neuron%s, %d sample%s every %ld ms\n\n"
+            , fleet.neurons, fleet.neurons == 1 ? "" : "s", count, count == 1 ? "" : "s", interval_ms);
+        satnow_cli_flush(request->fd);
+
+        satnow_fanout(fleet.neurons, fleet.neurons, ping_run_neuron, &fleet);
+        qsort(fleet.runs, fleet.neurons, sizeof(*fleet.runs), compare_ping_run);
+
+        rows_printf(&fleet.rows, "\n%-24s %5s %5s %5s %10s %9s %9s %9s %9s %9s %9s\n"
+            , "NEURON", "SENT", "RECV", "LOSS", "FIRST MS", "MIN", "AVG", "P50", "P99", "MAX", "STDDEV");
+        for (int i = 0; i < fleet.neurons; i++) {
+            static const char *stat_names[] = { "min_ms", "avg_ms", "p50_ms", "p99_ms", "max_ms", "stddev_ms" };
+            struct ping_run *run = &fleet.runs[i];
+            char first[16] = "-";
+
+            if (run->first_ok) {
+                snprintf(first, sizeof(first), "%.3f%s", run->first_ms, run->first_connects > 0 ? "*" : "");
+            }
+            row_begin(&fleet.rows, "summary");
+            row_string(&fleet.rows, "neuron", "%-24s", run->session->nickname ? run->session->nickname : run->session->host);
+            row_long(&fleet.rows, "sent", " %5ld", run->sent);
+            row_long(&fleet.rows, "received", " %5ld", run->received);
+            row_double(&fleet.rows, "loss_percent", " %4.0f%%", run->sent ? 100.0 * (run->sent - run->received) / run->sent : 0.0);
+            row_double(&fleet.rows, "first_ms", NULL, run->first_ok ? run->first_ms : NAN);
+            row_bool(&fleet.rows, "first_new_connection", NULL, run->first_ok ? run->first_connects > 0 : -1);
+            row_text(&fleet.rows, " %10s", first);
+            for (int stat = PING_MIN; stat <= PING_STDDEV; stat++) {
+                row_double(&fleet.rows, stat_names[stat], run->steady ? " %9.3f" : NULL, run->steady ? run->stats[stat] : NAN);
+                if (!run->steady) {
+                    row_text(&fleet.rows, " %9s", "-");
+                }
+            }
+            row_end(&fleet.rows);
+        }
+        rows_printf(&fleet.rows, "\nTimes are in milliseconds. MIN to STDDEV cover the samples after the first; * marks a first request that opened a new connection.\n");
+    }
+    rows_end(&fleet.rows);
+
+    for (int i = 0; i < fleet.neurons; i++) {
+        free(fleet.runs[i].samples);
+        neuron_session_free(fleet.runs[i].session);
+    }
+    free(fleet.runs);
+    pthread_mutex_destroy(&fleet.send_mutex);
+
+    send_done(request);
+}
+
+/**
+ * One line of a vault batch file
+ */
+struct vault_batch_job {
+    char *neuron;
+    char *amount;           /** NULL to sweep the whole vault */
+    char *wallet;
+    struct neuron_session *session;
+    const char *error;
+    double ms;
+};
+
+struct vault_batch {
+    struct satnow_cli_args *request;
+    int fd;
+    pthread_mutex_t send_mutex;     /** jobs report from several threads */
+    struct vault_batch_job jobs[VAULT_BATCH_MAX_JOBS];
+    int count;
+    int submitted;
+    struct cli_rows rows;
+};
+
+/**
+ * static int vault_batch_load(struct vault_batch *batch, const char *path, char *error, size_t error_len)
+ * Read the jobs of a batch file. Each line holds a neuron, an amount or
+ * 'sweep', and a destination wallet. Blank lines and lines starting with #
+ * are ignored.
+ * @param batch
+ * @param path
+ * @param error
+ * @param error_len
+ * @return 0 on success
+ */
+static int vault_batch_load(struct vault_batch *batch, const char *path, char *error, size_t error_len) {
+    char line[BUFFER_SIZE];
+    int line_no = 0;
+    FILE *fp = fopen(path, "r");
+
+    if (!fp) {
+        snprintf(error, error_len, "Unable to open %s\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *neuron, *amount, *wallet, *save = NULL;
+        char *end = NULL;
+
+        line_no++;
+        neuron = strtok_r(line, " \t\r\n", &save);
+        if (!neuron || neuron[0] == '#') {
+            continue;
+        }
+        amount = strtok_r(NULL, " \t\r\n", &save);
+        wallet = strtok_r(NULL, " \t\r\n", &save);
+        if (!amount || !wallet || strtok_r(NULL, " \t\r\n", &save)) {
+            snprintf(error, error_len, "%s:%d: expected <neuron> (<amount> | sweep) <wallet-address>\n", path, line_no);
+            fclose(fp);
+            return -1;
+        }
+        if (strcasecmp(amount, "sweep") && (strtod(amount, &end) <= 0 || *end != '\0')) {
+            snprintf(error, error_len, "%s:%d: invalid amount '%s'\n", path, line_no, amount);
+            fclose(fp);
+            return -1;
+        }
+        if (batch->count == VAULT_BATCH_MAX_JOBS) {
+            snprintf(error, error_len, "%s: more than %d jobs\n", path, VAULT_BATCH_MAX_JOBS);
+            fclose(fp);
+            return -1;
+        }
+
+        batch->jobs[batch->count].neuron = strdup(neuron);
+        batch->jobs[batch->count].amount = strcasecmp(amount, "sweep") ? strdup(amount) : NULL;
+        batch->jobs[batch->count].wallet = strdup(wallet);
+        batch->count++;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * static void vault_batch_run(int index, void *context)
+ * Unlock, open, decrypt and transfer from one neuron's vault, then report
+ * @param index
+ * @param context
+ */
+static void vault_batch_run(int index, void *context) {
+    struct vault_batch *batch = context;
+    struct vault_batch_job *job = &batch->jobs[index];
+    struct timespec start, end;
+
+    /** Transfers still queued when the client hangs up are not started */
+    if (satnow_cli_cancelled(batch->request)) {
+        job->error = "cancelled";
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    job->session->client_fd = batch->fd;
+
+    if (satnow_http_neuron_unlock(job->session)
+        || satnow_http_neuron_vault(job->session)
+        || satnow_http_neuron_decrypt_vault(job->session)) {
+        job->error = "unable to open vault";
+    } else if (satnow_http_neuron_wait_vault_ready(job->session)) {
+        job->error = "vault not decrypted";
+    } else if (satnow_http_neuron_vault_transfer(job->session, job->amount, job->wallet, job->amount == NULL)) {
+        job->error = "transfer failed";
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->ms = time_diff_ms(start, end);
+
+    pthread_mutex_lock(&batch->send_mutex);
+    if (!job->error) {
+        batch->submitted++;
+    }
+    row_begin(&batch->rows, "transfer");
+    row_string(&batch->rows, "neuron", "%-20s", job->neuron);
+    row_string(&batch->rows, "amount", NULL, job->amount);
+    row_text(&batch->rows, " %12s", job->amount ? job->amount : "sweep");
+    row_string(&batch->rows, "wallet", "  %-36s", job->wallet);
+    row_string(&batch->rows, "status", " %-22s", job->error ? job->error : "submitted");
+    row_double(&batch->rows, "ms", " %8.0f ms", job->ms);
+    row_end(&batch->rows);
+    satnow_cli_flush(batch->fd);
+    pthread_mutex_unlock(&batch->send_mutex);
+}
+
+/**
+ * static void vault_batch_job(struct satnow_cli_args *request)
+ * Run a vault batch file. Runs on its own thread.
+ * @param request
+ */
+static void vault_batch_job(struct satnow_cli_args *request) {
+    struct vault_batch *batch = calloc(1, sizeof(*batch));
+    struct repository_entry *list = NULL;
+    struct timespec start, end;
+    char tbuf[BUFFER_SIZE];
+    long concurrency = VAULT_BATCH_CONCURRENCY;
+    int ready = TRUE;
+
+    if (!batch) {
+        satnow_cli_send_response(request->fd, CLI_DONE, "Out of memory\n");
+        return;
+    }
+    batch->request = request;
+    batch->fd = request->fd;
+    pthread_mutex_init(&batch->send_mutex, NULL);
+    rows_begin(&batch->rows, request, NULL);
+
+    if (request->argc == 6) {
+        concurrency = strtol(request->argv[5], NULL, 10);
+        if (concurrency < 1 || concurrency > VAULT_BATCH_MAX_CONCURRENCY) {
+            snprintf(tbuf, sizeof(tbuf), "Concurrency must be between 1 and %d\n", VAULT_BATCH_MAX_CONCURRENCY);
+            rows_error(&batch->rows, tbuf);
+            ready = FALSE;
+        }
+    }
+
+    if (ready && vault_batch_load(batch, request->argv[3], tbuf, sizeof(tbuf))) {
+        rows_error(&batch->rows, tbuf);
+        ready = FALSE;
+    }
+
+    if (ready) {
+        list = satnow_repository_entry_list();
+        for (int i = 0; i < batch->count; i++) {
+            batch->jobs[i].session = repository_session(list, batch->jobs[i].neuron);
+            if (!batch->jobs[i].session) {
+                snprintf(tbuf, sizeof(tbuf), "Neuron '%s' is not registered\n", batch->jobs[i].neuron);
+                rows_error(&batch->rows, tbuf);
+                ready = FALSE;
+            }
+        }
+        if (list) {
+            satnow_repository_entry_list_free(list);
+        }
+    }
+
+    if (ready && batch->count == 0) {
+        send_note(request, "Nothing to transfer\n");
+        ready = FALSE;
+    }
+
+    if (ready) {
+        snprintf(tbuf, sizeof(tbuf), "Transfer from %d neuron vaults, %ld at a time. Proceed [Y/N]:", batch->count, concurrency);
+        ready = cli_confirm(request->fd, tbuf);
+        if (!ready) {
+            send_note(request, "Batch cancelled\n");
+        }
+    }
+
+    if (ready) {
+        rows_printf(&batch->rows, "%-20s %12s  %-36s %-22s %11s\n", "NEURON", "AMOUNT", "WALLET", "STATUS", "TIME");
+        satnow_cli_flush(request->fd);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        satnow_fanout(batch->count, (int)concurrency, vault_batch_run, batch);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        row_begin(&batch->rows, "summary");
+        row_long(&batch->rows, "submitted", "%ld", batch->submitted);
+        row_long(&batch->rows, "transfers", " of %ld transfers submitted in ", batch->count);
+        row_double(&batch->rows, "ms", "%.0f ms", time_diff_ms(start, end));
+        row_end(&batch->rows);
+    }
+    rows_end(&batch->rows);
+
+    for (int i = 0; i < batch->count; i++) {
+        free(batch->jobs[i].neuron);
+        free(batch->jobs[i].amount);
+        free(batch->jobs[i].wallet);
+        neuron_session_free(batch->jobs[i].session);
+    }
+    pthread_mutex_destroy(&batch->send_mutex);
+    free(batch);
+
+    send_done(request);
+}
+
+static char *cli_neuron_vault_batch(struct satnow_cli_args *request) {
+    if (!satnow_repository_password_valid()) {
+        satnow_cli_request_repository_password(request->fd);
+    }
+
+    /** neuron vault batch <file> [concurrency <n>] */
+    if ((request->argc != 4 && request->argc != 6)
+        || (request->argc == 6 && strcasecmp(request->argv[4], "concurrency"))) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    if (satnow_cli_detach(request, vault_batch_job)) {
+        vault_batch_job(request);
+    }
+    return 0;
+}
+
+static char *cli_neuron_vault_transfer(struct satnow_cli_args *request) {
+    if (!satnow_repository_password_valid()) {
+        satnow_cli_request_repository_password(request->fd);
+    }
+
+    for (int i = 0; i < request->argc; i++) {
+        printf("ARG[%d]: %s\n", i, request->argv[i]);
+    }
+
+    /** neuron vault transfer <amount> satori <wallet-address> ( <host:ip> | <nickname> ) */
+    if (request->argc != 7) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    if (satnow_cli_detach(request, vault_transfer_job)) {
+        vault_transfer_job(request);
+    }
     return 0;
 }
\ No newline at end of file
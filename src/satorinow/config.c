@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <satorinow.h>
+#include "satorinow/cli.h"
+#include "satorinow/config.h"
+
+#ifdef __DEBUG__
+#pragma message ("SATORINOW DEBUG: CONFIG")
+#endif
+
+struct satnow_config_setting {
+    const char *name;
+    const char *description;
+    long value;
+    long min;
+    long max;
+};
+
+/**
+ * Indexed by enum satnow_config_key
+ */
+static struct satnow_config_setting settings[CONFIG_MAX] = {
+    [CONFIG_HTTP_CONNECT_TIMEOUT_MS] = {
+        "http_connect_timeout_ms", "Neuron TCP connect timeout", 5000, 100, 60000
+    },
+    [CONFIG_HTTP_MIN_DEADLINE_MS] = {
+        "http_min_deadline_ms", "Lower bound of the adaptive per-request deadline", 2000, 100, 600000
+    },
+    [CONFIG_HTTP_MAX_DEADLINE_MS] = {
+        "http_max_deadline_ms", "Upper bound of the adaptive per-request deadline", 30000, 100, 600000
+    },
+    [CONFIG_HTTP_RETRIES] = {
+        "http_retries", "Retries for failed idempotent neuron requests", 2, 0, 10
+    },
+    [CONFIG_HTTP_BACKOFF_MS] = {
+        "http_backoff_ms", "Base of the jittered exponential retry backoff", 200, 0, 60000
+    },
+    [CONFIG_HTTP_HEDGE] = {
+        "http_hedge", "Send a second GET once a request passes its p95 (0/1)", 0, 0, 1
+    },
+    [CONFIG_BREAKER_FAILURES] = {
+        "breaker_failures", "Consecutive failures that open a neuron's circuit breaker (0 disables)", 3, 0, 100
+    },
+    [CONFIG_BREAKER_OPEN_MS] = {
+        "breaker_open_ms", "Time an open circuit breaker fails fast before probing the neuron", 30000, 1000, 3600000
+    },
+    [CONFIG_VAULT_READY_TIMEOUT_MS] = {
+        "vault_ready_timeout_ms", "Time a vault transfer waits for the neuron to decrypt its vault", 60000, 1000, 600000
+    },
+    [CONFIG_RESPONSE_CACHE_MS] = {
+        "response_cache_ms", "Time read-only neuron responses are reused (0 disables)", 0, 0, 3600000
+    },
+    [CONFIG_RESPONSE_REVALIDATE] = {
+        "response_revalidate", "Keep the last read-only neuron responses to revalidate them even without response_cache_ms (0/1)", 0, 0, 1
+    },
+    [CONFIG_RESPONSE_CACHE_BYTES] = {
+        "response_cache_bytes", "Memory kept read-only responses and the tables rendered from them may hold, the oldest go first", 16777216, 0, 4294967296
+    },
+    [CONFIG_PREFETCH] = {
+        "prefetch", "Endpoints fetched in the background after an unlock, a sum of prefetch bits (0 disables)", 0, 0, 63
+    },
+    [CONFIG_PREFETCH_RATE] = {
+        "prefetch_rate", "Background prefetch requests started per second", 4, 1, 100
+    },
+    [CONFIG_RESPONSE_MEMORY_BYTES] = {
+        "response_memory_bytes", "Largest neuron response held in memory, larger ones spill to a temp file", 4194304, 4096, 1073741824
+    },
+    [CONFIG_RESPONSE_BUDGET_BYTES] = {
+        "response_budget_bytes", "Memory all neuron responses in flight may hold before new ones spill", 67108864, 65536, 4294967296
+    },
+    [CONFIG_RESPONSE_SPILL_BYTES] = {
+        "response_spill_bytes", "Largest neuron response accepted, spilled or not", 268435456, 4096, 17179869184
+    },
+    [CONFIG_TLS_PIN] = {
+        "tls_pin", "Pin the public key an https neuron presents on first contact (0/1)", 1, 0, 1
+    },
+    [CONFIG_TLS_VERIFY_CA] = {
+        "tls_verify_ca", "Also require https neuron certificates to be signed by a trusted CA (0/1)", 0, 0, 1
+    },
+    [CONFIG_CLI_MAX_CLIENTS] = {
+        "cli_max_clients", "CLI clients served at once, later ones wait to be accepted", 16, 1, 1024
+    },
+};
+
+static char *cli_config_set(struct satnow_cli_args *request);
+static char *cli_config_show(struct satnow_cli_args *request);
+
+static struct satnow_cli_op config_cli_operations[] = {
+    {
+        { "config", "set", NULL }
+        , "Change a runtime setting"
+        , "Usage: config set <setting> <value>"
+        , 0
+        , 0
+        , 0
+        , cli_config_set
+        , 0
+    },
+    {
+        { "config", "show", NULL }
+        , "Display the runtime settings"
+        , "Usage: config show"
+        , 0
+        , 0
+        , 0
+        , cli_config_show
+        , 0
+    },
+};
+
+/**
+ * int satnow_register_config_cli_operations()
+ * Register the config CLI operations
+ * @return
+ */
+int satnow_register_config_cli_operations() {
+    for (int i = 0; i < (int)(sizeof(config_cli_operations) / sizeof(config_cli_operations[0])); i++) {
+        for (int j = 0; j < SATNOW_CLI_MAX_COMMAND_WORDS; j++) {
+            if (config_cli_operations[i].command[j] == NULL) {
+                break;
+            }
+            printf(" %s", config_cli_operations[i].command[j]);
+        }
+        printf("\n");
+        satnow_cli_register(&config_cli_operations[i]);
+    }
+    return 0;
+}
+
+/**
+ * long satnow_config_get(enum satnow_config_key key)
+ * Return the current value of the specified setting
+ * @param key
+ * @return
+ */
+long satnow_config_get(enum satnow_config_key key) {
+    if (key < 0 || key >= CONFIG_MAX) {
+        return 0;
+    }
+    return __atomic_load_n(&settings[key].value, __ATOMIC_RELAXED);
+}
+
+/**
+ * void satnow_config_set(enum satnow_config_key key, long value)
+ * Set the specified setting, clamped to its permitted range
+ * @param key
+ * @param value
+ */
+void satnow_config_set(enum satnow_config_key key, long value) {
+    if (key < 0 || key >= CONFIG_MAX) {
+        return;
+    }
+    if (value < settings[key].min) {
+        value = settings[key].min;
+    }
+    if (value > settings[key].max) {
+        value = settings[key].max;
+    }
+    __atomic_store_n(&settings[key].value, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * static char *cli_config_show(struct satnow_cli_args *request)
+ * Display the runtime settings to the CLI client
+ * @param request
+ * @return
+ */
+static char *cli_config_show(struct satnow_cli_args *request) {
+    char tbuf[BUFFER_SIZE];
+
+    snprintf(tbuf, sizeof(tbuf), "%-28s %10s  %s\n", "SETTING", "VALUE", "DESCRIPTION");
+    satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+
+    for (int i = 0; i < CONFIG_MAX; i++) {
+        snprintf(tbuf, sizeof(tbuf), "%-28s %10ld  %s [%ld..%ld]\n"
+            , settings[i].name
+            , satnow_config_get(i)
+            , settings[i].description
+            , settings[i].min
+            , settings[i].max);
+        satnow_cli_send_response(request->fd, CLI_MORE, tbuf);
+    }
+
+    satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+    return 0;
+}
+
+/**
+ * static char *cli_config_set(struct satnow_cli_args *request)
+ * Change a runtime setting
+ * @param request
+ * @return
+ */
+static char *cli_config_set(struct satnow_cli_args *request) {
+    char tbuf[BUFFER_SIZE];
+    char *end = NULL;
+    long value;
+
+    /** config set <setting> <value> */
+    if (request->argc != 4) {
+        satnow_cli_send_response(request->fd, CLI_MORE, request->ref->syntax);
+        satnow_cli_send_response(request->fd, CLI_DONE, "\n");
+        return 0;
+    }
+
+    errno = 0;
+    value = strtol(request->argv[3], &end, 10);
+    if (errno || end == request->argv[3] || *end != '\0') {
+        snprintf(tbuf, sizeof(tbuf), "Invalid value '%s'\n", request->argv[3]);
+        satnow_cli_send_response(request->fd, CLI_DONE, tbuf);
+        return 0;
+    }
+
+    for (int i = 0; i < CONFIG_MAX; i++) {
+        if (!strcasecmp(settings[i].name, request->argv[2])) {
+            satnow_config_set(i, value);
+            snprintf(tbuf, sizeof(tbuf), "%s = %ld\n", settings[i].name, satnow_config_get(i));
+            satnow_cli_send_response(request->fd, CLI_DONE, tbuf);
+            return 0;
+        }
+    }
+
+    snprintf(tbuf, sizeof(tbuf), "Unknown setting '%s'\n", request->argv[2]);
+    satnow_cli_send_response(request->fd, CLI_DONE, tbuf);
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <satorinow.h>
+#include "satorinow/event.h"
+
+#define EVENT_BATCH 32
+
+static int epoll_fd = -1;
+static struct satnow_event stop_event = { .fd = -1 };
+static volatile int stopping = 0;
+
+/**
+ * static void event_stop_read(struct satnow_event *event, uint32_t events)
+ * Drain the stop eventfd
+ * @param event
+ * @param events
+ */
+static void event_stop_read(struct satnow_event *event, uint32_t events) {
+    uint64_t count;
+
+    (void)events;
+    if (read(event->fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        perror("satnow_event stop read");
+    }
+}
+
+/**
+ * int satnow_event_init()
+ * Create the event loop. Call before anything registers an event.
+ * @return 0 on success, -1 on failure
+ */
+int satnow_event_init() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    stop_event.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_event.fd == -1) {
+        perror("eventfd");
+        close(epoll_fd);
+        epoll_fd = -1;
+        return -1;
+    }
+    stop_event.callback = event_stop_read;
+
+    return satnow_event_add(&stop_event, EPOLLIN);
+}
+
+/**
+ * void satnow_event_shutdown()
+ * Release the event loop
+ */
+void satnow_event_shutdown() {
+    if (stop_event.fd != -1) {
+        close(stop_event.fd);
+        stop_event.fd = -1;
+    }
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+/**
+ * void satnow_event_run()
+ * Wait for and dispatch events until satnow_event_stop() is called
+ */
+void satnow_event_run() {
+    struct epoll_event ready[EVENT_BATCH];
+
+    while (!stopping) {
+        int n = epoll_wait(epoll_fd, ready, EVENT_BATCH, -1);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct satnow_event *event = ready[i].data.ptr;
+
+            event->callback(event, ready[i].events);
+        }
+    }
+}
+
+/**
+ * void satnow_event_stop()
+ * Make satnow_event_run() return. Safe to call from any thread.
+ */
+void satnow_event_stop() {
+    uint64_t one = 1;
+
+    stopping = TRUE;
+    if (stop_event.fd != -1 && write(stop_event.fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        perror("satnow_event stop write");
+    }
+}
+
+/**
+ * static int event_ctl(int op, struct satnow_event *event, uint32_t events)
+ * Apply a registration change to the epoll set
+ * @param op
+ * @param event
+ * @param events
+ * @return 0 on success, -1 on failure
+ */
+static int event_ctl(int op, struct satnow_event *event, uint32_t events) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = event;
+    if (epoll_ctl(epoll_fd, op, event->fd, &ev) == -1) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * int satnow_event_add(struct satnow_event *event, uint32_t events)
+ * Watch the event's descriptor for the given epoll events
+ * @param event
+ * @param events
+ * @return 0 on success, -1 on failure
+ */
+int satnow_event_add(struct satnow_event *event, uint32_t events) {
+    return event_ctl(EPOLL_CTL_ADD, event, events);
+}
+
+/**
+ * int satnow_event_modify(struct satnow_event *event, uint32_t events)
+ * Change the epoll events watched for, 0 pauses the event
+ * @param event
+ * @param events
+ * @return 0 on success, -1 on failure
+ */
+int satnow_event_modify(struct satnow_event *event, uint32_t events) {
+    return event_ctl(EPOLL_CTL_MOD, event, events);
+}
+
+/**
+ * int satnow_event_remove(struct satnow_event *event)
+ * Stop watching the event's descriptor
+ * @param event
+ * @return 0 on success, -1 on failure
+ */
+int satnow_event_remove(struct satnow_event *event) {
+    return event_ctl(EPOLL_CTL_DEL, event, 0);
+}
+
+/**
+ * static void timer_expired(struct satnow_event *event, uint32_t events)
+ * Acknowledge the timerfd and run the timer's callback
+ * @param event
+ * @param events
+ */
+static void timer_expired(struct satnow_event *event, uint32_t events) {
+    struct satnow_timer *timer = event->context;
+    uint64_t expirations;
+
+    (void)events;
+    /** Nothing to read when the timer was re-armed since it fired */
+    if (read(event->fd, &expirations, sizeof(expirations)) == -1) {
+        return;
+    }
+    timer->callback(timer->context);
+}
+
+/**
+ * int satnow_timer_init(struct satnow_timer *timer, void (*callback)(void *context), void *context)
+ * Create a disarmed timer and add it to the event loop
+ * @param timer
+ * @param callback
+ * @param context
+ * @return 0 on success, -1 on failure
+ */
+int satnow_timer_init(struct satnow_timer *timer, void (*callback)(void *context), void *context) {
+    timer->callback = callback;
+    timer->context = context;
+    timer->event.callback = timer_expired;
+    timer->event.context = timer;
+    timer->event.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer->event.fd == -1) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    if (satnow_event_add(&timer->event, EPOLLIN) == -1) {
+        close(timer->event.fd);
+        timer->event.fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * void satnow_timer_arm(struct satnow_timer *timer, long ms)
+ * Fire the timer once, ms from now. Re-arming replaces the pending expiry,
+ * 0 disarms the timer.
+ * @param timer
+ * @param ms
+ */
+void satnow_timer_arm(struct satnow_timer *timer, long ms) {
+    struct itimerspec when;
+
+    if (timer->event.fd == -1) {
+        return;
+    }
+
+    memset(&when, 0, sizeof(when));
+    when.it_value.tv_sec = ms / 1000;
+    when.it_value.tv_nsec = (ms % 1000) * 1000000L;
+    if (timerfd_settime(timer->event.fd, 0, &when, NULL) == -1) {
+        perror("timerfd_settime");
+    }
+}
+
+/**
+ * void satnow_timer_close(struct satnow_timer *timer)
+ * Remove the timer from the event loop and release it
+ * @param timer
+ */
+void satnow_timer_close(struct satnow_timer *timer) {
+    if (timer->event.fd == -1) {
+        return;
+    }
+    satnow_event_remove(&timer->event);
+    close(timer->event.fd);
+    timer->event.fd = -1;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <satorinow.h>
+#include "satorinow/fanout.h"
+
+#ifdef __DEBUG__
+#pragma message ("SATORINOW DEBUG: FANOUT")
+#endif
+
+/** Upper bound on the threads a single fan-out may start */
+#define FANOUT_MAX_THREADS 64
+
+struct fanout {
+    int count;
+    int next;
+    void (*fn)(int index, void *context);
+    void *context;
+};
+
+/**
+ * static void *fanout_worker(void *arg)
+ * Take the next index until all have been handed out
+ * @param arg
+ * @return
+ */
+static void *fanout_worker(void *arg) {
+    struct fanout *f = arg;
+    int index;
+
+    while ((index = __atomic_fetch_add(&f->next, 1, __ATOMIC_RELAXED)) < f->count) {
+        f->fn(index, f->context);
+    }
+    return NULL;
+}
+
+/**
+ * void satnow_fanout(int count, int concurrency, void (*fn)(int index, void *context), void *context)
+ * Run fn(index, context) for every index in [0, count) on at most
+ * concurrency threads and return once all of them have finished
+ * @param count
+ * @param concurrency
+ * @param fn
+ * @param context
+ */
+void satnow_fanout(int count, int concurrency, void (*fn)(int index, void *context), void *context) {
+    pthread_t threads[FANOUT_MAX_THREADS];
+    struct fanout f = { count, 0, fn, context };
+    int started = 0;
+
+    if (concurrency > count) {
+        concurrency = count;
+    }
+    if (concurrency > FANOUT_MAX_THREADS) {
+        concurrency = FANOUT_MAX_THREADS;
+    }
+
+    for (int i = 0; i < concurrency; i++) {
+        if (pthread_create(&threads[started], NULL, fanout_worker, &f) != 0) {
+            perror("satnow_fanout pthread_create");
+            break;
+        }
+        started++;
+    }
+
+    /** Without any helper thread the caller does the work itself */
+    if (started == 0) {
+        fanout_worker(&f);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
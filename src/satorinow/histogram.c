@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <satorinow.h>
+#include "satorinow/histogram.h"
+
+#ifdef __DEBUG__
+#pragma message ("SATORINOW DEBUG: HISTOGRAM")
+#endif
+
+/**
+ * static int histogram_index(uint64_t value)
+ * Map a value to its bucket
+ * @param value
+ * @return
+ */
+static int histogram_index(uint64_t value) {
+    int exponent;
+    int index;
+
+    if (value < HISTOGRAM_LINEAR_MAX) {
+        return (int)value;
+    }
+    exponent = 63 - __builtin_clzll(value);
+    index = HISTOGRAM_LINEAR_MAX
+        + (exponent - HISTOGRAM_SUB_BITS - 1) * HISTOGRAM_SUB_BUCKETS
+        + (int)((value >> (exponent - HISTOGRAM_SUB_BITS)) - HISTOGRAM_SUB_BUCKETS);
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * static uint64_t histogram_highest(int index)
+ * Return the largest value that maps to the bucket
+ * @param index
+ * @return
+ */
+static uint64_t histogram_highest(int index) {
+    int exponent;
+    uint64_t mantissa;
+
+    if (index < HISTOGRAM_LINEAR_MAX) {
+        return (uint64_t)index;
+    }
+    exponent = HISTOGRAM_SUB_BITS + 1 + (index - HISTOGRAM_LINEAR_MAX) / HISTOGRAM_SUB_BUCKETS;
+    mantissa = HISTOGRAM_SUB_BUCKETS + (index - HISTOGRAM_LINEAR_MAX) % HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << (exponent - HISTOGRAM_SUB_BITS)) - 1;
+}
+
+/**
+ * void satnow_histogram_record(struct satnow_histogram *h, uint64_t value)
+ * Record one value
+ * @param h
+ * @param value
+ */
+void satnow_histogram_record(struct satnow_histogram *h, uint64_t value) {
+    uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&h->counts[histogram_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+    while (value > max && !__atomic_compare_exchange_n(&h->max, &max, value, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * uint64_t satnow_histogram_percentile(struct satnow_histogram *h, double percentile)
+ * Return the value at or below which the given percentage of the recorded
+ * values fall
+ * @param h
+ * @param percentile
+ * @return
+ */
+uint64_t satnow_histogram_percentile(struct satnow_histogram *h, double percentile) {
+    unsigned long counts[HISTOGRAM_BUCKETS];
+    unsigned long total = 0;
+    unsigned long target;
+    unsigned long seen = 0;
+    uint64_t max = satnow_histogram_max(h);
+
+    /** Work from one snapshot so concurrent recording cannot skew the walk */
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counts[i] = __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+        total += counts[i];
+    }
+    if (!total) {
+        return 0;
+    }
+
+    target = (unsigned long)(percentile / 100.0 * total + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            uint64_t highest = histogram_highest(i);
+            return highest < max ? highest : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * unsigned long satnow_histogram_count(struct satnow_histogram *h)
+ * Return the number of recorded values
+ * @param h
+ * @return
+ */
+unsigned long satnow_histogram_count(struct satnow_histogram *h) {
+    return __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+}
+
+/**
+ * uint64_t satnow_histogram_max(struct satnow_histogram *h)
+ * Return the largest recorded value
+ * @param h
+ * @return
+ */
+uint64_t satnow_histogram_max(struct satnow_histogram *h) {
+    return __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+}
+
+/**
+ * double satnow_histogram_mean(struct satnow_histogram *h)
+ * Return the mean of the recorded values
+ * @param h
+ * @return
+ */
+double satnow_histogram_mean(struct satnow_histogram *h) {
+    unsigned long count = satnow_histogram_count(h);
+
+    return count ? (double)__atomic_load_n(&h->sum, __ATOMIC_RELAXED) / count : 0.0;
+}
+
+/**
+ * void satnow_histogram_reset(struct satnow_histogram *h)
+ * Forget every recorded value
+ * @param h
+ */
+void satnow_histogram_reset(struct satnow_histogram *h) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        __atomic_store_n(&h->counts[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
@@ -20,52 +20,659 @@
  * THE SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
 #include <satorinow.h>
+#include "satorinow/config.h"
 #include "satorinow/http/http_neuron.h"
+#include "satorinow/http/http_neuron_host.h"
 #include "satorinow/cli.h"
 #include "satorinow/cli/cli_satori.h"
 #include "satorinow/repository.h"
 #include "satorinow/json.h"
 
-static void extract_csrf_token(struct neuron_session *data);
+/** Endpoint flags */
+#define HTTP_IDEMPOTENT     0x01    /** safe to retry and hedge */
+#define HTTP_DISCARD        0x02    /** response body is not kept */
+#define HTTP_AUTH           0x04    /** send the session cookie */
+#define HTTP_CSRF           0x08    /** scan for the CSRF token, stop once it is found */
+#define HTTP_UNESCAPE       0x10    /** response is an escaped JSON string */
+#define HTTP_SESSION_COOKIE 0x20    /** capture the session cookie the neuron sets */
+#define HTTP_VAULT_READY    0x40    /** scan for the decrypted vault's transfer form, stop once it is found */
+#define HTTP_SAMPLE         0x80    /** latency sample: one attempt, no retries or hedging */
+#define HTTP_CACHEABLE      0x100   /** read-only, may be answered from the response cache */
+#define HTTP_PREFETCH       0x200   /** background prefetch into the response cache */
+
+/** Background prefetch workers and queue bound */
+#define PREFETCH_WORKERS    2
+#define PREFETCH_QUEUE_MAX  256
+/** How often a waiting prefetch checks for interactive requests and its rate slot */
+#define PREFETCH_POLL_MS    50
+
+/** Granularity of the cancellation and hedging checks while a transfer runs */
+#define HTTP_POLL_INTERVAL_MS 100
+
+/** Backoff bounds while waiting for a vault to decrypt */
+#define VAULT_READY_POLL_MS     250
+#define VAULT_READY_POLL_MAX_MS 2000
 
 /**
- * static void extract_csrf_token(struct neuron_session *data)
- * Extract the CSRF token from the neuron_session contents
- * @param data
+ * The vault page only carries the transfer form once the vault is decrypted,
+ * so its action doubles as the readiness signal
  */
-static void extract_csrf_token(struct neuron_session *data) {
-    if (data) {
-        char *token = strstr(data->buffer, "name=\"csrf_token\"");
+#define VAULT_READY_MARKER "send_satori_transaction_from_vault"
 
-        if (token) {
-            char *value_attr = strstr(token += strlen("name=\"csrf_token\""), "value=\"");
+#define CSRF_TOKEN_MAX 256
 
-            if (value_attr) {
-                char *end = NULL;
+/** Longest ETag or Last-Modified value kept for conditional requests */
+#define HTTP_VALIDATOR_MAX 256
 
-                value_attr += strlen("value=\"");
-                end = strstr(value_attr, "\"");
+enum csrf_phase {
+    CSRF_NAME = 0,      /** looking for the csrf_token name attribute */
+    CSRF_VALUE,         /** looking for the value attribute that follows it */
+    CSRF_TOKEN,         /** copying the token up to the closing quote */
+    CSRF_DONE,
+};
 
-                if (data->csrf_token) {
-                    free(data->csrf_token);
-                    data->csrf_token = NULL;
-                }
+/**
+ * Incremental CSRF token scanner fed from the write callback, so the token
+ * is found without buffering the page and the transfer stops right after it
+ */
+struct csrf_scanner {
+    enum csrf_phase phase;
+    size_t matched;     /** bytes of the current attribute pattern matched so far */
+    size_t token_len;
+    char token[CSRF_TOKEN_MAX];
+};
+
+static const char *csrf_patterns[] = {
+    [CSRF_NAME] = "name=\"csrf_token\"",
+    [CSRF_VALUE] = "value=\"",
+};
+
+/**
+ * One transfer of a request. The primary attempt writes straight into the
+ * session buffer, a hedged attempt collects its body privately until it wins.
+ */
+struct neuron_attempt {
+    struct neuron_session *session;
+    CURL *curl;
+    char *buffer;
+    size_t buffer_len;
+    size_t decoded;     /** body bytes delivered after content decoding */
+    int escaped;        /** passthrough: the last chunk ended in a backslash not yet forwarded */
+    int hedged;
+    int stopped;        /** a scanner found what it wanted and ended the transfer */
+    int drain;          /** read on to the end after a scanner matched, keeping the connection */
+    struct csrf_scanner csrf;
+    size_t ready_matched;
+};
+
+/**
+ * What neuron_transfer() learned about the winning transfer
+ */
+struct neuron_transfer_info {
+    long status;
+    double total_ms;
+    long connects;          /** new connections opened */
+    long redirects;         /** redirects followed, a login page when the session is not valid */
+    curl_off_t namelookup_us;       /** these four count from the start of the transfer */
+    curl_off_t connect_us;
+    curl_off_t appconnect_us;
+    curl_off_t starttransfer_us;
+    curl_off_t total_us;
+    curl_off_t wire_bytes;  /** body bytes received, before content decoding */
+    size_t decoded_bytes;   /** body bytes after content decoding */
+    int stopped;
+    char etag[HTTP_VALIDATOR_MAX];          /** validators of the response, empty when absent */
+    char last_modified[HTTP_VALIDATOR_MAX];
+    char pin[NEURON_PIN_MAX];               /** public key of a new https connection, when certificate info was requested */
+};
+
+/**
+ * How each neuron endpoint is requested and how its response is handled
+ */
+struct neuron_endpoint_desc {
+    const char *method;
+    const char *path;
+    const char *content_type;
+    int flags;
+};
+
+static const struct neuron_endpoint_desc endpoints[NEURON_ENDPOINT_MAX] = {
+    [NEURON_ENDPOINT_UNLOCK] = { "POST", "/unlock", "application/x-www-form-urlencoded", HTTP_SESSION_COOKIE | HTTP_CSRF },
+    [NEURON_ENDPOINT_MINING_TO_ADDRESS] = { "GET", "/mining/to/address", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CACHEABLE },
+    [NEURON_ENDPOINT_POOL_PARTICIPANTS] = { "GET", "/pool/participants", "application/json", HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CACHEABLE | HTTP_UNESCAPE },
+    [NEURON_ENDPOINT_PROXY_PARENT_STATUS] = { "GET", "/proxy/parent/status", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CACHEABLE },
+    [NEURON_ENDPOINT_DELEGATE] = { "GET", "/delegate/get", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CACHEABLE },
+    [NEURON_ENDPOINT_SYSTEM_METRICS] = { "GET", "/system_metrics", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CACHEABLE },
+    [NEURON_ENDPOINT_PING] = { "GET", "/ping", "application/json", HTTP_IDEMPOTENT },
+    [NEURON_ENDPOINT_STATS] = { "GET", "/fetch/wallet/stats/daily", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CACHEABLE },
+    [NEURON_ENDPOINT_VAULT] = { "GET", "/vault", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_CSRF },
+    [NEURON_ENDPOINT_VAULT_TRANSFER] = { "POST", "/send_satori_transaction_from_vault/main", NULL, HTTP_AUTH },
+    [NEURON_ENDPOINT_DECRYPT_VAULT] = { "POST", "/decrypt/vault", "application/json", HTTP_AUTH },
+    [NEURON_ENDPOINT_VAULT_STATE] = { "GET", "/vault", NULL, HTTP_IDEMPOTENT | HTTP_AUTH | HTTP_VAULT_READY },
+};
 
-                data->csrf_token = calloc(1, end - value_attr);
-                strncpy(data->csrf_token, value_attr, end - value_attr);
+/**
+ * Process-wide DNS, TLS session and connection caches. Every easy handle is
+ * attached to it so CLI worker threads reuse each other's warm state.
+ */
+static CURLSH *share = NULL;
+static pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+
+/** Neuron requests in flight on behalf of CLI clients */
+static int interactive_requests = 0;
+
+/**
+ * Response memory accounting, updated with atomics from every request thread
+ */
+static struct {
+    long in_use;            /** heap bytes of session buffers, charged as they grow */
+    long peak;
+    long spilled;           /** bytes in spill files */
+    unsigned long spills;
+    unsigned long rejected;
+} memory;
+
+/**
+ * Neuron work given up because the CLI client hung up, updated with atomics
+ */
+static struct {
+    unsigned long aborted;          /** transfers stopped while running */
+    unsigned long skipped;          /** requests and retries never sent */
+    unsigned long wasted_bytes;     /** body bytes received by the aborted transfers */
+} cancellation;
+
+/**
+ * Prefetch setting bits and the read-only endpoint each one fetches
+ */
+static const struct {
+    long bit;
+    enum neuron_endpoint endpoint;
+} prefetch_bits[] = {
+    { 0x01, NEURON_ENDPOINT_MINING_TO_ADDRESS },
+    { 0x02, NEURON_ENDPOINT_DELEGATE },
+    { 0x04, NEURON_ENDPOINT_STATS },
+    { 0x08, NEURON_ENDPOINT_SYSTEM_METRICS },
+    { 0x10, NEURON_ENDPOINT_POOL_PARTICIPANTS },
+    { 0x20, NEURON_ENDPOINT_PROXY_PARENT_STATUS },
+};
+
+struct prefetch_job {
+    struct neuron_session session;      /** host and session cookie of the unlock */
+    enum neuron_endpoint endpoint;
+    struct prefetch_job *next;
+};
+
+/**
+ * Background prefetch queue, drained by up to PREFETCH_WORKERS threads that
+ * start with the first queued job
+ */
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t workers[PREFETCH_WORKERS];
+    int started;
+    int stopping;
+    struct prefetch_job *head;
+    struct prefetch_job *tail;
+    struct prefetch_job *active[PREFETCH_WORKERS];
+    int queued;
+    struct timespec last_start;
+    unsigned long completed;
+    unsigned long skipped;
+    unsigned long cancelled;
+} prefetch = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    pthread_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+    (void)handle;
+    (void)userptr;
+    pthread_mutex_unlock(&share_locks[data]);
+}
+
+/**
+ * int satnow_http_neuron_init()
+ * Create the shared curl caches. Call after curl_global_init() and before
+ * any neuron request is made.
+ * @return
+ */
+int satnow_http_neuron_init() {
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&share_locks[i], NULL);
+    }
+
+    share = curl_share_init();
+    if (!share) {
+        fprintf(stderr, "curl_share_init() failed, neuron requests will not share caches\n");
+        return -1;
+    }
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    return 0;
+}
+
+/**
+ * void satnow_http_neuron_shutdown()
+ * Stop the prefetch workers and release the shared curl caches. No other
+ * neuron request may be running.
+ */
+void satnow_http_neuron_shutdown() {
+    pthread_mutex_lock(&prefetch.mutex);
+    prefetch.stopping = TRUE;
+    pthread_mutex_unlock(&prefetch.mutex);
+    satnow_http_neuron_prefetch_cancel();
+    for (int i = 0; i < prefetch.started; i++) {
+        pthread_join(prefetch.workers[i], NULL);
+    }
+    prefetch.started = 0;
+
+    if (share) {
+        curl_share_cleanup(share);
+        share = NULL;
+    }
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&share_locks[i]);
+    }
+}
+
+/**
+ * const char *satnow_http_neuron_endpoint_name(enum neuron_endpoint endpoint)
+ * Return the path of the specified endpoint
+ * @param endpoint
+ * @return
+ */
+const char *satnow_http_neuron_endpoint_name(enum neuron_endpoint endpoint) {
+    if (endpoint >= NEURON_ENDPOINT_MAX) {
+        return "?";
+    }
+    return endpoints[endpoint].path;
+}
+
+/**
+ * static size_t pattern_step(const char *pattern, size_t matched, char c)
+ * Advance a partial match of the pattern by one byte, falling back to the
+ * longest matched suffix that is also a prefix when the byte does not fit
+ * @param pattern
+ * @param matched
+ * @param c
+ * @return number of pattern bytes matched after c
+ */
+static size_t pattern_step(const char *pattern, size_t matched, char c) {
+    while (pattern[matched] != c) {
+        size_t k;
+
+        if (matched == 0) {
+            return 0;
+        }
+        for (k = matched - 1; k > 0 && memcmp(pattern, pattern + matched - k, k); k--);
+        matched = k;
+    }
+    return matched + 1;
+}
+
+/**
+ * static const char *pattern_scan(const char *pattern, size_t *matched, const char *p, const char *end)
+ * Continue matching the pattern over the next chunk of a stream. memchr()
+ * skips ahead to candidate bytes, which glibc vectorises.
+ * @param pattern
+ * @param matched partial match carried between chunks
+ * @param p
+ * @param end
+ * @return the byte after the match, or NULL if the chunk ended first
+ */
+static const char *pattern_scan(const char *pattern, size_t *matched, const char *p, const char *end) {
+    while (p < end) {
+        if (*matched == 0) {
+            p = memchr(p, pattern[0], end - p);
+            if (!p) {
+                return NULL;
             }
         }
+        *matched = pattern_step(pattern, *matched, *p++);
+        if (pattern[*matched] == '\0') {
+            *matched = 0;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * static int csrf_scan(struct csrf_scanner *scan, const char *p, size_t len)
+ * Feed the next chunk of the response to the CSRF token scanner
+ * @param scan
+ * @param p
+ * @param len
+ * @return TRUE once the token has been captured
+ */
+static int csrf_scan(struct csrf_scanner *scan, const char *p, size_t len) {
+    const char *end = p + len;
+
+    while (p < end && scan->phase != CSRF_DONE) {
+        if (scan->phase == CSRF_TOKEN) {
+            const char *quote = memchr(p, '"', end - p);
+            size_t n = (quote ? quote : end) - p;
+
+            if (scan->token_len + n >= CSRF_TOKEN_MAX) {
+                /** Not a token we could use, look for another */
+                scan->phase = CSRF_NAME;
+                scan->token_len = 0;
+                continue;
+            }
+            memcpy(scan->token + scan->token_len, p, n);
+            scan->token_len += n;
+            p += n;
+            if (quote) {
+                scan->token[scan->token_len] = '\0';
+                scan->phase = CSRF_DONE;
+            }
+            continue;
+        }
+
+        p = pattern_scan(csrf_patterns[scan->phase], &scan->matched, p, end);
+        if (!p) {
+            break;
+        }
+        scan->phase++;
+    }
+
+    return scan->phase == CSRF_DONE;
+}
+
+/**
+ * static int buffer_append(char **buffer, size_t *buffer_len, const void *contents, size_t size)
+ * Grow the NUL terminated buffer by the specified contents
+ * @param buffer
+ * @param buffer_len
+ * @param contents
+ * @param size
+ * @return
+ */
+static int buffer_append(char **buffer, size_t *buffer_len, const void *contents, size_t size) {
+    char *ptr = realloc(*buffer, *buffer_len + size + 1);
+    if (ptr == NULL) {
+        fprintf(stderr, "realloc() failed\n");
+        return -1;
+    }
+
+    *buffer = ptr;
+    memcpy(&((*buffer)[*buffer_len]), contents, size);
+    *buffer_len += size;
+    (*buffer)[*buffer_len] = '\0';
+
+    return 0;
+}
+
+/**
+ * static int memory_charge(long bytes, int force)
+ * Count bytes of response buffers against the in-flight budget
+ * @param bytes
+ * @param force charge even past the budget
+ * @return FALSE when the budget does not have room
+ */
+static int memory_charge(long bytes, int force) {
+    long used = __atomic_add_fetch(&memory.in_use, bytes, __ATOMIC_RELAXED);
+    long peak = __atomic_load_n(&memory.peak, __ATOMIC_RELAXED);
+
+    if (!force && used > satnow_config_get(CONFIG_RESPONSE_BUDGET_BYTES)) {
+        __atomic_sub_fetch(&memory.in_use, bytes, __ATOMIC_RELAXED);
+        return FALSE;
+    }
+    while (used > peak && !__atomic_compare_exchange_n(&memory.peak, &peak, used, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return TRUE;
+}
+
+/**
+ * static int spill_open()
+ * Open an unnamed temp file for a response that outgrew memory
+ * @return the descriptor, or -1
+ */
+static int spill_open() {
+    const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char path[PATH_MAX];
+    int fd;
+
+    fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    /** Filesystems without O_TMPFILE: create and unlink right away */
+    snprintf(path, sizeof(path), "%s/satorinow-XXXXXX", dir);
+    fd = mkostemp(path, O_CLOEXEC);
+    if (fd >= 0) {
+        unlink(path);
+    } else {
+        perror("spill temp file");
+    }
+    return fd;
+}
+
+/**
+ * static void session_unmap(struct neuron_session *session)
+ * Drop the mapping of a spilled response so the file can grow
+ * @param session
+ */
+static void session_unmap(struct neuron_session *session) {
+    if (session->mapped_len) {
+        munmap(session->buffer, session->mapped_len);
+        session->buffer = NULL;
+        session->mapped_len = 0;
+    }
+}
+
+/**
+ * static int session_spill(struct neuron_session *session)
+ * Move the response collected so far to a temp file and release its memory
+ * @param session
+ * @return
+ */
+static int session_spill(struct neuron_session *session) {
+    int fd = spill_open();
+
+    if (fd < 0) {
+        return -1;
+    }
+    for (size_t done = 0; done < session->buffer_len; ) {
+        ssize_t n = write(fd, session->buffer + done, session->buffer_len - done);
+
+        if (n < 0) {
+            perror("spill write");
+            close(fd);
+            return -1;
+        }
+        done += n;
     }
+
+    printf("%s response passed %zu bytes in memory, spilling to a temp file\n", session->host, session->buffer_len);
+    free(session->buffer);
+    session->buffer = NULL;
+    __atomic_sub_fetch(&memory.in_use, (long)session->buffer_charged, __ATOMIC_RELAXED);
+    session->buffer_charged = 0;
+    __atomic_add_fetch(&memory.spilled, (long)session->buffer_len, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&memory.spills, 1, __ATOMIC_RELAXED);
+    session->spill_fd = fd;
+    session->spilled = TRUE;
+
+    return 0;
 }
 
+/**
+ * static int session_append(struct neuron_session *session, const void *contents, size_t size)
+ * Grow the session's response by the specified contents, in memory while
+ * it is under response_memory_bytes and the budget has room, in its spill
+ * file after that
+ * @param session
+ * @param contents
+ * @param size
+ * @return
+ */
+static int session_append(struct neuron_session *session, const void *contents, size_t size) {
+    size_t need = session->buffer_len + size;
+
+    if (!session->spilled) {
+        long grow = need > session->buffer_charged ? (long)(need - session->buffer_charged) : 0;
+
+        if (need <= (size_t)satnow_config_get(CONFIG_RESPONSE_MEMORY_BYTES) && memory_charge(grow, FALSE)) {
+            session->buffer_charged += grow;
+            return buffer_append(&session->buffer, &session->buffer_len, contents, size);
+        }
+        if (session_spill(session)) {
+            return -1;
+        }
+    }
+
+    if (need > (size_t)satnow_config_get(CONFIG_RESPONSE_SPILL_BYTES)) {
+        printf("%s response passed %zu bytes, abandoning it\n", session->host, need);
+        __atomic_add_fetch(&memory.rejected, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    session_unmap(session);
+    for (size_t done = 0; done < size; ) {
+        ssize_t n = pwrite(session->spill_fd, (const char *)contents + done, size - done, session->buffer_len + done);
+
+        if (n < 0) {
+            perror("spill write");
+            return -1;
+        }
+        done += n;
+    }
+    session->buffer_len = need;
+    __atomic_add_fetch(&memory.spilled, (long)size, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * static void session_truncate(struct neuron_session *session, size_t len)
+ * Drop the end of the session's response, keeping the first len bytes
+ * @param session
+ * @param len
+ */
+static void session_truncate(struct neuron_session *session, size_t len) {
+    if (len >= session->buffer_len) {
+        return;
+    }
+    if (session->spilled) {
+        session_unmap(session);
+        if (ftruncate(session->spill_fd, len)) {
+            perror("spill truncate");
+        }
+        __atomic_sub_fetch(&memory.spilled, (long)(session->buffer_len - len), __ATOMIC_RELAXED);
+    } else if (session->buffer) {
+        session->buffer[len] = '\0';
+    }
+    session->buffer_len = len;
+}
+
+/**
+ * static int session_map(struct neuron_session *session)
+ * Make a spilled response readable through session->buffer like one held
+ * in memory. The file gains a NUL so the mapping is a C string.
+ * @param session
+ * @return
+ */
+static int session_map(struct neuron_session *session) {
+    void *map;
+
+    if (!session->spilled || session->mapped_len) {
+        return 0;
+    }
+    if (ftruncate(session->spill_fd, session->buffer_len + 1)) {
+        perror("spill truncate");
+        return -1;
+    }
+    /** Private and writable, so callers may modify the buffer without touching the file */
+    map = mmap(NULL, session->buffer_len + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, session->spill_fd, 0);
+    if (map == MAP_FAILED) {
+        perror("spill mmap");
+        return -1;
+    }
+    session->buffer = map;
+    session->mapped_len = session->buffer_len + 1;
+
+    return 0;
+}
+
+/**
+ * void satnow_http_neuron_buffer_free(struct neuron_session *session)
+ * Release the session's response, whether it is held in memory or spilled
+ * @param session
+ */
+void satnow_http_neuron_buffer_free(struct neuron_session *session) {
+    if (session->spilled) {
+        session_unmap(session);
+        close(session->spill_fd);
+        __atomic_sub_fetch(&memory.spilled, (long)session->buffer_len, __ATOMIC_RELAXED);
+        session->spilled = FALSE;
+        session->spill_fd = -1;
+    }
+    free(session->buffer);
+    __atomic_sub_fetch(&memory.in_use, (long)session->buffer_charged, __ATOMIC_RELAXED);
+    session->buffer = NULL;
+    session->buffer_len = 0;
+    session->buffer_charged = 0;
+}
+
+/**
+ * void satnow_http_neuron_memory_stats(struct neuron_memory_stats *stats)
+ * Report the memory held by neuron responses
+ * @param stats
+ */
+void satnow_http_neuron_memory_stats(struct neuron_memory_stats *stats) {
+    stats->budget = satnow_config_get(CONFIG_RESPONSE_BUDGET_BYTES);
+    stats->in_use = __atomic_load_n(&memory.in_use, __ATOMIC_RELAXED);
+    stats->peak = __atomic_load_n(&memory.peak, __ATOMIC_RELAXED);
+    stats->spilled = __atomic_load_n(&memory.spilled, __ATOMIC_RELAXED);
+    stats->spills = __atomic_load_n(&memory.spills, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&memory.rejected, __ATOMIC_RELAXED);
+    stats->kept = satnow_neuron_host_cache_bytes();
+    stats->kept_max = satnow_config_get(CONFIG_RESPONSE_CACHE_BYTES);
+}
+
+/**
+ * void satnow_http_neuron_cancel_stats(struct neuron_cancel_stats *stats)
+ * Report the neuron work given up because CLI clients hung up
+ * @param stats
+ */
+void satnow_http_neuron_cancel_stats(struct neuron_cancel_stats *stats) {
+    stats->aborted = __atomic_load_n(&cancellation.aborted, __ATOMIC_RELAXED);
+    stats->skipped = __atomic_load_n(&cancellation.skipped, __ATOMIC_RELAXED);
+    stats->wasted_bytes = __atomic_load_n(&cancellation.wasted_bytes, __ATOMIC_RELAXED);
+}
 
 /**
  * size_t write_callback(void *contents, size_t size, size_t nmemb, void *context)
@@ -73,261 +680,1262 @@ static void extract_csrf_token(struct neuron_session *data) {
  */
 size_t write_callback(void *contents, size_t size, size_t nmemb, void *context) {
     size_t total_size = size * nmemb;
-    struct neuron_session *data = (struct neuron_session *)context;
+    struct neuron_attempt *attempt = (struct neuron_attempt *)context;
+    struct neuron_session *data = attempt->session;
+
+    attempt->decoded += total_size;
+    if (attempt->hedged) {
+        /** A hedge never spills, past the memory cap it gives up and leaves the race to the primary */
+        if (attempt->buffer_len + total_size > (size_t)satnow_config_get(CONFIG_RESPONSE_MEMORY_BYTES)) {
+            return 0;
+        }
+        return buffer_append(&attempt->buffer, &attempt->buffer_len, contents, total_size) ? 0 : total_size;
+    }
+
     printf("write_callback() increasing buffer [%ld] by [%ld]\n", data->buffer_len, total_size);
+    return session_append(data, contents, total_size) ? 0 : total_size;
+}
 
-    /** Reallocate buffer to fit the new data */
-    char *ptr = realloc(data->buffer, data->buffer_len + total_size + 1);
-    if (ptr == NULL) {
-        fprintf(stderr, "realloc() failed\n");
-        return 0;
+/**
+ * static int passthrough_open(struct neuron_attempt *attempt)
+ * Decide whether the body arriving may go straight to the CLI client. Only
+ * the body of a successful, unredirected response is forwarded, anything
+ * else is kept for the request to deal with as usual.
+ * @param attempt
+ * @return
+ */
+static int passthrough_open(struct neuron_attempt *attempt) {
+    long status = 0;
+    long redirects = 0;
+
+    if (attempt->session->forwarded) {
+        return TRUE;
     }
+    curl_easy_getinfo(attempt->curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(attempt->curl, CURLINFO_REDIRECT_COUNT, &redirects);
+    return status >= 200 && status < 300 && !redirects;
+}
 
-    data->buffer = ptr;
-    memcpy(&(data->buffer[data->buffer_len]), contents, total_size);
-    data->buffer_len += total_size;
-    data->buffer[data->buffer_len] = '\0';
+/**
+ * static void passthrough_forward(struct neuron_session *session, const char *data, size_t len)
+ * Send part of a response body to the CLI client as a CLI_MORE message
+ * @param session
+ * @param data
+ * @param len
+ */
+static void passthrough_forward(struct neuron_session *session, const char *data, size_t len) {
+    satnow_cli_send_data(session->client_fd, CLI_MORE, data, len);
+    session->forwarded += len;
+}
+
+/**
+ * static size_t passthrough_callback(void *contents, size_t size, size_t nmemb, void *context)
+ * HTTP write callback that forwards the body to the CLI client from
+ * libcurl's own buffer, one message per chunk
+ */
+static size_t passthrough_callback(void *contents, size_t size, size_t nmemb, void *context) {
+    struct neuron_attempt *attempt = (struct neuron_attempt *)context;
+    size_t total_size = size * nmemb;
 
+    if (!passthrough_open(attempt)) {
+        return write_callback(contents, size, nmemb, context);
+    }
+    attempt->decoded += total_size;
+    passthrough_forward(attempt->session, contents, total_size);
     return total_size;
 }
 
 /**
- * int satnow_http_neuron_unlock(struct neuron_session *session)
- * Unlock the neuron and grab the session cookie
- * @param data
+ * Unescaped body bytes on their way to the CLI client
  */
-int satnow_http_neuron_unlock(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    char cookie_file[PATH_MAX];
+struct passthrough_out {
+    struct neuron_session *session;
+    size_t len;
+    char data[4096];
+};
+
+/**
+ * static void passthrough_put(struct passthrough_out *out, char c)
+ * Add a byte to the outgoing body, forwarding what is held once it is full
+ * @param out
+ * @param c
+ */
+static void passthrough_put(struct passthrough_out *out, char c) {
+    if (out->len == sizeof(out->data)) {
+        passthrough_forward(out->session, out->data, out->len);
+        out->len = 0;
+    }
+    out->data[out->len++] = c;
+}
+
+/**
+ * static size_t passthrough_unescape_callback(void *contents, size_t size, size_t nmemb, void *context)
+ * HTTP write callback that forwards an escaped JSON string body to the CLI
+ * client, unescaping it the way satnow_json_string_unescape() would on the
+ * way through a small fixed buffer
+ */
+static size_t passthrough_unescape_callback(void *contents, size_t size, size_t nmemb, void *context) {
+    struct neuron_attempt *attempt = (struct neuron_attempt *)context;
+    size_t total_size = size * nmemb;
+    const char *p = contents;
+    const char *end = p + total_size;
+    struct passthrough_out out;
+
+    if (!passthrough_open(attempt)) {
+        return write_callback(contents, size, nmemb, context);
+    }
+    attempt->decoded += total_size;
+    out.session = attempt->session;
+    out.len = 0;
+
+    for (; p < end; p++) {
+        if (attempt->escaped) {
+            /** Only the backslash of \" is dropped */
+            attempt->escaped = FALSE;
+            if (*p != '"') {
+                passthrough_put(&out, '\\');
+            }
+        }
+        if (*p == '\\') {
+            attempt->escaped = TRUE;
+            continue;
+        }
+        passthrough_put(&out, *p);
+    }
+    if (out.len) {
+        passthrough_forward(attempt->session, out.data, out.len);
+    }
+
+    return total_size;
+}
+
+/**
+ * static size_t discard_callback(void *contents, size_t size, size_t nmemb, void *context)
+ * HTTP write callback for responses whose body is not needed
+ */
+static size_t discard_callback(void *contents, size_t size, size_t nmemb, void *context) {
+    struct neuron_attempt *attempt = (struct neuron_attempt *)context;
+
+    (void)contents;
+    attempt->decoded += size * nmemb;
+    return size * nmemb;
+}
+
+/**
+ * static size_t csrf_callback(void *contents, size_t size, size_t nmemb, void *context)
+ * HTTP write callback for pages carrying a CSRF token. The body is not kept
+ * and the transfer is stopped as soon as the token has been read.
+ */
+static size_t csrf_callback(void *contents, size_t size, size_t nmemb, void *context) {
+    struct neuron_attempt *attempt = (struct neuron_attempt *)context;
+
+    attempt->decoded += size * nmemb;
+    if (attempt->stopped) {
+        return size * nmemb;
+    }
+    if (csrf_scan(&attempt->csrf, contents, size * nmemb)) {
+        attempt->stopped = TRUE;
+        return attempt->drain ? size * nmemb : 0;
+    }
+    return size * nmemb;
+}
+
+/**
+ * static size_t vault_ready_callback(void *contents, size_t size, size_t nmemb, void *context)
+ * HTTP write callback that looks for the decrypted vault's transfer form.
+ * The body is not kept and the transfer is stopped once the form is seen.
+ */
+static size_t vault_ready_callback(void *contents, size_t size, size_t nmemb, void *context) {
+    struct neuron_attempt *attempt = (struct neuron_attempt *)context;
+    const char *p = contents;
+
+    attempt->decoded += size * nmemb;
+    if (attempt->stopped) {
+        return size * nmemb;
+    }
+    if (pattern_scan(VAULT_READY_MARKER, &attempt->ready_matched, p, p + size * nmemb)) {
+        attempt->stopped = TRUE;
+        return attempt->drain ? size * nmemb : 0;
+    }
+    return size * nmemb;
+}
+
+/**
+ * static int neuron_cancelled(struct neuron_session *session)
+ * Check whether the CLI client that requested the work has hung up. Once a
+ * session is cancelled every further request on it fails immediately.
+ * @param session
+ * @return
+ */
+static int neuron_cancelled(struct neuron_session *session) {
+    if (__atomic_load_n(&session->cancelled, __ATOMIC_RELAXED)) {
+        return TRUE;
+    }
+
+    if (satnow_cli_hungup(session->client_fd)) {
+        printf("CLI client hung up, cancelling requests to %s\n", session->host);
+        __atomic_store_n(&session->cancelled, TRUE, __ATOMIC_RELAXED);
+    }
+
+    return __atomic_load_n(&session->cancelled, __ATOMIC_RELAXED);
+}
+
+/**
+ * static long elapsed_ms(const struct timespec *start)
+ * Milliseconds since the specified CLOCK_MONOTONIC time
+ * @param start
+ * @return
+ */
+static long elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/**
+ * static void response_header(CURL *curl, const char *name, char *value, size_t value_len)
+ * Copy a header of the final response of a transfer, after any redirects
+ * @param curl
+ * @param name
+ * @param value receives the header, empty when the response did not have it
+ * @param value_len
+ */
+static void response_header(CURL *curl, const char *name, char *value, size_t value_len) {
+    struct curl_header *header = NULL;
+
+    value[0] = '\0';
+    if (curl_easy_header(curl, name, 0, CURLH_HEADER, -1, &header) == CURLHE_OK && header->value) {
+        snprintf(value, value_len, "%s", header->value);
+    }
+}
+
+/**
+ * static void certificate_pin(CURL *curl, char *pin, size_t pin_len)
+ * Compute the curl public key pin, "sha256//" and the base64 SHA-256 of the
+ * DER SubjectPublicKeyInfo, of the server certificate a transfer received
+ * @param curl
+ * @param pin receives the pin, empty when the transfer has no certificate info
+ * @param pin_len
+ */
+static void certificate_pin(CURL *curl, char *pin, size_t pin_len) {
+    struct curl_certinfo *certinfo = NULL;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    unsigned char encoded[4 * ((SHA256_DIGEST_LENGTH + 2) / 3) + 1];
+    unsigned char *der = NULL;
+    X509 *cert = NULL;
+    int der_len;
+
+    pin[0] = '\0';
+    if (curl_easy_getinfo(curl, CURLINFO_CERTINFO, &certinfo) != CURLE_OK || !certinfo || certinfo->num_of_certs < 1) {
+        return;
+    }
+
+    /** The first certificate is the server's own, its PEM is in the "Cert:" field */
+    for (struct curl_slist *field = certinfo->certinfo[0]; field && !cert; field = field->next) {
+        if (!strncmp(field->data, "Cert:", 5)) {
+            BIO *bio = BIO_new_mem_buf(field->data + 5, -1);
+
+            if (bio) {
+                cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+                BIO_free(bio);
+            }
+        }
+    }
+    if (!cert) {
+        return;
+    }
+
+    der_len = i2d_X509_PUBKEY(X509_get_X509_PUBKEY(cert), &der);
+    if (der_len > 0) {
+        SHA256(der, der_len, digest);
+        EVP_EncodeBlock(encoded, digest, sizeof(digest));
+        snprintf(pin, pin_len, "sha256//%s", encoded);
+    }
+    OPENSSL_free(der);
+    X509_free(cert);
+}
+
+/**
+ * static void neuron_tls_setup(CURL *curl, struct neuron_host *nh)
+ * Set how an https neuron is authenticated. Neurons usually present a
+ * self-signed certificate for a LAN address, so by default the host is
+ * trusted on first use: the public key it presents then is pinned and
+ * every later connection must present the same key. Pinned connections
+ * skip certificate info collection, and the shared TLS session cache lets
+ * them resume rather than repeat the full handshake.
+ * @param curl
+ * @param nh
+ */
+static void neuron_tls_setup(CURL *curl, struct neuron_host *nh) {
+    long verify_ca = satnow_config_get(CONFIG_TLS_VERIFY_CA);
+    char *pin;
+
+    if (!nh->tls) {
+        return;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, verify_ca);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, verify_ca ? 2L : 0L);
+
+    pin = satnow_neuron_host_pin_get(nh);
+    if (pin) {
+        curl_easy_setopt(curl, CURLOPT_PINNEDPUBLICKEY, pin);
+        curl_easy_setopt(curl, CURLOPT_CERTINFO, 0L);
+        free(pin);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_PINNEDPUBLICKEY, NULL);
+        curl_easy_setopt(curl, CURLOPT_CERTINFO, satnow_config_get(CONFIG_TLS_PIN) ? 1L : 0L);
+    }
+}
+
+/**
+ * static CURLcode neuron_transfer(CURL *curl, struct neuron_session *session, size_t base_len, long hedge_after_ms, int drain, struct neuron_transfer_info *info)
+ * Run one transfer of the prepared request. When hedge_after_ms is set and the
+ * request is still running after that long, an identical second request is
+ * raced against it and whichever completes successfully first is kept.
+ * @param curl
+ * @param session
+ * @param base_len session buffer length before the request started
+ * @param hedge_after_ms
+ * @param drain read past a scanner match rather than closing the connection
+ * @param info filled in from the winning transfer
+ * @return
+ */
+static CURLcode neuron_transfer(CURL *curl, struct neuron_session *session, size_t base_len, long hedge_after_ms, int drain, struct neuron_transfer_info *info) {
+    struct neuron_attempt primary = { .session = session, .curl = curl, .drain = drain };
+    struct neuron_attempt hedge = { .session = session, .hedged = TRUE, .drain = drain };
+    struct timespec start;
+    CURL *hedge_curl = NULL;
+    CURL *winner = NULL;
+    CURLcode result = CURLE_OK;
+    CURLM *multi;
+    int active = 0;
+
+    memset(info, 0, sizeof(*info));
+
+    multi = curl_multi_init();
+    if (!multi) {
+        return CURLE_OUT_OF_MEMORY;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&primary);
+    curl_multi_add_handle(multi, curl);
+    active++;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (!winner) {
+        CURLMsg *msg = NULL;
+        int running = 0;
+        int queued = 0;
+        long elapsed;
+        int timeout = HTTP_POLL_INTERVAL_MS;
+
+        curl_multi_perform(multi, &running);
+
+        while ((msg = curl_multi_info_read(multi, &queued))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            active--;
+            result = msg->data.result;
+            if (result == CURLE_WRITE_ERROR && (msg->easy_handle == curl ? &primary : &hedge)->stopped) {
+                /** A scanner ended the transfer on purpose */
+                result = CURLE_OK;
+            }
+            if (result == CURLE_OK || active == 0) {
+                winner = msg->easy_handle;
+                break;
+            }
+            /** One of the two racing attempts failed, keep waiting on the other */
+            curl_multi_remove_handle(multi, msg->easy_handle);
+        }
+
+        if (winner) {
+            break;
+        }
+
+        if (neuron_cancelled(session)) {
+            __atomic_add_fetch(&cancellation.aborted, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&cancellation.wasted_bytes, primary.decoded + hedge.decoded, __ATOMIC_RELAXED);
+            result = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+
+        elapsed = elapsed_ms(&start);
+        if (hedge_after_ms > 0 && !hedge_curl) {
+            if (elapsed >= hedge_after_ms) {
+                hedge_curl = curl_easy_duphandle(curl);
+                hedge.curl = hedge_curl;
+                if (hedge_curl) {
+                    printf("hedging request to %s after %ld ms\n", session->host, elapsed);
+                    curl_easy_setopt(hedge_curl, CURLOPT_WRITEDATA, (void *)&hedge);
+                    curl_multi_add_handle(multi, hedge_curl);
+                    active++;
+                }
+            } else if (hedge_after_ms - elapsed < timeout) {
+                timeout = (int)(hedge_after_ms - elapsed);
+            }
+        }
+
+        curl_multi_poll(multi, NULL, 0, timeout, NULL);
+    }
+
+    if (winner) {
+        curl_easy_getinfo(winner, CURLINFO_RESPONSE_CODE, &info->status);
+        curl_easy_getinfo(winner, CURLINFO_NAMELOOKUP_TIME_T, &info->namelookup_us);
+        curl_easy_getinfo(winner, CURLINFO_CONNECT_TIME_T, &info->connect_us);
+        curl_easy_getinfo(winner, CURLINFO_APPCONNECT_TIME_T, &info->appconnect_us);
+        curl_easy_getinfo(winner, CURLINFO_STARTTRANSFER_TIME_T, &info->starttransfer_us);
+        curl_easy_getinfo(winner, CURLINFO_TOTAL_TIME_T, &info->total_us);
+        curl_easy_getinfo(winner, CURLINFO_NUM_CONNECTS, &info->connects);
+        curl_easy_getinfo(winner, CURLINFO_REDIRECT_COUNT, &info->redirects);
+        curl_easy_getinfo(winner, CURLINFO_SIZE_DOWNLOAD_T, &info->wire_bytes);
+        info->total_ms = info->total_us / 1000.0;
+        info->decoded_bytes = winner == hedge_curl ? hedge.decoded : primary.decoded;
+        info->stopped = winner == hedge_curl ? hedge.stopped : primary.stopped;
+        response_header(winner, "ETag", info->etag, sizeof(info->etag));
+        response_header(winner, "Last-Modified", info->last_modified, sizeof(info->last_modified));
+        certificate_pin(winner, info->pin, sizeof(info->pin));
+
+        if (result == CURLE_OK && primary.escaped) {
+            /** The body ended in a lone backslash, which is kept */
+            passthrough_forward(session, "\\", 1);
+        }
+        if (result == CURLE_OK) {
+            struct csrf_scanner *csrf = winner == hedge_curl ? &hedge.csrf : &primary.csrf;
+
+            if (csrf->phase == CSRF_DONE) {
+                free(session->csrf_token);
+                session->csrf_token = strdup(csrf->token);
+            }
+        }
+    }
+
+    curl_multi_remove_handle(multi, curl);
+    if (hedge_curl) {
+        curl_multi_remove_handle(multi, hedge_curl);
+    }
+    curl_multi_cleanup(multi);
+
+    if (winner && winner == hedge_curl) {
+        /** Replace whatever the slower primary attempt wrote */
+        session_truncate(session, base_len);
+        if (hedge.buffer_len && session_append(session, hedge.buffer, hedge.buffer_len)) {
+            result = CURLE_OUT_OF_MEMORY;
+        }
+    }
+
+    if (hedge_curl) {
+        curl_easy_cleanup(hedge_curl);
+    }
+    free(hedge.buffer);
+
+    return result;
+}
+
+/**
+ * static int neuron_retryable(CURLcode result, long status, int flags)
+ * Decide whether a failed request may be sent again. Failures to connect are
+ * safe for any request because nothing reached the neuron, everything else is
+ * only retried for idempotent requests.
+ * @param result
+ * @param status
+ * @param flags
+ * @return
+ */
+static int neuron_retryable(CURLcode result, long status, int flags) {
+    switch (result) {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+            return TRUE;
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_PARTIAL_FILE:
+            return (flags & HTTP_IDEMPOTENT) != 0;
+        case CURLE_OK:
+            return (flags & HTTP_IDEMPOTENT) && (status == 502 || status == 503 || status == 504);
+        default:
+            return FALSE;
+    }
+}
+
+/**
+ * static int neuron_sleep(struct neuron_session *session, long ms)
+ * Wait for the specified time, returning early if the CLI client hangs up
+ * @param session
+ * @param ms
+ * @return TRUE if the session was cancelled
+ */
+static int neuron_sleep(struct neuron_session *session, long ms) {
+    struct pollfd pfd;
+
+    if (neuron_cancelled(session)) {
+        return TRUE;
+    }
+    if (session->client_fd <= 0) {
+        usleep(ms * 1000);
+        return FALSE;
+    }
+
+    pfd.fd = session->client_fd;
+    pfd.events = satnow_cli_hangup_events(session->client_fd);
+    pfd.revents = 0;
+    poll(&pfd, 1, (int)ms);
+    return neuron_cancelled(session);
+}
+
+/**
+ * static long backoff_ms(long attempt)
+ * Jittered exponential backoff before the specified retry
+ * @param attempt
+ * @return
+ */
+static long backoff_ms(long attempt) {
+    static __thread unsigned int seed = 0;
+    long cap = satnow_config_get(CONFIG_HTTP_BACKOFF_MS) << (attempt < 10 ? attempt : 10);
+
+    if (!seed) {
+        seed = (unsigned int)time(NULL) ^ (unsigned int)pthread_self();
+    }
+    if (cap <= 0) {
+        return 0;
+    }
+    /** half fixed, half random so retries from many sessions spread out */
+    return cap / 2 + rand_r(&seed) % (cap / 2 + 1);
+}
+
+/**
+ * static int neuron_probe(struct neuron_session *session, struct neuron_host *nh, char *error, size_t error_len)
+ * Send a single /ping to a neuron whose breaker is half-open. The probe is
+ * bounded by the connect timeout and is never retried.
+ * @param session
+ * @param nh
+ * @param error
+ * @param error_len
+ * @return
+ */
+static int neuron_probe(struct neuron_session *session, struct neuron_host *nh, char *error, size_t error_len) {
+    struct neuron_attempt attempt = { .session = session };
     CURL *curl;
     CURLcode result;
+    long status = 0;
+
+    curl = curl_easy_init();
+    if (!curl) {
+        snprintf(error, error_len, "curl_easy_init() failed");
+        return FALSE;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, nh->urls[NEURON_ENDPOINT_PING]);
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, satnow_config_get(CONFIG_HTTP_CONNECT_TIMEOUT_MS));
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, satnow_config_get(CONFIG_HTTP_CONNECT_TIMEOUT_MS));
+    neuron_tls_setup(curl, nh);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&attempt);
+
+    result = curl_easy_perform(curl);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_cleanup(curl);
+
+    if (result != CURLE_OK) {
+        snprintf(error, error_len, "probe: %s", curl_easy_strerror(result));
+        return FALSE;
+    }
+    if (status >= 500) {
+        snprintf(error, error_len, "probe: HTTP %ld", status);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * static void neuron_timing_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, const struct neuron_transfer_info *info)
+ * Split a completed transfer's cumulative curl timings into phases and
+ * record them in the endpoint's histograms
+ * @param nh
+ * @param endpoint
+ * @param info
+ */
+static void neuron_timing_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, const struct neuron_transfer_info *info) {
+    if (info->connects > 0) {
+        satnow_neuron_host_timing_sample(nh, endpoint, NEURON_TIMING_DNS, info->namelookup_us);
+        if (info->connect_us >= info->namelookup_us) {
+            satnow_neuron_host_timing_sample(nh, endpoint, NEURON_TIMING_CONNECT, info->connect_us - info->namelookup_us);
+        }
+        if (info->appconnect_us > 0 && info->appconnect_us >= info->connect_us) {
+            satnow_neuron_host_timing_sample(nh, endpoint, NEURON_TIMING_TLS, info->appconnect_us - info->connect_us);
+        }
+    }
+    if (info->starttransfer_us > 0) {
+        satnow_neuron_host_timing_sample(nh, endpoint, NEURON_TIMING_FIRST_BYTE, info->starttransfer_us);
+    }
+    satnow_neuron_host_timing_sample(nh, endpoint, NEURON_TIMING_TOTAL, info->total_us);
+    satnow_neuron_host_timing_sample(nh, endpoint, NEURON_TIMING_BYTES, info->wire_bytes);
+}
+
+/**
+ * static int neuron_admit(struct neuron_session *session, struct neuron_host *nh)
+ * Consult the neuron's circuit breaker, probing it when the breaker allows
+ * @param session
+ * @param nh
+ * @return
+ */
+static int neuron_admit(struct neuron_session *session, struct neuron_host *nh) {
+    char error[NEURON_ERROR_MAX];
+    int probe = FALSE;
+    int ok;
+
+    if (!satnow_neuron_host_admit(nh, &probe)) {
+        printf("%s skipped, circuit breaker open\n", session->host);
+        return FALSE;
+    }
+    if (!probe) {
+        return TRUE;
+    }
+
+    ok = neuron_probe(session, nh, error, sizeof(error));
+    satnow_neuron_host_probe_result(nh, ok, error);
+    return ok;
+}
+
+/**
+ * static int neuron_host_failed(CURLcode result, long status)
+ * Decide whether the outcome of a request counts against the neuron's
+ * circuit breaker. Cancellations and client errors do not. Handshake and
+ * pin failures do, since they repeat until the neuron or its pin changes.
+ * @param result
+ * @param status
+ * @return
+ */
+static int neuron_host_failed(CURLcode result, long status) {
+    switch (result) {
+        case CURLE_OK:
+            return status >= 500;
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_PEER_FAILED_VERIFICATION:
+        case CURLE_SSL_PINNEDPUBKEYNOTMATCH:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/**
+ * static CURLcode neuron_perform(CURL *curl, struct neuron_session *session, struct neuron_host *nh, enum neuron_endpoint endpoint, int flags, struct neuron_transfer_info *last)
+ * Perform the prepared request with a deadline derived from the endpoint's
+ * observed latency, retrying and hedging where the flags allow it.
+ * @param curl
+ * @param session
+ * @param nh
+ * @param endpoint
+ * @param flags the endpoint's flags and any the caller added
+ * @param last receives what was learned about the last attempt, may be NULL
+ * @return
+ */
+static CURLcode neuron_perform(CURL *curl, struct neuron_session *session, struct neuron_host *nh, enum neuron_endpoint endpoint, int flags, struct neuron_transfer_info *last) {
+    size_t base_len = session->buffer_len;
+    long retries = (flags & HTTP_SAMPLE) ? 0 : satnow_config_get(CONFIG_HTTP_RETRIES);
+    long hedge_after_ms = 0;
+    long status = 0;
+    CURLcode result = CURLE_OK;
+
+    if (neuron_cancelled(session)) {
+        __atomic_add_fetch(&cancellation.skipped, 1, __ATOMIC_RELAXED);
+        return CURLE_ABORTED_BY_CALLBACK;
+    }
+    if (!neuron_admit(session, nh)) {
+        return CURLE_COULDNT_CONNECT;
+    }
+
+    /** A forwarded body cannot be taken back, so a passthrough request is never hedged */
+    if ((flags & HTTP_IDEMPOTENT) && !(flags & HTTP_SAMPLE) && !session->passthrough && satnow_config_get(CONFIG_HTTP_HEDGE)) {
+        hedge_after_ms = satnow_neuron_host_p95_ms(nh, endpoint);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, satnow_config_get(CONFIG_HTTP_CONNECT_TIMEOUT_MS));
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, satnow_neuron_host_deadline_ms(nh, endpoint));
+    neuron_tls_setup(curl, nh);
+
+    /** Advertise every encoding libcurl was built with and decode while receiving */
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    if (flags & HTTP_CSRF) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, csrf_callback);
+    } else if (flags & HTTP_VAULT_READY) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, vault_ready_callback);
+    } else if (flags & HTTP_DISCARD) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_callback);
+    } else if (session->passthrough) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (flags & HTTP_UNESCAPE) ? passthrough_unescape_callback : passthrough_callback);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    }
+
+    for (long attempt = 0; ; attempt++) {
+        struct neuron_transfer_info info;
+        long wait_ms;
+
+        if (neuron_cancelled(session)) {
+            __atomic_add_fetch(&cancellation.skipped, 1, __ATOMIC_RELAXED);
+            return CURLE_ABORTED_BY_CALLBACK;
+        }
+
+        /**
+         * Stopping a scan early closes the connection. On https the rest of
+         * the page costs less to read than the next handshake would.
+         */
+        result = neuron_transfer(curl, session, base_len, hedge_after_ms, nh->tls, &info);
+        status = info.status;
+        if (last) {
+            *last = info;
+        }
+        if (result == CURLE_OK) {
+            satnow_neuron_host_latency_sample(nh, endpoint, info.total_ms);
+            satnow_neuron_host_connection_sample(nh, info.connects);
+            satnow_neuron_host_traffic_sample(nh, endpoint, (unsigned long)info.wire_bytes, info.decoded_bytes);
+            neuron_timing_sample(nh, endpoint, &info);
+            if (info.pin[0]) {
+                satnow_neuron_host_pin_learn(nh, info.pin);
+            }
+        }
+
+        if (attempt >= retries || session->forwarded || !neuron_retryable(result, status, flags)) {
+            break;
+        }
+
+        /** Drop the partial response before trying again */
+        session_truncate(session, base_len);
+
+        wait_ms = backoff_ms(attempt);
+        printf("%s%s failed (%s, HTTP %ld), retry %ld in %ld ms\n"
+            , session->host
+            , satnow_http_neuron_endpoint_name(endpoint)
+            , curl_easy_strerror(result)
+            , status
+            , attempt + 1
+            , wait_ms);
+
+        neuron_sleep(session, wait_ms);
+    }
+
+    if (neuron_host_failed(result, status)) {
+        char error[NEURON_ERROR_MAX];
+
+        if (result == CURLE_OK) {
+            snprintf(error, sizeof(error), "%s: HTTP %ld", satnow_http_neuron_endpoint_name(endpoint), status);
+        } else {
+            snprintf(error, sizeof(error), "%s: %s", satnow_http_neuron_endpoint_name(endpoint), curl_easy_strerror(result));
+        }
+        satnow_neuron_host_failure(nh, error);
+    } else if (result == CURLE_OK) {
+        satnow_neuron_host_success(nh);
+    }
+
+    return result;
+}
+
+/**
+ * static struct curl_slist *build_headers(enum neuron_endpoint endpoint, const char *session)
+ * Build the request header list of an endpoint for the specified session cookie
+ * @param endpoint
+ * @param session
+ * @return
+ */
+static struct curl_slist *build_headers(enum neuron_endpoint endpoint, const char *session) {
+    const struct neuron_endpoint_desc *desc = &endpoints[endpoint];
+    struct curl_slist *headers = NULL;
+    char tbuf[URL_DATA_MAX];
+
+    if (desc->content_type) {
+        snprintf(tbuf, sizeof(tbuf), "Content-Type: %s", desc->content_type);
+        headers = curl_slist_append(headers, tbuf);
+    }
+    if ((desc->flags & HTTP_AUTH) && session) {
+        snprintf(tbuf, sizeof(tbuf), "Cookie: session=%s", session);
+        headers = curl_slist_append(headers, tbuf);
+    }
+
+    return headers;
+}
+
+/**
+ * static void capture_session_cookie(CURL *curl, struct neuron_session *session)
+ * Keep the value of the session cookie the neuron set during the transfer
+ * @param curl
+ * @param session
+ */
+static void capture_session_cookie(CURL *curl, struct neuron_session *session) {
+    struct curl_slist *cookies = NULL;
+
+    if (curl_easy_getinfo(curl, CURLINFO_COOKIELIST, &cookies) != CURLE_OK) {
+        return;
+    }
+
+    /** Netscape format: domain, subdomains, path, secure, expiry, name, value */
+    for (struct curl_slist *c = cookies; c; c = c->next) {
+        char *field = c->data;
+
+        for (int i = 0; i < 5 && field; i++) {
+            field = strchr(field, '\t');
+            field = field ? field + 1 : NULL;
+        }
+        if (field && !strncmp(field, "session\t", strlen("session\t"))) {
+            if (session->session) {
+                free(session->session);
+            }
+            session->session = strdup(field + strlen("session\t"));
+            break;
+        }
+    }
+    curl_slist_free_all(cookies);
+}
+
+/**
+ * static struct curl_slist *conditional_headers(struct neuron_host *nh, enum neuron_endpoint endpoint, const struct curl_slist *base)
+ * Build the header list of a conditional request from the endpoint's
+ * header list and the validators of its cached response
+ * @param nh
+ * @param endpoint
+ * @param base the endpoint's usual header list, may be NULL
+ * @return the list, to be freed by the caller, or NULL when there is nothing to revalidate
+ */
+static struct curl_slist *conditional_headers(struct neuron_host *nh, enum neuron_endpoint endpoint, const struct curl_slist *base) {
+    char etag[HTTP_VALIDATOR_MAX];
+    char last_modified[HTTP_VALIDATOR_MAX];
+    char tbuf[URL_DATA_MAX];
+    struct curl_slist *headers = NULL;
+
+    if (!satnow_neuron_host_cache_validators(nh, endpoint, etag, sizeof(etag), last_modified, sizeof(last_modified))) {
+        return NULL;
+    }
+
+    for (const struct curl_slist *h = base; h; h = h->next) {
+        headers = curl_slist_append(headers, h->data);
+    }
+    /** If-None-Match takes precedence, so If-Modified-Since is only sent without an ETag */
+    if (etag[0]) {
+        snprintf(tbuf, sizeof(tbuf), "If-None-Match: %s", etag);
+    } else {
+        snprintf(tbuf, sizeof(tbuf), "If-Modified-Since: %s", last_modified);
+    }
+    headers = curl_slist_append(headers, tbuf);
+
+    return headers;
+}
+
+/**
+ * static void neuron_response_finish(struct neuron_session *session, const struct neuron_endpoint_desc *desc)
+ * Post-process a response body, whether it came from the network or the cache
+ * @param session
+ * @param desc
+ */
+static void neuron_response_finish(struct neuron_session *session, const struct neuron_endpoint_desc *desc) {
+    if ((desc->flags & HTTP_UNESCAPE) && session->buffer) {
+        char *unescaped = satnow_json_string_unescape(session->buffer);
+
+        satnow_http_neuron_buffer_free(session);
+        session->buffer = unescaped;
+        session->buffer_len = unescaped ? strlen(unescaped) : 0;
+        session->buffer_charged = session->buffer_len;
+        memory_charge((long)session->buffer_charged, TRUE);
+    }
+}
+
+/**
+ * static int neuron_request(struct neuron_session *session, enum neuron_endpoint endpoint, int flags, const char *body, struct neuron_transfer_info *info)
+ * Request an endpoint as its descriptor says and post-process the response.
+ * URLs and header lists come prebuilt from the neuron's host state.
+ * @param session
+ * @param endpoint
+ * @param flags added to the endpoint's own flags for this request
+ * @param body POST body, NULL for GET endpoints
+ * @param info receives what was learned about the last attempt, may be NULL
+ * @return
+ */
+static int neuron_request(struct neuron_session *session, enum neuron_endpoint endpoint, int flags, const char *body, struct neuron_transfer_info *info) {
+    const struct neuron_endpoint_desc *desc = &endpoints[endpoint];
+    struct neuron_host *nh = satnow_neuron_host_get(session->host);
+    struct neuron_headers *headers = NULL;
+    struct neuron_transfer_info last = { 0 };
+    struct curl_slist *conditional = NULL;
+    long cache_ms = satnow_config_get(CONFIG_RESPONSE_CACHE_MS);
+    int cacheable = (desc->flags & HTTP_CACHEABLE) != 0;
+    size_t base_len = session->buffer_len;
+    int revalidated = FALSE;
+    CURL *curl;
+    CURLcode result;
+
+    session->digest = 0;
+    session->forwarded = 0;
+    if (!nh || !nh->urls[endpoint]) {
+        return -1;
+    }
+
+    if (cacheable && cache_ms > 0 && !(flags & HTTP_PREFETCH)) {
+        size_t len = 0;
+        char *cached = satnow_neuron_host_cache_get(nh, endpoint, cache_ms, &len, &session->digest);
 
-    snprintf(url, sizeof(url), "http://%s/unlock", session->host);
-    snprintf(url_data, sizeof(url_data), "passphrase=%s&next=http://%s/vault", session->pass, session->host);
+        if (cached) {
+            int failed = session_append(session, cached, len) || session_map(session);
 
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return -1;
+            free(cached);
+            if (!failed) {
+                neuron_response_finish(session, desc);
+                return 0;
+            }
+        }
     }
-    snprintf(cookie_file, sizeof(cookie_file), "%s/%s-%ld.cookie", satnow_config_directory(), session->host, now);
 
     curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, url_data);
+    if (!curl) {
+        return -1;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, nh->urls[endpoint]);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    if (!strcmp(desc->method, "POST")) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body ? body : "");
+    }
 
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    headers = satnow_neuron_host_headers(nh, (desc->flags & HTTP_AUTH) ? session->session : NULL, build_headers);
+    if (cacheable) {
+        conditional = conditional_headers(nh, endpoint, headers ? headers->lists[endpoint] : NULL);
+    }
+    if (conditional) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, conditional);
+    } else if (headers && headers->lists[endpoint]) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers->lists[endpoint]);
+    }
 
-        curl_easy_setopt(curl, CURLOPT_COOKIEJAR, cookie_file);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    if (desc->flags & HTTP_SESSION_COOKIE) {
+        /** Enable the in-memory cookie engine */
+        curl_easy_setopt(curl, CURLOPT_COOKIEFILE, "");
+    }
 
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_unlock() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
+    /** Background prefetches hold back while any interactive request is in flight */
+    if (!(flags & HTTP_PREFETCH)) {
+        __atomic_fetch_add(&interactive_requests, 1, __ATOMIC_RELAXED);
+    }
+    result = neuron_perform(curl, session, nh, endpoint, desc->flags | flags, &last);
+    if (result == CURLE_OK && cacheable && last.status == 304) {
+        /** The neuron confirmed the cached body is still current */
+        size_t len = 0;
+        char *cached = satnow_neuron_host_cache_revalidated(nh, endpoint, &len, &session->digest);
+
+        revalidated = cached && !session_append(session, cached, len) && !session_map(session);
+        free(cached);
+        if (!revalidated) {
+            /** The kept body was dropped after the neuron was asked about it, ask for the whole response */
+            printf("%s%s kept response is gone, requesting it again\n", session->host, desc->path);
+            session_truncate(session, base_len);
+            session->digest = 0;
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers ? headers->lists[endpoint] : NULL);
+            result = neuron_perform(curl, session, nh, endpoint, desc->flags | flags, &last);
+        }
+    }
+    if (result == CURLE_OK && last.status == 304 && !revalidated) {
+        /** Still not modified after asking without validators, there is no body to give */
+        result = CURLE_WEIRD_SERVER_REPLY;
+    }
+    if (result == CURLE_OK && session_map(session)) {
+        result = CURLE_OUT_OF_MEMORY;
+    }
+
+    if (result == CURLE_OK) {
+        int ok = last.status >= 200 && last.status < 300;
+
+        if (desc->flags & HTTP_SESSION_COOKIE) {
+            capture_session_cookie(curl, session);
         }
+        if (revalidated) {
+            /** The kept body was reused, there is nothing new to keep */
+        } else if (cacheable && !satnow_neuron_host_cache_enabled()) {
+            /** Responses kept before the cache was turned off are let go */
+            satnow_neuron_host_cache_trim();
+        } else if (cacheable && ok && !last.redirects && session->buffer && !session->spilled) {
+            satnow_neuron_host_cache_put(nh, endpoint, session->buffer + base_len, session->buffer_len - base_len
+                , last.etag, last.last_modified, flags & HTTP_PREFETCH, &session->digest);
+        } else if (ok && !(desc->flags & (HTTP_IDEMPOTENT | HTTP_SESSION_COOKIE))) {
+            /** The request changed the neuron's state, cached reads may be stale */
+            satnow_neuron_host_cache_clear(nh);
+        }
+        neuron_response_finish(session, desc);
+    } else {
+        printf("%s %s%s failed: %s\n", desc->method, session->host, desc->path, curl_easy_strerror(result));
+        /** A partial body is of no use to anyone and may be holding a spill file */
+        session_truncate(session, base_len);
+    }
+    /** Released after the cache store so a waiting prefetch sees the fresh response */
+    if (!(flags & HTTP_PREFETCH)) {
+        __atomic_fetch_sub(&interactive_requests, 1, __ATOMIC_RELAXED);
+    }
+    if (info) {
+        *info = last;
+    }
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+    satnow_neuron_host_headers_release(nh, headers);
+    curl_slist_free_all(conditional);
+    curl_easy_cleanup(curl);
 
-        FILE *cookie = fopen(cookie_file, "r");
-        if (cookie) {
-            char tbuf[1024];
-            int done = FALSE;
+    return result == CURLE_OK ? 0 : -1;
+}
 
-            do {
-                memset(tbuf, 0, sizeof(tbuf));
+/**
+ * static void prefetch_job_free(struct prefetch_job *job)
+ * Release a prefetch job and its session copy
+ * @param job
+ */
+static void prefetch_job_free(struct prefetch_job *job) {
+    free(job->session.host);
+    free(job->session.session);
+    satnow_http_neuron_buffer_free(&job->session);
+    free(job);
+}
 
-                if (fgets(tbuf, 1023, cookie) == NULL) {
-                    printf("failed to read cookie file\n");
-                    fclose(cookie);
-                    if (remove(cookie_file)) {
-                        perror("Error deleting cookie file");
-                    }
-                }
+/**
+ * static void *prefetch_worker(void *arg)
+ * Take queued prefetches one at a time. Each waits until no interactive
+ * request is in flight and the prefetch rate allows another start.
+ * @param arg worker slot
+ * @return
+ */
+static void *prefetch_worker(void *arg) {
+    int slot = (int)(intptr_t)arg;
+
+    pthread_mutex_lock(&prefetch.mutex);
+    while (!prefetch.stopping) {
+        struct prefetch_job *job = prefetch.head;
+        struct neuron_host *nh;
+        long cache_ms;
+        int fetched = FALSE;
+
+        if (!job) {
+            pthread_cond_wait(&prefetch.cond, &prefetch.mutex);
+            continue;
+        }
+        prefetch.head = job->next;
+        if (!prefetch.head) {
+            prefetch.tail = NULL;
+        }
+        prefetch.queued--;
+        prefetch.active[slot] = job;
 
-                if (strlen(tbuf)) {
-                    char *s = strstr(tbuf, "session");
-                    if (s) {
-                        s += strlen("session");
-                        while (isspace(*s)) {
-                            s++;
-                        }
-                        session->session = calloc(1, strlen(s) + 2);
-                        strncpy(session->session, s, strlen(s) + 1);
-                        done = TRUE;
-                    }
-                } else {
-                    done = TRUE;
-                }
-            } while (!done);
+        for (;;) {
+            long gap_ms = 1000 / satnow_config_get(CONFIG_PREFETCH_RATE);
+            struct timespec until;
 
-            if (cookie) {
-                fclose(cookie);
-                cookie = NULL;
+            if (prefetch.stopping || __atomic_load_n(&job->session.cancelled, __ATOMIC_RELAXED)) {
+                break;
             }
-            if (remove(cookie_file)) {
-                perror("Error deleting cookie file");
+            if (!__atomic_load_n(&interactive_requests, __ATOMIC_RELAXED) && elapsed_ms(&prefetch.last_start) >= gap_ms) {
+                break;
             }
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += PREFETCH_POLL_MS * 1000000L;
+            until.tv_sec += until.tv_nsec / 1000000000L;
+            until.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&prefetch.cond, &prefetch.mutex, &until);
         }
+        if (prefetch.stopping || __atomic_load_n(&job->session.cancelled, __ATOMIC_RELAXED)) {
+            prefetch.cancelled++;
+            prefetch.active[slot] = NULL;
+            prefetch_job_free(job);
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &prefetch.last_start);
+        pthread_mutex_unlock(&prefetch.mutex);
+
+        nh = satnow_neuron_host_get(job->session.host);
+        cache_ms = satnow_config_get(CONFIG_RESPONSE_CACHE_MS);
+        if (cache_ms > 0 && !satnow_neuron_host_cache_fresh(nh, job->endpoint, cache_ms)) {
+            neuron_request(&job->session, job->endpoint, HTTP_PREFETCH, NULL, NULL);
+            fetched = TRUE;
+        }
+
+        pthread_mutex_lock(&prefetch.mutex);
+        if (__atomic_load_n(&job->session.cancelled, __ATOMIC_RELAXED)) {
+            prefetch.cancelled++;
+        } else if (fetched) {
+            prefetch.completed++;
+        } else {
+            prefetch.skipped++;
+        }
+        prefetch.active[slot] = NULL;
+        prefetch_job_free(job);
     }
+    pthread_mutex_unlock(&prefetch.mutex);
 
-    return 0;
+    return NULL;
 }
 
 /**
- * int satnow_http_neuron_mining_to_address(struct neuron_session *session)
- * Return the neuron's mining to wallet address
- * @param data
+ * static void prefetch_queue(struct neuron_session *session, struct neuron_host *nh, long cache_ms)
+ * Queue the configured read-only endpoints of a freshly unlocked neuron
+ * for background prefetch, skipping those already cached or queued
+ * @param session
+ * @param nh
+ * @param cache_ms
  */
-int satnow_http_neuron_mining_to_address(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
+static void prefetch_queue(struct neuron_session *session, struct neuron_host *nh, long cache_ms) {
+    long bits = satnow_config_get(CONFIG_PREFETCH);
 
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return -1;
+    if (!bits) {
+        return;
     }
 
-    snprintf(url, sizeof(url), "http://%s/mining/to/address", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    pthread_mutex_lock(&prefetch.mutex);
+    for (int i = 0; i < (int)(sizeof(prefetch_bits) / sizeof(prefetch_bits[0])) && !prefetch.stopping; i++) {
+        enum neuron_endpoint endpoint = prefetch_bits[i].endpoint;
+        struct prefetch_job *job;
+        int queued = FALSE;
 
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
-
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_mining_to_address() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
+        if (!(bits & prefetch_bits[i].bit) || prefetch.queued >= PREFETCH_QUEUE_MAX || satnow_neuron_host_cache_fresh(nh, endpoint, cache_ms)) {
+            continue;
+        }
+        for (job = prefetch.head; job && !queued; job = job->next) {
+            queued = job->endpoint == endpoint && !strcasecmp(job->session.host, session->host);
+        }
+        if (queued || !(job = calloc(1, sizeof(*job)))) {
+            continue;
+        }
+        job->session.host = strdup(session->host);
+        job->session.session = strdup(session->session);
+        job->endpoint = endpoint;
+        if (!job->session.host || !job->session.session) {
+            prefetch_job_free(job);
+            continue;
         }
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+        if (prefetch.tail) {
+            prefetch.tail->next = job;
+        } else {
+            prefetch.head = job;
+        }
+        prefetch.tail = job;
+        prefetch.queued++;
     }
+    /** The unlocking client's own request comes next, give it a head start of one prefetch gap */
+    clock_gettime(CLOCK_MONOTONIC, &prefetch.last_start);
 
-    return 0;
+    while (prefetch.queued && prefetch.started < PREFETCH_WORKERS) {
+        if (pthread_create(&prefetch.workers[prefetch.started], NULL, prefetch_worker, (void *)(intptr_t)prefetch.started) != 0) {
+            perror("prefetch pthread_create");
+            break;
+        }
+        prefetch.started++;
+    }
+    pthread_cond_broadcast(&prefetch.cond);
+    pthread_mutex_unlock(&prefetch.mutex);
 }
 
 /**
- * int satnow_http_neuron_pool_participants(struct neuron_session *session)
- * Retrieve the neuron's pool participants
- * @param data
+ * int satnow_http_neuron_prefetch_cancel()
+ * Drop queued prefetches and cancel those in flight
+ * @return the number of prefetches cancelled
  */
-int satnow_http_neuron_pool_participants(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return -1;
-    }
+int satnow_http_neuron_prefetch_cancel() {
+    int count = 0;
 
-    snprintf(url, sizeof(url), "http://%s/pool/participants", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
+    pthread_mutex_lock(&prefetch.mutex);
+    while (prefetch.head) {
+        struct prefetch_job *job = prefetch.head;
 
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_pool_participants() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
+        prefetch.head = job->next;
+        prefetch_job_free(job);
+        prefetch.cancelled++;
+        count++;
+    }
+    prefetch.tail = NULL;
+    prefetch.queued = 0;
+    for (int i = 0; i < PREFETCH_WORKERS; i++) {
+        if (prefetch.active[i]) {
+            __atomic_store_n(&prefetch.active[i]->session.cancelled, TRUE, __ATOMIC_RELAXED);
+            count++;
         }
+    }
+    pthread_cond_broadcast(&prefetch.cond);
+    pthread_mutex_unlock(&prefetch.mutex);
 
-        char *hold = session->buffer;
-        session->buffer = satnow_json_string_unescape(hold);
-        free(hold);
+    return count;
+}
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+/**
+ * void satnow_http_neuron_prefetch_stats(struct neuron_prefetch_stats *stats)
+ * Report the state of the background prefetch queue
+ * @param stats
+ */
+void satnow_http_neuron_prefetch_stats(struct neuron_prefetch_stats *stats) {
+    pthread_mutex_lock(&prefetch.mutex);
+    stats->queued = prefetch.queued;
+    stats->active = 0;
+    for (int i = 0; i < PREFETCH_WORKERS; i++) {
+        stats->active += prefetch.active[i] != NULL;
     }
-
-    return 0;
+    stats->completed = prefetch.completed;
+    stats->skipped = prefetch.skipped;
+    stats->cancelled = prefetch.cancelled;
+    pthread_mutex_unlock(&prefetch.mutex);
 }
 
 /**
- * int satnow_http_neuron_proxy_parent_status(struct neuron_session *session)
- * Retrieve the neuron's status as a parent
+ * int satnow_http_neuron_unlock(struct neuron_session *session)
+ * Unlock the neuron and grab the session cookie
  * @param data
  */
-int satnow_http_neuron_proxy_parent_status(struct neuron_session *session) {
-    char url[URL_MAX];
+int satnow_http_neuron_unlock(struct neuron_session *session) {
+    long cache_ms = satnow_config_get(CONFIG_RESPONSE_CACHE_MS);
+    struct neuron_host *nh = satnow_neuron_host_get(session->host);
     char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
 
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
+    snprintf(url_data, sizeof(url_data), "passphrase=%s&next=%s", session->pass, nh->urls[NEURON_ENDPOINT_VAULT]);
+    if (neuron_request(session, NEURON_ENDPOINT_UNLOCK, 0, url_data, NULL)) {
         return -1;
     }
 
-    snprintf(url, sizeof(url), "http://%s/proxy/parent/status", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
+    if (cache_ms > 0 && session->session) {
+        prefetch_queue(session, nh, cache_ms);
+    }
+    return 0;
+}
 
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_proxy_parent_status() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
+/**
+ * int satnow_http_neuron_mining_to_address(struct neuron_session *session)
+ * Return the neuron's mining to wallet address
+ * @param data
+ */
+int satnow_http_neuron_mining_to_address(struct neuron_session *session) {
+    return neuron_request(session, NEURON_ENDPOINT_MINING_TO_ADDRESS, 0, NULL, NULL);
+}
 
-        extract_csrf_token(session);
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
+/**
+ * int satnow_http_neuron_pool_participants(struct neuron_session *session)
+ * Retrieve the neuron's pool participants
+ * @param data
+ */
+int satnow_http_neuron_pool_participants(struct neuron_session *session) {
+    return neuron_request(session, NEURON_ENDPOINT_POOL_PARTICIPANTS, 0, NULL, NULL);
+}
 
-    return 0;
+/**
+ * int satnow_http_neuron_proxy_parent_status(struct neuron_session *session)
+ * Retrieve the neuron's status as a parent
+ * @param data
+ */
+int satnow_http_neuron_proxy_parent_status(struct neuron_session *session) {
+    return neuron_request(session, NEURON_ENDPOINT_PROXY_PARENT_STATUS, 0, NULL, NULL);
 }
 
 /**
@@ -336,49 +1944,7 @@ int satnow_http_neuron_proxy_parent_status(struct neuron_session *session) {
  * @param data
  */
 int satnow_http_neuron_delegate(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    char response_file[PATH_MAX];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return -1;
-    }
-
-    snprintf(url, sizeof(url), "http://%s/delegate/get", session->host);
-    snprintf(response_file, sizeof(response_file), "%s/%s-%ld.response", satnow_config_directory(), session->host, now);
-    printf("satnow_http_neuron_delegate: %s, %s\n", session->session, response_file);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
-
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_delegate() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
-
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
-
-    return 0;
+    return neuron_request(session, NEURON_ENDPOINT_DELEGATE, 0, NULL, NULL);
 }
 
 /**
@@ -387,48 +1953,7 @@ int satnow_http_neuron_delegate(struct neuron_session *session) {
  * @param data
  */
 int satnow_http_neuron_system_metrics(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return 0;
-    }
-
-    snprintf(url, sizeof(url), "http://%s/system_metrics", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
-
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_system_metrics() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
-
-        extract_csrf_token(session);
-
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
-
-    return 0;
+    return neuron_request(session, NEURON_ENDPOINT_SYSTEM_METRICS, 0, NULL, NULL);
 }
 
 /**
@@ -437,48 +1962,42 @@ int satnow_http_neuron_system_metrics(struct neuron_session *session) {
  * @param data
  */
 int satnow_http_neuron_ping(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return 0;
-    }
-
-    snprintf(url, sizeof(url), "http://%s/ping", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    return neuron_request(session, NEURON_ENDPOINT_PING, 0, NULL, NULL);
+}
 
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
+/**
+ * int satnow_http_neuron_ping_sample(struct neuron_session *session, struct neuron_sample *sample)
+ * Ping the neuron once, without retrying or hedging, and report how long it took.
+ * Pooled connections are reused, so only the first sample to a neuron pays
+ * for connection setup.
+ * @param session
+ * @param sample
+ * @return 0 when the neuron answered
+ */
+int satnow_http_neuron_ping_sample(struct neuron_session *session, struct neuron_sample *sample) {
+    struct neuron_transfer_info info = { 0 };
+    int result;
 
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_ping() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
+    session_truncate(session, 0);
 
-        extract_csrf_token(session);
+    result = neuron_request(session, NEURON_ENDPOINT_PING, HTTP_SAMPLE, NULL, &info);
+    sample->status = info.status;
+    sample->connects = info.connects;
+    sample->first_byte_ms = info.starttransfer_us / 1000.0;
+    sample->total_ms = info.total_ms;
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
+    return result == 0 && info.status >= 200 && info.status < 300 ? 0 : -1;
+}
 
-    return 0;
+/**
+ * int satnow_http_neuron_sleep(struct neuron_session *session, long ms)
+ * Wait the specified time, returning early when the CLI client hangs up
+ * @param session
+ * @param ms
+ * @return TRUE when the session was cancelled
+ */
+int satnow_http_neuron_sleep(struct neuron_session *session, long ms) {
+    return neuron_sleep(session, ms);
 }
 
 /**
@@ -487,47 +2006,7 @@ int satnow_http_neuron_ping(struct neuron_session *session) {
  * @param data
  */
 int satnow_http_neuron_stats(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return 0;
-    }
-
-    snprintf(url, sizeof(url), "http://%s/fetch/wallet/stats/daily", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
-
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_stats() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
-
-        extract_csrf_token(session);
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
-
-    return 0;
+    return neuron_request(session, NEURON_ENDPOINT_STATS, 0, NULL, NULL);
 }
 
 /**
@@ -536,100 +2015,23 @@ int satnow_http_neuron_stats(struct neuron_session *session) {
  * @param data
  */
 int satnow_http_neuron_vault(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return 0;
-    }
-
-    snprintf(url, sizeof(url), "http://%s/vault", session->host);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
-
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_vault() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
-
-        extract_csrf_token(session);
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
-
-    return 0;
+    return neuron_request(session, NEURON_ENDPOINT_VAULT, 0, NULL, NULL);
 }
 
 /**
- * int satnow_http_neuron_vault_transfer(struct neuron_session *session, char *amount_str, char *wallet)
- * Transfer the specified amount of SATORI from the neuron's vault to the specified wallet address
+ * int satnow_http_neuron_vault_transfer(struct neuron_session *session, const char *amount_str, const char *wallet, int sweep)
+ * Transfer the specified amount of SATORI from the neuron's vault to the specified wallet address.
+ * With sweep set the neuron sends the entire vault balance and the amount is ignored.
  * @param data
  */
-int satnow_http_neuron_vault_transfer(struct neuron_session *session, char *amount_str, char *wallet) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
+int satnow_http_neuron_vault_transfer(struct neuron_session *session, const char *amount_str, const char *wallet, int sweep) {
     char post_data[1024];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return 0;
-    }
 
-    snprintf(url, sizeof(url), "http://%s/send_satori_transaction_from_vault/main", session->host);
-    snprintf(post_data, sizeof(post_data), "address=%s&amount=%s&sweep=false&submit=Send"
+    snprintf(post_data, sizeof(post_data), "address=%s&amount=%s&sweep=%s&submit=Send"
              , wallet
-             , amount_str);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
-
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_vault_transfer() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-            return -1;
-        }
-
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
-
-    return 0;
+             , amount_str ? amount_str : "0"
+             , sweep ? "true" : "false");
+    return neuron_request(session, NEURON_ENDPOINT_VAULT_TRANSFER, 0, post_data, NULL);
 }
 
 /**
@@ -638,50 +2040,42 @@ int satnow_http_neuron_vault_transfer(struct neuron_session *session, char *amou
  * @param data
  */
 int satnow_http_neuron_decrypt_vault(struct neuron_session *session) {
-    char url[URL_MAX];
-    char url_data[URL_DATA_MAX];
     char post_data[1024];
-    CURL *curl;
-    CURLcode result;
-
-    time_t now = time(NULL);
-    if (now == -1) {
-        perror("Failed to get current time");
-        return 0;
-    }
 
-    snprintf(url, sizeof(url), "http://%s/decrypt/vault", session->host);
     snprintf(post_data, sizeof(post_data), "{\"password\":\"%s\"}", session->pass);
+    return neuron_request(session, NEURON_ENDPOINT_DECRYPT_VAULT, 0, post_data, NULL);
+}
 
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_DEFAULT_PROTOCOL, "https");
-
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        snprintf(url_data, sizeof(url_data), "Cookie: session=%s", session->session);
-        headers = curl_slist_append(headers, url_data);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
+/**
+ * int satnow_http_neuron_wait_vault_ready(struct neuron_session *session)
+ * Poll the neuron's vault with backoff until it has been decrypted, the
+ * configured deadline passes or the CLI client hangs up
+ * @param session
+ * @return 0 once the vault is decrypted, -1 otherwise
+ */
+int satnow_http_neuron_wait_vault_ready(struct neuron_session *session) {
+    long deadline_ms = satnow_config_get(CONFIG_VAULT_READY_TIMEOUT_MS);
+    long wait_ms = VAULT_READY_POLL_MS;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        struct neuron_transfer_info info = { 0 };
+        long left;
+
+        if (neuron_request(session, NEURON_ENDPOINT_VAULT_STATE, 0, NULL, &info) == 0 && info.stopped) {
+            printf("%s vault decrypted after %ld ms\n", session->host, elapsed_ms(&start));
+            return 0;
+        }
 
-        if ((result = curl_easy_perform(curl)) != CURLE_OK) {
-            printf("satnow_http_neuron_decrypt_vault() failed: %s\n", curl_easy_strerror(result));
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
+        left = deadline_ms - elapsed_ms(&start);
+        if (left <= 0) {
+            printf("%s vault not decrypted within %ld ms\n", session->host, deadline_ms);
             return -1;
         }
-
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+        if (neuron_sleep(session, wait_ms < left ? wait_ms : left)) {
+            return -1;
+        }
+        wait_ms = wait_ms * 2 < VAULT_READY_POLL_MAX_MS ? wait_ms * 2 : VAULT_READY_POLL_MAX_MS;
     }
-
-    return 0;
-}
\ No newline at end of file
+}
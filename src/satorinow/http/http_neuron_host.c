@@ -0,0 +1,1181 @@
+/*
+ * Copyright (c) 2025 Design Pattern Solutions Inc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <satorinow.h>
+#include "satorinow/config.h"
+#include "satorinow/http/http_neuron.h"
+#include "satorinow/http/http_neuron_host.h"
+
+/** Samples required before the p95 estimate is trusted for hedging */
+#define NEURON_LATENCY_WARMUP 4
+/** Headroom between the expected worst case latency and the deadline */
+#define NEURON_DEADLINE_FACTOR 3
+/** Public keys of https neurons, one "<host> <pin>" line each, in the configuration directory */
+#define NEURON_PINS_FILE "neuron_pins"
+
+static struct neuron_host *host_list_head = NULL;
+static pthread_mutex_t host_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pins_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Bytes of kept response bodies and rendered output across all hosts, updated with atomics */
+static long cache_bytes = 0;
+
+/**
+ * static void pins_path(char *path, size_t path_len)
+ * Return the location of the pinned key file
+ * @param path
+ * @param path_len
+ */
+static void pins_path(char *path, size_t path_len) {
+    snprintf(path, path_len, "%s/%s", satnow_config_directory(), NEURON_PINS_FILE);
+}
+
+/**
+ * static char *pin_load(const char *host)
+ * Read the host's pinned key from the pinned key file. Caller holds pins_mutex.
+ * @param host
+ * @return the pin, to be freed by the caller, or NULL
+ */
+static char *pin_load(const char *host) {
+    char path[PATH_MAX];
+    char line[NEURON_PIN_MAX + 512];
+    char *pin = NULL;
+    FILE *file;
+
+    pins_path(path, sizeof(path));
+    file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+    while (!pin && fgets(line, sizeof(line), file)) {
+        char *value = strchr(line, ' ');
+
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+        value[strcspn(value, "\r\n")] = '\0';
+        if (!strcasecmp(line, host) && *value) {
+            pin = strdup(value);
+        }
+    }
+    fclose(file);
+
+    return pin;
+}
+
+/**
+ * struct neuron_host *satnow_neuron_host_get(const char *host)
+ * Find or create the state for the specified host
+ * @param host
+ * @return
+ */
+struct neuron_host *satnow_neuron_host_get(const char *host) {
+    struct neuron_host *current = NULL;
+
+    if (!host) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&host_list_mutex);
+    for (current = host_list_head; current; current = current->next) {
+        if (!strcasecmp(current->host, host)) {
+            pthread_mutex_unlock(&host_list_mutex);
+            return current;
+        }
+    }
+
+    current = calloc(1, sizeof(*current));
+    if (current) {
+        /** Hosts registered with a scheme keep it, bare <ip>:<port> hosts are plain http */
+        const char *scheme = strncasecmp(host, "https://", 8) && strncasecmp(host, "http://", 7) ? "http://" : "";
+
+        current->host = strdup(host);
+        current->tls = !strncasecmp(host, "https://", 8);
+        for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+            if (asprintf(&current->urls[i], "%s%s%s", scheme, host, satnow_http_neuron_endpoint_name(i)) < 0) {
+                current->urls[i] = NULL;
+            }
+        }
+        if (current->tls) {
+            pthread_mutex_lock(&pins_mutex);
+            current->pin = pin_load(host);
+            pthread_mutex_unlock(&pins_mutex);
+        }
+        pthread_mutex_init(&current->mutex, NULL);
+        current->next = host_list_head;
+        host_list_head = current;
+    }
+    pthread_mutex_unlock(&host_list_mutex);
+
+    return current;
+}
+
+/**
+ * void satnow_neuron_host_latency_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, double ms)
+ * Fold a completed request's latency into the endpoint's smoothed latency
+ * @param nh
+ * @param endpoint
+ * @param ms
+ */
+void satnow_neuron_host_latency_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, double ms) {
+    struct neuron_endpoint_latency *l;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    l = &nh->latency[endpoint];
+    if (l->samples == 0) {
+        l->srtt_ms = ms;
+        l->rttvar_ms = ms / 2;
+    } else {
+        l->rttvar_ms += (fabs(ms - l->srtt_ms) - l->rttvar_ms) / 4;
+        l->srtt_ms += (ms - l->srtt_ms) / 8;
+    }
+    l->samples++;
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * void satnow_neuron_host_connection_sample(struct neuron_host *nh, long connects)
+ * Count a completed transfer and whether it opened a new connection rather
+ * than reusing one from the shared connection cache
+ * @param nh
+ * @param connects
+ */
+void satnow_neuron_host_connection_sample(struct neuron_host *nh, long connects) {
+    if (!nh) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    nh->transfers++;
+    if (connects > 0) {
+        nh->connects++;
+    }
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * void satnow_neuron_host_traffic_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, unsigned long wire_bytes, unsigned long decoded_bytes)
+ * Count the body bytes of a completed transfer, as received and as decoded
+ * @param nh
+ * @param endpoint
+ * @param wire_bytes
+ * @param decoded_bytes
+ */
+void satnow_neuron_host_traffic_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, unsigned long wire_bytes, unsigned long decoded_bytes) {
+    struct neuron_endpoint_traffic *t;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    t = &nh->traffic[endpoint];
+    t->transfers++;
+    t->wire_bytes += wire_bytes;
+    t->decoded_bytes += decoded_bytes;
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * void satnow_neuron_host_timing_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, enum neuron_timing metric, uint64_t value)
+ * Record one phase of a completed request
+ * @param nh
+ * @param endpoint
+ * @param metric
+ * @param value
+ */
+void satnow_neuron_host_timing_sample(struct neuron_host *nh, enum neuron_endpoint endpoint, enum neuron_timing metric, uint64_t value) {
+    struct neuron_endpoint_timing *timing;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX || metric >= NEURON_TIMING_MAX) {
+        return;
+    }
+
+    timing = __atomic_load_n(&nh->timing[endpoint], __ATOMIC_ACQUIRE);
+    if (!timing) {
+        struct neuron_endpoint_timing *expected = NULL;
+
+        timing = calloc(1, sizeof(*timing));
+        if (!timing) {
+            return;
+        }
+        /** Another thread may have installed the histograms first */
+        if (!__atomic_compare_exchange_n(&nh->timing[endpoint], &expected, timing, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            free(timing);
+            timing = expected;
+        }
+    }
+    satnow_histogram_record(&timing->metrics[metric], value);
+}
+
+/**
+ * struct neuron_endpoint_timing *satnow_neuron_host_timing(struct neuron_host *nh, enum neuron_endpoint endpoint)
+ * Return the endpoint's timing histograms, or NULL before its first sample
+ * @param nh
+ * @param endpoint
+ * @return
+ */
+struct neuron_endpoint_timing *satnow_neuron_host_timing(struct neuron_host *nh, enum neuron_endpoint endpoint) {
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return NULL;
+    }
+    return __atomic_load_n(&nh->timing[endpoint], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * void satnow_neuron_host_timing_reset(struct neuron_host *nh)
+ * Forget the timing histograms of every endpoint on the host
+ * @param nh
+ */
+void satnow_neuron_host_timing_reset(struct neuron_host *nh) {
+    for (int i = 0; nh && i < NEURON_ENDPOINT_MAX; i++) {
+        struct neuron_endpoint_timing *timing = satnow_neuron_host_timing(nh, i);
+
+        for (int m = 0; timing && m < NEURON_TIMING_MAX; m++) {
+            satnow_histogram_reset(&timing->metrics[m]);
+        }
+    }
+}
+
+/**
+ * const char *satnow_neuron_host_timing_name(enum neuron_timing metric)
+ * Return the printable name of a timing phase
+ * @param metric
+ * @return
+ */
+const char *satnow_neuron_host_timing_name(enum neuron_timing metric) {
+    switch (metric) {
+        case NEURON_TIMING_DNS:
+            return "dns";
+        case NEURON_TIMING_CONNECT:
+            return "connect";
+        case NEURON_TIMING_TLS:
+            return "tls";
+        case NEURON_TIMING_FIRST_BYTE:
+            return "first byte";
+        case NEURON_TIMING_TOTAL:
+            return "total";
+        case NEURON_TIMING_BYTES:
+            return "bytes";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * long satnow_neuron_host_deadline_ms(struct neuron_host *nh, enum neuron_endpoint endpoint)
+ * Return the deadline for the next request to the endpoint. Until the endpoint
+ * has been sampled the configured maximum applies.
+ * @param nh
+ * @param endpoint
+ * @return
+ */
+long satnow_neuron_host_deadline_ms(struct neuron_host *nh, enum neuron_endpoint endpoint) {
+    long min = satnow_config_get(CONFIG_HTTP_MIN_DEADLINE_MS);
+    long max = satnow_config_get(CONFIG_HTTP_MAX_DEADLINE_MS);
+    long deadline = max;
+
+    if (nh && endpoint < NEURON_ENDPOINT_MAX) {
+        pthread_mutex_lock(&nh->mutex);
+        if (nh->latency[endpoint].samples) {
+            deadline = (long)(NEURON_DEADLINE_FACTOR * (nh->latency[endpoint].srtt_ms + 4 * nh->latency[endpoint].rttvar_ms));
+        }
+        pthread_mutex_unlock(&nh->mutex);
+    }
+
+    if (deadline < min) {
+        deadline = min;
+    }
+    if (deadline > max) {
+        deadline = max;
+    }
+    return deadline;
+}
+
+/**
+ * long satnow_neuron_host_p95_ms(struct neuron_host *nh, enum neuron_endpoint endpoint)
+ * Return the estimated p95 latency of the endpoint, or 0 while the endpoint
+ * has too few samples for the estimate to be meaningful
+ * @param nh
+ * @param endpoint
+ * @return
+ */
+long satnow_neuron_host_p95_ms(struct neuron_host *nh, enum neuron_endpoint endpoint) {
+    long p95 = 0;
+
+    if (nh && endpoint < NEURON_ENDPOINT_MAX) {
+        pthread_mutex_lock(&nh->mutex);
+        if (nh->latency[endpoint].samples >= NEURON_LATENCY_WARMUP) {
+            p95 = (long)ceil(nh->latency[endpoint].srtt_ms + 2 * nh->latency[endpoint].rttvar_ms);
+        }
+        pthread_mutex_unlock(&nh->mutex);
+    }
+    return p95;
+}
+
+/**
+ * static long since_ms(const struct timespec *start)
+ * Milliseconds since the specified CLOCK_MONOTONIC time
+ * @param start
+ * @return
+ */
+static long since_ms(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/**
+ * static void cached_response_free(struct neuron_cached_response *c)
+ * Release a cached response, leaving the slot empty
+ * @param c
+ */
+static void cached_response_free(struct neuron_cached_response *c) {
+    __atomic_sub_fetch(&cache_bytes, (long)((c->body ? c->len + 1 : 0) + (c->rendered ? c->rendered_len + 1 : 0)), __ATOMIC_RELAXED);
+    free(c->body);
+    free(c->etag);
+    free(c->last_modified);
+    free(c->rendered_key);
+    free(c->rendered);
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * static void rendered_free(struct neuron_cached_response *c)
+ * Drop the output rendered from a cached response
+ * @param c
+ */
+static void rendered_free(struct neuron_cached_response *c) {
+    if (c->rendered) {
+        __atomic_sub_fetch(&cache_bytes, (long)(c->rendered_len + 1), __ATOMIC_RELAXED);
+    }
+    free(c->rendered_key);
+    free(c->rendered);
+    c->rendered_key = NULL;
+    c->rendered = NULL;
+    c->rendered_len = 0;
+}
+
+/**
+ * int satnow_neuron_host_cache_enabled()
+ * Return whether read-only responses are kept, for the response cache or
+ * for revalidation
+ * @return
+ */
+int satnow_neuron_host_cache_enabled() {
+    return satnow_config_get(CONFIG_RESPONSE_CACHE_MS) > 0 || satnow_config_get(CONFIG_RESPONSE_REVALIDATE);
+}
+
+/**
+ * long satnow_neuron_host_cache_bytes()
+ * Return the bytes kept read-only responses and their rendered output hold
+ * @return
+ */
+long satnow_neuron_host_cache_bytes() {
+    return __atomic_load_n(&cache_bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * void satnow_neuron_host_cache_trim()
+ * Drop the oldest kept responses until they fit in response_cache_bytes,
+ * or all of them while responses are not kept
+ */
+void satnow_neuron_host_cache_trim() {
+    long max_bytes = satnow_neuron_host_cache_enabled() ? satnow_config_get(CONFIG_RESPONSE_CACHE_BYTES) : 0;
+
+    while (__atomic_load_n(&cache_bytes, __ATOMIC_RELAXED) > max_bytes) {
+        struct neuron_host *victim = NULL;
+        struct timespec oldest = { 0 };
+        int endpoint = 0;
+
+        pthread_mutex_lock(&host_list_mutex);
+        for (struct neuron_host *current = host_list_head; current; current = current->next) {
+            pthread_mutex_lock(&current->mutex);
+            for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+                struct neuron_cached_response *c = &current->cache[i];
+
+                if (!c->body) {
+                    continue;
+                }
+                if (max_bytes == 0) {
+                    cached_response_free(c);
+                } else if (!victim || c->at.tv_sec < oldest.tv_sec || (c->at.tv_sec == oldest.tv_sec && c->at.tv_nsec < oldest.tv_nsec)) {
+                    victim = current;
+                    endpoint = i;
+                    oldest = c->at;
+                }
+            }
+            pthread_mutex_unlock(&current->mutex);
+        }
+        if (victim) {
+            pthread_mutex_lock(&victim->mutex);
+            cached_response_free(&victim->cache[endpoint]);
+            pthread_mutex_unlock(&victim->mutex);
+        }
+        pthread_mutex_unlock(&host_list_mutex);
+
+        if (!victim) {
+            break;
+        }
+    }
+}
+
+/**
+ * uint64_t satnow_neuron_host_digest(const char *data, size_t len)
+ * Return the content hash used to tell whether a response changed
+ * @param data
+ * @param len
+ * @return
+ */
+uint64_t satnow_neuron_host_digest(const char *data, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    /** 0 means no digest */
+    return hash ? hash : 1;
+}
+
+/**
+ * int satnow_neuron_host_cache_put(struct neuron_host *nh, enum neuron_endpoint endpoint, const char *body, size_t len, const char *etag, const char *last_modified, int prefetched, uint64_t *digest)
+ * Keep a copy of the endpoint's response body and its validators
+ * @param nh
+ * @param endpoint
+ * @param body
+ * @param len
+ * @param etag
+ * @param last_modified
+ * @param prefetched
+ * @param digest
+ * @return
+ */
+int satnow_neuron_host_cache_put(struct neuron_host *nh, enum neuron_endpoint endpoint, const char *body, size_t len, const char *etag, const char *last_modified, int prefetched, uint64_t *digest) {
+    struct neuron_cached_response *c;
+    uint64_t hash = satnow_neuron_host_digest(body, len);
+    char *copy = NULL;
+    int unchanged;
+
+    if (digest) {
+        *digest = hash;
+    }
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    c = &nh->cache[endpoint];
+    unchanged = c->body && c->digest == hash && c->len == len && !memcmp(c->body, body, len);
+    if (unchanged) {
+        nh->traffic[endpoint].unchanged++;
+    } else {
+        /** A body that is not kept must not leave the older one to be revalidated */
+        copy = len + 1 <= (size_t)satnow_config_get(CONFIG_RESPONSE_CACHE_BYTES) ? malloc(len + 1) : NULL;
+        if (!copy) {
+            cached_response_free(c);
+            pthread_mutex_unlock(&nh->mutex);
+            return FALSE;
+        }
+        memcpy(copy, body, len);
+        copy[len] = '\0';
+        if (c->body) {
+            __atomic_sub_fetch(&cache_bytes, (long)(c->len + 1), __ATOMIC_RELAXED);
+        }
+        free(c->body);
+        rendered_free(c);
+        c->body = copy;
+        c->len = len;
+        c->digest = hash;
+        __atomic_add_fetch(&cache_bytes, (long)(len + 1), __ATOMIC_RELAXED);
+    }
+    free(c->etag);
+    free(c->last_modified);
+    c->etag = etag && *etag ? strdup(etag) : NULL;
+    c->last_modified = last_modified && *last_modified ? strdup(last_modified) : NULL;
+    c->prefetched = prefetched;
+    clock_gettime(CLOCK_MONOTONIC, &c->at);
+    pthread_mutex_unlock(&nh->mutex);
+
+    satnow_neuron_host_cache_trim();
+
+    return unchanged;
+}
+
+/**
+ * char *satnow_neuron_host_cache_get(struct neuron_host *nh, enum neuron_endpoint endpoint, long max_age_ms, size_t *len, uint64_t *digest)
+ * Return a copy of the endpoint's cached response body when it is younger
+ * than max_age_ms, counting the hit
+ * @param nh
+ * @param endpoint
+ * @param max_age_ms
+ * @param len
+ * @param digest
+ * @return
+ */
+char *satnow_neuron_host_cache_get(struct neuron_host *nh, enum neuron_endpoint endpoint, long max_age_ms, size_t *len, uint64_t *digest) {
+    struct neuron_cached_response *c;
+    char *copy = NULL;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX || max_age_ms <= 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    c = &nh->cache[endpoint];
+    if (c->body && since_ms(&c->at) < max_age_ms) {
+        copy = malloc(c->len + 1);
+        if (copy) {
+            memcpy(copy, c->body, c->len + 1);
+            *len = c->len;
+            if (digest) {
+                *digest = c->digest;
+            }
+            nh->traffic[endpoint].cache_hits++;
+        }
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    return copy;
+}
+
+/**
+ * int satnow_neuron_host_cache_validators(struct neuron_host *nh, enum neuron_endpoint endpoint, char *etag, size_t etag_len, char *last_modified, size_t last_modified_len)
+ * Copy the validators of the endpoint's cached response for a conditional request
+ * @param nh
+ * @param endpoint
+ * @param etag
+ * @param etag_len
+ * @param last_modified
+ * @param last_modified_len
+ * @return
+ */
+int satnow_neuron_host_cache_validators(struct neuron_host *nh, enum neuron_endpoint endpoint, char *etag, size_t etag_len, char *last_modified, size_t last_modified_len) {
+    struct neuron_cached_response *c;
+
+    etag[0] = '\0';
+    last_modified[0] = '\0';
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    c = &nh->cache[endpoint];
+    if (c->body) {
+        snprintf(etag, etag_len, "%s", c->etag ? c->etag : "");
+        snprintf(last_modified, last_modified_len, "%s", c->last_modified ? c->last_modified : "");
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    return etag[0] || last_modified[0];
+}
+
+/**
+ * char *satnow_neuron_host_cache_revalidated(struct neuron_host *nh, enum neuron_endpoint endpoint, size_t *len, uint64_t *digest)
+ * Return a copy of the endpoint's cached response body after the neuron
+ * answered 304 Not Modified, restarting its age
+ * @param nh
+ * @param endpoint
+ * @param len
+ * @param digest
+ * @return
+ */
+char *satnow_neuron_host_cache_revalidated(struct neuron_host *nh, enum neuron_endpoint endpoint, size_t *len, uint64_t *digest) {
+    struct neuron_cached_response *c;
+    char *copy = NULL;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    c = &nh->cache[endpoint];
+    if (c->body && (copy = malloc(c->len + 1))) {
+        memcpy(copy, c->body, c->len + 1);
+        *len = c->len;
+        if (digest) {
+            *digest = c->digest;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &c->at);
+        nh->traffic[endpoint].unchanged++;
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    return copy;
+}
+
+/**
+ * char *satnow_neuron_host_rendered_get(struct neuron_host *nh, enum neuron_endpoint endpoint, uint64_t digest, const char *key)
+ * Return a copy of the output rendered from the endpoint's cached response
+ * when the response is unchanged, counting the skipped parse
+ * @param nh
+ * @param endpoint
+ * @param digest
+ * @param key
+ * @return
+ */
+char *satnow_neuron_host_rendered_get(struct neuron_host *nh, enum neuron_endpoint endpoint, uint64_t digest, const char *key) {
+    struct neuron_cached_response *c;
+    char *copy = NULL;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX || !digest) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    c = &nh->cache[endpoint];
+    if (c->rendered && c->digest == digest && !strcmp(c->rendered_key, key)) {
+        copy = strdup(c->rendered);
+        if (copy) {
+            nh->traffic[endpoint].parses_skipped++;
+        }
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    return copy;
+}
+
+/**
+ * void satnow_neuron_host_rendered_put(struct neuron_host *nh, enum neuron_endpoint endpoint, uint64_t digest, const char *key, const char *rendered)
+ * Keep the output rendered from the endpoint's cached response
+ * @param nh
+ * @param endpoint
+ * @param digest
+ * @param key
+ * @param rendered
+ */
+void satnow_neuron_host_rendered_put(struct neuron_host *nh, enum neuron_endpoint endpoint, uint64_t digest, const char *key, const char *rendered) {
+    struct neuron_cached_response *c;
+    size_t len = strlen(rendered);
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX || !digest) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    c = &nh->cache[endpoint];
+    /** A newer response may have replaced the one that was rendered */
+    if (c->body && c->digest == digest) {
+        rendered_free(c);
+        if (c->len + 1 + len + 1 <= (size_t)satnow_config_get(CONFIG_RESPONSE_CACHE_BYTES)) {
+            c->rendered_key = strdup(key);
+            c->rendered = malloc(len + 1);
+            if (!c->rendered_key || !c->rendered) {
+                free(c->rendered_key);
+                free(c->rendered);
+                c->rendered_key = NULL;
+                c->rendered = NULL;
+            } else {
+                memcpy(c->rendered, rendered, len + 1);
+                c->rendered_len = len;
+                __atomic_add_fetch(&cache_bytes, (long)(len + 1), __ATOMIC_RELAXED);
+            }
+        }
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    satnow_neuron_host_cache_trim();
+}
+
+/**
+ * int satnow_neuron_host_cache_fresh(struct neuron_host *nh, enum neuron_endpoint endpoint, long max_age_ms)
+ * Return whether the endpoint has a cached response younger than max_age_ms
+ * @param nh
+ * @param endpoint
+ * @param max_age_ms
+ * @return
+ */
+int satnow_neuron_host_cache_fresh(struct neuron_host *nh, enum neuron_endpoint endpoint, long max_age_ms) {
+    int fresh;
+
+    if (!nh || endpoint >= NEURON_ENDPOINT_MAX) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    fresh = nh->cache[endpoint].body && since_ms(&nh->cache[endpoint].at) < max_age_ms;
+    pthread_mutex_unlock(&nh->mutex);
+
+    return fresh;
+}
+
+/**
+ * void satnow_neuron_host_cache_clear(struct neuron_host *nh)
+ * Forget every cached response of the host
+ * @param nh
+ */
+void satnow_neuron_host_cache_clear(struct neuron_host *nh) {
+    if (!nh) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+        cached_response_free(&nh->cache[i]);
+    }
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * char *satnow_neuron_host_pin_get(struct neuron_host *nh)
+ * Return a copy of the public key pinned for an https host
+ * @param nh
+ * @return
+ */
+char *satnow_neuron_host_pin_get(struct neuron_host *nh) {
+    char *copy = NULL;
+
+    if (!nh) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    if (nh->pin) {
+        copy = strdup(nh->pin);
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    return copy;
+}
+
+/**
+ * void satnow_neuron_host_pin_learn(struct neuron_host *nh, const char *pin)
+ * Pin the public key an https host presented on first contact and save it,
+ * unless a key is already pinned
+ * @param nh
+ * @param pin
+ */
+void satnow_neuron_host_pin_learn(struct neuron_host *nh, const char *pin) {
+    char path[PATH_MAX];
+    FILE *file;
+    int learned = FALSE;
+
+    if (!nh || !pin || !*pin) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    if (!nh->pin) {
+        nh->pin = strdup(pin);
+        learned = nh->pin != NULL;
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    if (!learned) {
+        return;
+    }
+
+    printf("pinned %s to public key %s\n", nh->host, pin);
+    pins_path(path, sizeof(path));
+    pthread_mutex_lock(&pins_mutex);
+    file = fopen(path, "a");
+    if (file) {
+        fprintf(file, "%s %s\n", nh->host, pin);
+        fclose(file);
+    } else {
+        perror(path);
+    }
+    pthread_mutex_unlock(&pins_mutex);
+}
+
+/**
+ * int satnow_neuron_host_pin_forget(const char *host)
+ * Drop the public key pinned for a host, so the next connection pins the
+ * key the host presents then
+ * @param host
+ * @return TRUE if a key was pinned
+ */
+int satnow_neuron_host_pin_forget(const char *host) {
+    char path[PATH_MAX];
+    char temp[PATH_MAX + 8];
+    char line[NEURON_PIN_MAX + 512];
+    FILE *in;
+    FILE *out = NULL;
+    int found = FALSE;
+
+    if (!host) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&host_list_mutex);
+    for (struct neuron_host *current = host_list_head; current; current = current->next) {
+        if (!strcasecmp(current->host, host)) {
+            pthread_mutex_lock(&current->mutex);
+            found = current->pin != NULL;
+            free(current->pin);
+            current->pin = NULL;
+            pthread_mutex_unlock(&current->mutex);
+        }
+    }
+    pthread_mutex_unlock(&host_list_mutex);
+
+    pins_path(path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    pthread_mutex_lock(&pins_mutex);
+    in = fopen(path, "r");
+    if (in) {
+        out = fopen(temp, "w");
+    }
+    if (in && out) {
+        while (fgets(line, sizeof(line), in)) {
+            size_t len = strlen(host);
+
+            if (!strncasecmp(line, host, len) && line[len] == ' ') {
+                found = TRUE;
+                continue;
+            }
+            fputs(line, out);
+        }
+        fclose(out);
+        if (rename(temp, path) < 0) {
+            perror(path);
+        }
+    }
+    if (in) {
+        fclose(in);
+    }
+    pthread_mutex_unlock(&pins_mutex);
+
+    return found;
+}
+
+/**
+ * void satnow_neuron_host_pin_foreach(void (*fn)(const char *host, const char *pin, void *context), void *context)
+ * Call the function for every saved pin, including hosts not contacted since startup
+ * @param fn
+ * @param context
+ */
+void satnow_neuron_host_pin_foreach(void (*fn)(const char *host, const char *pin, void *context), void *context) {
+    char path[PATH_MAX];
+    char line[NEURON_PIN_MAX + 512];
+    FILE *file;
+
+    pins_path(path, sizeof(path));
+    pthread_mutex_lock(&pins_mutex);
+    file = fopen(path, "r");
+    if (file) {
+        while (fgets(line, sizeof(line), file)) {
+            char *value = strchr(line, ' ');
+
+            if (!value) {
+                continue;
+            }
+            *value++ = '\0';
+            value[strcspn(value, "\r\n")] = '\0';
+            fn(line, value, context);
+        }
+        fclose(file);
+    }
+    pthread_mutex_unlock(&pins_mutex);
+}
+
+/**
+ * static void breaker_open(struct neuron_host *nh, const char *error)
+ * Trip the breaker. Caller holds nh->mutex.
+ * @param nh
+ * @param error
+ */
+static void breaker_open(struct neuron_host *nh, const char *error) {
+    if (nh->breaker != BREAKER_OPEN) {
+        printf("circuit breaker for %s opened: %s\n", nh->host, error ? error : "");
+    }
+    nh->breaker = BREAKER_OPEN;
+    clock_gettime(CLOCK_MONOTONIC, &nh->opened_at);
+}
+
+/**
+ * static void record_error(struct neuron_host *nh, const char *error)
+ * Remember the most recent error. Caller holds nh->mutex.
+ * @param nh
+ * @param error
+ */
+static void record_error(struct neuron_host *nh, const char *error) {
+    snprintf(nh->last_error, sizeof(nh->last_error), "%s", error ? error : "unknown error");
+    nh->last_error_time = time(NULL);
+}
+
+/**
+ * int satnow_neuron_host_admit(struct neuron_host *nh, int *probe)
+ * Decide whether a request may be sent to the host
+ * @param nh
+ * @param probe set when the caller must probe the host before its request
+ * @return
+ */
+int satnow_neuron_host_admit(struct neuron_host *nh, int *probe) {
+    int admit = TRUE;
+
+    *probe = FALSE;
+    if (!nh) {
+        return TRUE;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    switch (nh->breaker) {
+        case BREAKER_CLOSED:
+            break;
+        case BREAKER_OPEN:
+            if (since_ms(&nh->opened_at) >= satnow_config_get(CONFIG_BREAKER_OPEN_MS)) {
+                nh->breaker = BREAKER_HALF_OPEN;
+                *probe = TRUE;
+            } else {
+                nh->skipped++;
+                admit = FALSE;
+            }
+            break;
+        case BREAKER_HALF_OPEN:
+            /** another request is already probing */
+            nh->skipped++;
+            admit = FALSE;
+            break;
+    }
+    pthread_mutex_unlock(&nh->mutex);
+
+    return admit;
+}
+
+/**
+ * void satnow_neuron_host_probe_result(struct neuron_host *nh, int ok, const char *error)
+ * Close the breaker after a good probe, re-open it after a bad one
+ * @param nh
+ * @param ok
+ * @param error
+ */
+void satnow_neuron_host_probe_result(struct neuron_host *nh, int ok, const char *error) {
+    if (!nh) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    if (ok) {
+        printf("circuit breaker for %s closed\n", nh->host);
+        nh->breaker = BREAKER_CLOSED;
+        nh->failures = 0;
+    } else {
+        record_error(nh, error);
+        breaker_open(nh, error);
+    }
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * void satnow_neuron_host_success(struct neuron_host *nh)
+ * Report a request that reached the neuron and got a usable answer
+ * @param nh
+ */
+void satnow_neuron_host_success(struct neuron_host *nh) {
+    if (!nh) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    nh->failures = 0;
+    nh->breaker = BREAKER_CLOSED;
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * void satnow_neuron_host_failure(struct neuron_host *nh, const char *error)
+ * Report a failed request, opening the breaker after too many in a row
+ * @param nh
+ * @param error
+ */
+void satnow_neuron_host_failure(struct neuron_host *nh, const char *error) {
+    long threshold = satnow_config_get(CONFIG_BREAKER_FAILURES);
+
+    if (!nh) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    nh->failures++;
+    record_error(nh, error);
+    if (threshold > 0 && nh->failures >= threshold) {
+        breaker_open(nh, error);
+    }
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * const char *satnow_neuron_host_breaker_name(enum neuron_breaker_state state)
+ * Return the printable name of the breaker state
+ * @param state
+ * @return
+ */
+const char *satnow_neuron_host_breaker_name(enum neuron_breaker_state state) {
+    switch (state) {
+        case BREAKER_CLOSED:
+            return "CLOSED";
+        case BREAKER_OPEN:
+            return "OPEN";
+        case BREAKER_HALF_OPEN:
+            return "HALF-OPEN";
+    }
+    return "?";
+}
+
+/**
+ * long satnow_neuron_host_retry_in_ms(struct neuron_host *nh)
+ * Return the time until an open breaker admits a probe. Caller holds nh->mutex.
+ * @param nh
+ * @return
+ */
+long satnow_neuron_host_retry_in_ms(struct neuron_host *nh) {
+    long left;
+
+    if (nh->breaker != BREAKER_OPEN) {
+        return 0;
+    }
+    left = satnow_config_get(CONFIG_BREAKER_OPEN_MS) - since_ms(&nh->opened_at);
+    return left > 0 ? left : 0;
+}
+
+/**
+ * void satnow_neuron_host_foreach(void (*fn)(struct neuron_host *nh, void *context), void *context)
+ * Call the function for every known host with the host's mutex held
+ * @param fn
+ * @param context
+ */
+void satnow_neuron_host_foreach(void (*fn)(struct neuron_host *nh, void *context), void *context) {
+    pthread_mutex_lock(&host_list_mutex);
+    for (struct neuron_host *current = host_list_head; current; current = current->next) {
+        pthread_mutex_lock(&current->mutex);
+        fn(current, context);
+        pthread_mutex_unlock(&current->mutex);
+    }
+    pthread_mutex_unlock(&host_list_mutex);
+}
+
+/**
+ * static void headers_free(struct neuron_headers *headers)
+ * Release a set of header lists
+ * @param headers
+ */
+static void headers_free(struct neuron_headers *headers) {
+    for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+        curl_slist_free_all(headers->lists[i]);
+    }
+    free(headers->session);
+    free(headers);
+}
+
+/**
+ * struct neuron_headers *satnow_neuron_host_headers(struct neuron_host *nh, const char *session, struct curl_slist *(*build)(enum neuron_endpoint endpoint, const char *session))
+ * Return a reference to the header lists for the session, building them with
+ * the supplied function when the host has none for that session yet
+ * @param nh
+ * @param session
+ * @param build
+ * @return
+ */
+struct neuron_headers *satnow_neuron_host_headers(struct neuron_host *nh, const char *session, struct curl_slist *(*build)(enum neuron_endpoint endpoint, const char *session)) {
+    struct neuron_headers *headers;
+
+    pthread_mutex_lock(&nh->mutex);
+    headers = nh->headers;
+    if (!headers
+        || (headers->session == NULL) != (session == NULL)
+        || (session && strcmp(headers->session, session))) {
+
+        headers = calloc(1, sizeof(*headers));
+        if (!headers) {
+            pthread_mutex_unlock(&nh->mutex);
+            return NULL;
+        }
+        headers->session = session ? strdup(session) : NULL;
+        for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+            headers->lists[i] = build(i, session);
+        }
+
+        /** The host's reference moves to the new set */
+        headers->refs = 1;
+        if (nh->headers && --nh->headers->refs == 0) {
+            headers_free(nh->headers);
+        }
+        nh->headers = headers;
+    }
+    headers->refs++;
+    pthread_mutex_unlock(&nh->mutex);
+
+    return headers;
+}
+
+/**
+ * void satnow_neuron_host_headers_release(struct neuron_host *nh, struct neuron_headers *headers)
+ * Drop a reference returned by satnow_neuron_host_headers()
+ * @param nh
+ * @param headers
+ */
+void satnow_neuron_host_headers_release(struct neuron_host *nh, struct neuron_headers *headers) {
+    if (!headers) {
+        return;
+    }
+
+    pthread_mutex_lock(&nh->mutex);
+    if (--headers->refs == 0) {
+        headers_free(headers);
+    }
+    pthread_mutex_unlock(&nh->mutex);
+}
+
+/**
+ * void satnow_neuron_host_shutdown()
+ * Release all host state
+ */
+void satnow_neuron_host_shutdown() {
+    struct neuron_host *current = NULL;
+
+    pthread_mutex_lock(&host_list_mutex);
+    current = host_list_head;
+    while (current) {
+        struct neuron_host *next = current->next;
+
+        pthread_mutex_destroy(&current->mutex);
+        for (int i = 0; i < NEURON_ENDPOINT_MAX; i++) {
+            free(current->urls[i]);
+            free(current->timing[i]);
+            cached_response_free(&current->cache[i]);
+        }
+        free(current->pin);
+        if (current->headers && --current->headers->refs == 0) {
+            headers_free(current->headers);
+        }
+        free(current->host);
+        free(current);
+        current = next;
+    }
+    host_list_head = NULL;
+    pthread_mutex_unlock(&host_list_mutex);
+}
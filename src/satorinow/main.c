@@ -26,6 +26,7 @@
 #include <signal.h>
 #include <pthread.h>
 #include <curl/curl.h>
+#include <sys/signalfd.h>
 #include <sys/stat.h>
 #include <dlfcn.h>
 #include <dirent.h>
@@ -33,6 +34,10 @@
 #include <satorinow.h>
 #include "satorinow/cli.h"
 #include "satorinow/cli/cli_satori.h"
+#include "satorinow/config.h"
+#include "satorinow/event.h"
+#include "satorinow/http/http_neuron.h"
+#include "satorinow/http/http_neuron_host.h"
 #include "satorinow/repository.h"
 
 #define MODULES_DIR "./modules"
@@ -69,6 +74,22 @@ void satnow_shutdown(int signum) {
     (void)signum;
     printf("SatoriNOW shutting down\n");
     do_shutdown = TRUE;
+    satnow_event_stop();
+}
+
+/**
+ * static void shutdown_signal(struct satnow_event *event, uint32_t events)
+ * Event loop callback, SIGINT or SIGTERM arrived on the signalfd
+ * @param event
+ * @param events
+ */
+static void shutdown_signal(struct satnow_event *event, uint32_t events) {
+    struct signalfd_siginfo info;
+
+    (void)events;
+    if (read(event->fd, &info, sizeof(info)) == sizeof(info)) {
+        satnow_shutdown(info.ssi_signo);
+    }
 }
 
 /**
@@ -182,10 +203,37 @@ int main() {
         }
     }
 
+    /**
+     * Shutdown signals are read from a signalfd by the event loop. Block them
+     * before any thread starts so every thread inherits the mask.
+     */
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL);
+
+    /**
+     * A CLI client that hangs up mid-response must not take the daemon with it
+     */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (satnow_event_init() == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    struct satnow_event signal_event = { .callback = shutdown_signal };
+    signal_event.fd = signalfd(-1, &shutdown_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_event.fd == -1 || satnow_event_add(&signal_event, EPOLLIN) == -1) {
+        perror("signalfd");
+        exit(EXIT_FAILURE);
+    }
+
     /**
      * Initialize Modules
      */
     curl_global_init(CURL_GLOBAL_DEFAULT);
+    satnow_http_neuron_init();
     satnow_repository_init(config_dir);
 
     /**
@@ -199,41 +247,32 @@ int main() {
     satnow_register_core_cli_operations();
     satnow_register_satori_cli_operations();
     satnow_register_repository_cli_operations();
+    satnow_register_config_cli_operations();
     satnow_print_cli_operations();
 
     /**
-     * Initialize shutdown signal handlers
+     * Open the CLI socket
      */
-    signal(SIGINT, satnow_shutdown);
-    signal(SIGTERM, satnow_shutdown);
-
-    /**
-     * Create CLI socket thread
-     */
-    pthread_t cli_thread;
-    if (pthread_create(&cli_thread, NULL, satnow_cli_start, NULL) != 0) {
-        perror("pthread_create");
+    if (satnow_cli_start() == -1) {
         exit(EXIT_FAILURE);
     }
 
     /**
-     * Running loop
+     * Running loop, sleeps until a client, a timer or a signal needs attention
      */
-    while (!do_shutdown) {
-        /**
-         * Perform various background activities
-         */
-        usleep(100000);
-    }
+    satnow_event_run();
 
     /**
      * Shutting down activities
      */
     unload_modules();
-    curl_global_cleanup();
     satnow_cli_stop();
-    pthread_join(cli_thread, NULL);
+    satnow_http_neuron_shutdown();
+    curl_global_cleanup();
+    satnow_neuron_host_shutdown();
     satnow_repository_shutdown();
+    close(signal_event.fd);
+    satnow_event_shutdown();
 
     return 0;
 }
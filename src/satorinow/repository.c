@@ -27,12 +27,14 @@
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <cjson/cJSON.h>
 #include <satorinow.h>
 #include "satorinow/repository.h"
 #include "satorinow/cli.h"
+#include "satorinow/event.h"
 #include "satorinow/json.h"
 
 #ifdef __DEBUG__
@@ -40,14 +42,19 @@
 #endif
 
 pthread_mutex_t repository_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Guards the password and its expiry, taken after repository_mutex when both are held */
+static pthread_mutex_t password_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static char repository_dat[PATH_MAX];
 static char repository_password[CONFIG_MAX_PASSWORD];
 static time_t repository_password_expire;
+/** Wipes the password from memory when it expires, not just on the next use */
+static struct satnow_timer password_timer = { .event = { .fd = -1 } };
 
 static char *cli_repository_backup(struct satnow_cli_args *request);
 static char *cli_repository_password_change(struct satnow_cli_args *request);
 static int repository_password_forget();
+static void repository_password_expired(void *context);
 static char *cli_repository_show(struct satnow_cli_args *request);
 
 static struct satnow_cli_op satori_cli_operations[] = {
@@ -110,6 +117,7 @@ int satnow_register_repository_cli_operations() {
 void satnow_repository_init(const char *config_dir) {
     snprintf(repository_dat, sizeof(repository_dat), "%s/%s", config_dir, CONFIG_DAT);
     memset(repository_password, 0, sizeof(repository_password));
+    satnow_timer_init(&password_timer, repository_password_expired, NULL);
 }
 
 /**
@@ -117,9 +125,22 @@ void satnow_repository_init(const char *config_dir) {
  * Release repository resources
  */
 void satnow_repository_shutdown() {
+    satnow_timer_close(&password_timer);
+    repository_password_forget();
     pthread_mutex_destroy(&repository_mutex);
 }
 
+/**
+ * static void repository_password_expired(void *context)
+ * Timer callback, forget the password once it has expired
+ * @param context
+ */
+static void repository_password_expired(void *context) {
+    (void)context;
+    printf("Repository password expired\n");
+    repository_password_forget();
+}
+
 /**
  * void satnow_repository_password(const char *pass)
  * Set the repository password
@@ -127,9 +148,12 @@ void satnow_repository_shutdown() {
  */
 void satnow_repository_password(const char *pass) {
     /** XXX : probably need to convert REPOSITORY_DELIMITER to unicode */
+    pthread_mutex_lock(&password_mutex);
     snprintf(repository_password, sizeof(repository_password), "%s", pass);
     repository_password_expire = time(NULL);
     repository_password_expire += (REPOSITORY_PASSWORD_TIMEOUT);
+    satnow_timer_arm(&password_timer, (REPOSITORY_PASSWORD_TIMEOUT) * 1000L);
+    pthread_mutex_unlock(&password_mutex);
 }
 
 /**
@@ -139,11 +163,33 @@ void satnow_repository_password(const char *pass) {
  */
 int satnow_repository_password_valid() {
     time_t now = time(NULL);
+    int valid = TRUE;
+
+    pthread_mutex_lock(&password_mutex);
     if (!strlen(repository_password) || now >= repository_password_expire) {
         memset(repository_password, 0, sizeof(repository_password));
-        return FALSE;
+        valid = FALSE;
     }
-    return TRUE;
+    pthread_mutex_unlock(&password_mutex);
+    return valid;
+}
+
+/**
+ * static void derive_master_key(unsigned char *salt, unsigned char *key)
+ * Derive an entry's master key from a copy of the password, so a client
+ * entering the password concurrently cannot change it midway
+ * @param salt
+ * @param key
+ */
+static void derive_master_key(unsigned char *salt, unsigned char *key) {
+    char pass[CONFIG_MAX_PASSWORD];
+
+    pthread_mutex_lock(&password_mutex);
+    memcpy(pass, repository_password, sizeof(pass));
+    pthread_mutex_unlock(&password_mutex);
+
+    satnow_encrypt_derive_mast_key(pass, salt, key);
+    OPENSSL_cleanse(pass, sizeof(pass));
 }
 
 /**
@@ -152,8 +198,11 @@ int satnow_repository_password_valid() {
  * @return
  */
 static int repository_password_forget() {
+    pthread_mutex_lock(&password_mutex);
     memset(repository_password, 0, sizeof(repository_password));
     repository_password_expire = 0;
+    satnow_timer_arm(&password_timer, 0);
+    pthread_mutex_unlock(&password_mutex);
     return 0;
 }
 
@@ -399,7 +448,7 @@ static void write_repository_entry(FILE *repo, struct repository_entry *entry, c
 #if __DEBUG__
     printf("Deriving keys\n");
 #endif
-    satnow_encrypt_derive_mast_key(repository_password, entry->salt, entry->master_key);
+    derive_master_key(entry->salt, entry->master_key);
     satnow_encrypt_derive_file_key(entry->master_key, CONFIG_DAT, entry->file_key);
 
     if (!RAND_bytes(entry->iv, IV_LEN)) {
@@ -601,39 +650,7 @@ struct repository_entry *satnow_repository_entry_list() {
             return NULL;
         }
 
-        satnow_encrypt_derive_mast_key(repository_password, entry->salt, entry->master_key);
-        satnow_encrypt_derive_file_key(entry->master_key, CONFIG_DAT, entry->file_key);
-
         if (!head) {
-            /** MAKE SURE ENTRY CONTAINS EXPECTED CONTENTS */
-            if (entry->plaintext) {
-                free(entry->plaintext);
-                entry->plaintext = NULL;
-                entry->plaintext_len = 0;
-            }
-            entry->plaintext = calloc(sizeof(unsigned char), entry->ciphertext_len + EVP_MAX_BLOCK_LENGTH);
-
-            if (satnow_encrypt_ciphertext2text(entry->ciphertext
-                    , (int)entry->ciphertext_len
-                    , entry->file_key
-                    , entry->iv
-                    , entry->plaintext
-                    , (int *)&entry->plaintext_len) == -1) {
-
-                perror("Error opening/unlocking repository file");
-                repository_password_forget();
-                satnow_repository_entry_list_free(entry);
-                fclose(repo);
-                pthread_mutex_unlock(&repository_mutex);
-                return NULL;
-            }
-            if (strcasecmp((char *)entry->plaintext, REPOSITORY_MARKER) != 0) {
-                perror("Error opening/unlocking repository file");
-                satnow_repository_entry_list_free(entry);
-                fclose(repo);
-                pthread_mutex_unlock(&repository_mutex);
-                return NULL;
-            }
             head = entry;
         } else if (tail) {
             tail->next = entry;
@@ -643,5 +660,42 @@ struct repository_entry *satnow_repository_entry_list() {
 
     fclose(repo);
     pthread_mutex_unlock(&repository_mutex);
+
+    /**
+     * Key derivation is deliberately slow, so concurrent CLI clients derive
+     * outside the lock. The marker entry is checked before any other entry
+     * is derived with a wrong password.
+     */
+    if (head) {
+        derive_master_key(head->salt, head->master_key);
+        satnow_encrypt_derive_file_key(head->master_key, CONFIG_DAT, head->file_key);
+
+        /** MAKE SURE ENTRY CONTAINS EXPECTED CONTENTS */
+        head->plaintext = calloc(sizeof(unsigned char), head->ciphertext_len + EVP_MAX_BLOCK_LENGTH);
+
+        if (!head->plaintext || satnow_encrypt_ciphertext2text(head->ciphertext
+                , (int)head->ciphertext_len
+                , head->file_key
+                , head->iv
+                , head->plaintext
+                , (int *)&head->plaintext_len) == -1) {
+
+            perror("Error opening/unlocking repository file");
+            repository_password_forget();
+            satnow_repository_entry_list_free(head);
+            return NULL;
+        }
+        if (strcasecmp((char *)head->plaintext, REPOSITORY_MARKER) != 0) {
+            perror("Error opening/unlocking repository file");
+            satnow_repository_entry_list_free(head);
+            return NULL;
+        }
+
+        for (struct repository_entry *entry = head->next; entry; entry = entry->next) {
+            derive_master_key(entry->salt, entry->master_key);
+            satnow_encrypt_derive_file_key(entry->master_key, CONFIG_DAT, entry->file_key);
+        }
+    }
+
     return head;
 }
\ No newline at end of file